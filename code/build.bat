@@ -13,12 +13,16 @@ set STBPath=..\..\stb\
 set RivtenPath=..\..\rivten\
 
 set UntreatedWarnings=/wd4100 /wd4244 /wd4201 /wd4127 /wd4505 /wd4456 /wd4996 /wd4003
-set CommonCompilerDebugFlags=/MT /Od /Oi /fp:fast /fp:except- /Zo /Gm- /GR- /EHa /WX /W4 %UntreatedWarnings% /Z7 /nologo /I %SDLPath%\include\ /I %SDLNetPath%\include\ /I %STBPath% /I %RivtenPath%
-set CommonLinkerDebugFlags=/incremental:no /opt:ref /subsystem:console %SDLBinPath%\SDL2.lib %SDLBinPath%\SDL2main.lib %SDLNetBinPath%\SDL2_net.lib /ignore:4099
+set CommonCompilerDebugFlags=/MT /Od /Oi /fp:fast /fp:except- /Zo /Gm- /GR- /EHa /WX /W4 %UntreatedWarnings% /Z7 /nologo /I %SDLPath%\include\ /I %SDLNetPath%\include\ /I %STBPath% /I %RivtenPath% /DWIN32_LEAN_AND_MEAN /D_WIN32_WINNT=0x0600
+set CommonLinkerDebugFlags=/incremental:no /opt:ref /subsystem:console %SDLBinPath%\SDL2.lib %SDLBinPath%\SDL2main.lib %SDLNetBinPath%\SDL2_net.lib ws2_32.lib /ignore:4099
 
 pushd ..\build\
 cl %CommonCompilerDebugFlags% ..\code\sdl_synchess.cpp /link %CommonLinkerDebugFlags%
 cl %CommonCompilerDebugFlags% ..\code\synchess_server.cpp /link %CommonLinkerDebugFlags%
+cl %CommonCompilerDebugFlags% ..\code\synchess_bot.cpp /link %CommonLinkerDebugFlags%
+cl %CommonCompilerDebugFlags% ..\code\synchess_logdump.cpp /link %CommonLinkerDebugFlags%
+cl %CommonCompilerDebugFlags% ..\code\synchess_assetpack.cpp /link %CommonLinkerDebugFlags%
+synchess_assetpack.exe -data ..\data synchess.pack
 popd
 
 rem --------------------------------------------------------------------------
@@ -32,6 +32,12 @@ pushd "$CODE_PATH/../build"
 
 $CXX $CommonFlags ../code/sdl_synchess.cpp $CommonLinkerFlags -o synchess-x86_64
 $CXX $CommonFlags ../code/synchess_server.cpp $CommonLinkerFlags -o server_synchess-x86_64
+$CXX $CommonFlags ../code/synchess_bot.cpp $CommonLinkerFlags -o bot_synchess-x86_64
+$CXX $CommonFlags ../code/synchess_logdump.cpp $CommonLinkerFlags -o logdump_synchess-x86_64
+$CXX $CommonFlags ../code/synchess_assetpack.cpp $CommonLinkerFlags -o assetpack_synchess-x86_64
+
+# NOTE(hugo) : The client maps the pack that sits next to it.
+./assetpack_synchess-x86_64 -data ../data synchess.pack
 
 popd
 
@@ -841,6 +841,45 @@ ConfigMatch(chessboard_config* ConfigA, chessboard_config* ConfigB)
 	return(Match);
 }
 
+// NOTE(hugo) : Whether some legal sequence of moves could still end with
+// the player mating the other one. Only says no when it surely cannot : the
+// player has a lone king, or a king and a single bishop or knight against a
+// lone king. Anything else, even a knight against a rook, can still mate.
+// This is what decides a flag fall : a draw if the one with time left
+// cannot mate, a loss for the flagged player otherwise.
+internal bool
+CanStillMate(chess_game_context* ChessContext, piece_color Color)
+{
+	u32 PieceCounts[PieceColor_Count] = {};
+	u32 MinorPieceCount = 0;
+	for(u32 TileIndex = 0; TileIndex < 64; ++TileIndex)
+	{
+		chess_piece* Piece = ChessContext->Chessboard[TileIndex];
+		if(Piece && (Piece->Type != PieceType_King))
+		{
+			++PieceCounts[Piece->Color];
+			if((Piece->Color == Color) &&
+					((Piece->Type == PieceType_Bishop) || (Piece->Type == PieceType_Knight)))
+			{
+				++MinorPieceCount;
+			}
+		}
+	}
+
+	bool Result = true;
+	if(PieceCounts[Color] == 0)
+	{
+		Result = false;
+	}
+	else if((PieceCounts[Color] == 1) && (MinorPieceCount == 1) &&
+			(PieceCounts[OtherColor(Color)] == 0))
+	{
+		Result = false;
+	}
+
+	return(Result);
+}
+
 // TODO(hugo) : Test this function
 internal bool
 IsDraw(chess_game_context* ChessContext, memory_arena* Arena)
@@ -1043,8 +1082,18 @@ IsDraw(chess_game_context* ChessContext, memory_arena* Arena)
 internal void
 InitialiseChessContext(chess_game_context* ChessContext, memory_arena* Arena)
 {
+	// NOTE(hugo) : The context can be reused for several games
+	// (e.g. server rooms), so every field is reset here.
+	for(u32 TileIndex = 0; TileIndex < ArrayCount(ChessContext->Chessboard); ++TileIndex)
+	{
+		ChessContext->Chessboard[TileIndex] = 0;
+	}
 	InitialiseChessboard(ChessContext->Chessboard, Arena);
 	ChessContext->ChessboardConfigSentinel = 0;
+	ChessContext->PlayerCheck = PlayerSelect_None;
+	ChessContext->LastDoubleStepCol = NO_PREVIOUS_DOUBLE_STEP;
+	ChessContext->PlayerToPlay = PieceColor_White;
+	ChessContext->Result = GameResult_None;
 
 	// NOTE(hugo) : We need to check that we are not in a custom config.
 	chess_piece* WhiteKingRook = ChessContext->Chessboard[0 + 8 * 0];
@@ -1095,8 +1144,145 @@ WriteConfig(board_tile* Chessboard)
 	return(Result);
 }
 
+// NOTE(hugo) : The inverse of WriteConfig. The chessboard points into
+// TilePieces, one piece slot per tile, so that mapping a config never allocates.
 internal void
-ApplyMove(chess_game_context* ChessContext, move_params MoveParams, memory_arena* Arena)
+MapConfigToChessboard(board_tile* Chessboard, chess_piece* TilePieces, chessboard_config Config)
+{
+	for(u32 SquareY = 0; SquareY < 8; ++SquareY)
+	{
+		for(u32 SquareX = 0; SquareX < 8; ++SquareX)
+		{
+			u32 SquareIndex = SquareX + 8 * SquareY;
+			u8 ConfigTile = Config.Tiles[SquareIndex];
+			if(ConfigTile == 0)
+			{
+				Chessboard[SquareIndex] = 0;
+			}
+			else
+			{
+				u8 PieceID = ConfigTile - 1;
+				chess_piece* Piece = TilePieces + SquareIndex;
+				Piece->Type = piece_type(PieceID % PieceType_Count);
+				Piece->Color = piece_color(PieceID / PieceType_Count);
+				Chessboard[SquareIndex] = Piece;
+			}
+		}
+	}
+}
+
+// NOTE(hugo) : The type of a legal move from where it goes. A king only
+// goes two files away when castling, a pawn only goes two ranks ahead on
+// a double step, and only takes an empty square en passant.
+internal move_type
+GetMoveTypeToDest(board_tile* Chessboard, v2i InitialP, v2i DestP)
+{
+	move_type Result = MoveType_Regular;
+	chess_piece* Piece = Chessboard[BOARD_COORD(InitialP)];
+	Assert(Piece);
+	if(Piece->Type == PieceType_King)
+	{
+		if(DestP.x - InitialP.x == 2)
+		{
+			Result = MoveType_CastlingKingSide;
+		}
+		else if(InitialP.x - DestP.x == 2)
+		{
+			Result = MoveType_CastlingQueenSide;
+		}
+	}
+	else if(Piece->Type == PieceType_Pawn)
+	{
+		if((DestP.y - InitialP.y == 2) || (InitialP.y - DestP.y == 2))
+		{
+			Result = MoveType_DoubleStepPawn;
+		}
+		else if((DestP.x != InitialP.x) && !Chessboard[BOARD_COORD(DestP)])
+		{
+			Result = MoveType_EnPassant;
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : All the check tests of the player to play at once, so that
+// selecting a piece afterwards is only a lookup. The lists only live in
+// the arena for the time of the build.
+internal void
+BuildLegalMoveTable(chess_game_context* ChessContext, legal_move_table* Table, memory_arena* Arena)
+{
+	temporary_memory LegalMoveTempMemory = BeginTemporaryMemory(Arena);
+	for(u32 SquareIndex = 0; SquareIndex < ArrayCount(Table->DestMasks); ++SquareIndex)
+	{
+		Table->DestMasks[SquareIndex] = 0;
+		chess_piece* Piece = ChessContext->Chessboard[SquareIndex];
+		if(Piece && (Piece->Color == ChessContext->PlayerToPlay))
+		{
+			v2i PieceP = V2i(SquareIndex % 8, SquareIndex / 8);
+			tile_list* PossibleMoveList = GetPossibleMoveList(ChessContext, Piece, PieceP, Arena);
+			if(PossibleMoveList)
+			{
+				DeleteInvalidMoveDueToCheck(ChessContext, Piece, PieceP,
+						&PossibleMoveList, Piece->Color, Arena);
+			}
+			for(tile_list* Move = PossibleMoveList; Move; Move = Move->Next)
+			{
+				Assert(GetMoveTypeToDest(ChessContext->Chessboard, PieceP, Move->P) == Move->MoveType);
+				Table->DestMasks[SquareIndex] |= ((u64)1 << (BOARD_COORD(Move->P)));
+			}
+		}
+	}
+	Table->IsValid = true;
+	EndTemporaryMemory(LegalMoveTempMemory);
+}
+
+internal void
+HashPositionBytes(u32* Hash, void* Bytes, u32 Size)
+{
+	for(u32 ByteIndex = 0; ByteIndex < Size; ++ByteIndex)
+	{
+		*Hash ^= ((u8*)Bytes)[ByteIndex];
+		*Hash *= 16777619;
+	}
+}
+
+// NOTE(hugo) : FNV-1a of everything that a context update carries about
+// the position, so that two ends can tell cheaply whether they agree.
+// Field by field, the padding of the structs is not part of it.
+internal u32
+GetPositionHash(chess_game_context* ChessContext)
+{
+	u32 Result = 2166136261;
+	chessboard_config Config = WriteConfig(ChessContext->Chessboard);
+	HashPositionBytes(&Result, Config.Tiles, sizeof(Config.Tiles));
+	for(u32 ColorIndex = 0; ColorIndex < ArrayCount(ChessContext->CastlingPieceTracker); ++ColorIndex)
+	{
+		castling_piece_tracker* Tracker = ChessContext->CastlingPieceTracker + ColorIndex;
+		u8 TrackerBytes[] =
+		{
+			Tracker->KingHasMoved,
+			Tracker->QueenRook.IsFirstRank, Tracker->QueenRook.HasMoved,
+			Tracker->KingRook.IsFirstRank, Tracker->KingRook.HasMoved,
+		};
+		HashPositionBytes(&Result, TrackerBytes, sizeof(TrackerBytes));
+	}
+	u32 Fields[] =
+	{
+		(u32)ChessContext->PlayerCheck,
+		ChessContext->LastDoubleStepCol,
+		(u32)ChessContext->PlayerToPlay,
+	};
+	HashPositionBytes(&Result, Fields, sizeof(Fields));
+
+	return(Result);
+}
+
+// NOTE(hugo) : Only moves the pieces and records the new config,
+// without any adjudication nor changing the player to play.
+// This is what a replay of already adjudicated moves needs.
+internal void
+PlayMoveOnBoard(chess_game_context* ChessContext, move_params MoveParams, memory_arena* Arena)
 {
 	move_type MoveType = MoveParams.Type;
 	v2i InitialP = MoveParams.InitialP;
@@ -1255,6 +1441,55 @@ ApplyMove(chess_game_context* ChessContext, move_params MoveParams, memory_arena
 	NewChessboardConfigList->Config = WriteConfig(ChessContext->Chessboard);
 	NewChessboardConfigList->Next = ChessContext->ChessboardConfigSentinel;
 	ChessContext->ChessboardConfigSentinel = NewChessboardConfigList;
+}
+
+// NOTE(hugo) : Plays a move that was already adjudicated somewhere else
+// (journal, resume). The check state is left to the caller, it only
+// matters for the last of a series of moves.
+internal void
+ReplayMove(chess_game_context* ChessContext, move_params MoveParams, memory_arena* Arena)
+{
+	PlayMoveOnBoard(ChessContext, MoveParams, Arena);
+	ChessContext->PlayerToPlay = OtherColor(ChessContext->PlayerToPlay);
+}
+
+// NOTE(hugo) : Whether the player to play may play this move, as the
+// client highlights them. The generated lists only live in the arena
+// for the time of the check.
+internal bool
+IsMoveLegal(chess_game_context* ChessContext, move_params MoveParams, memory_arena* Arena)
+{
+	bool Result = false;
+	if(IsInsideBoard(MoveParams.InitialP) && IsInsideBoard(MoveParams.DestP))
+	{
+		chess_piece* Piece = ChessContext->Chessboard[BOARD_COORD(MoveParams.InitialP)];
+		if(Piece && (Piece->Color == ChessContext->PlayerToPlay))
+		{
+			temporary_memory LegalMoveTempMemory = BeginTemporaryMemory(Arena);
+
+			tile_list* PossibleMoveList = GetPossibleMoveList(ChessContext, Piece, MoveParams.InitialP, Arena);
+			if(PossibleMoveList)
+			{
+				DeleteInvalidMoveDueToCheck(ChessContext, Piece, MoveParams.InitialP,
+						&PossibleMoveList, Piece->Color, Arena);
+			}
+			for(tile_list* Move = PossibleMoveList; !Result && Move; Move = Move->Next)
+			{
+				Result = (Move->P.x == MoveParams.DestP.x) && (Move->P.y == MoveParams.DestP.y) &&
+					(Move->MoveType == MoveParams.Type);
+			}
+
+			EndTemporaryMemory(LegalMoveTempMemory);
+		}
+	}
+
+	return(Result);
+}
+
+internal void
+ApplyMove(chess_game_context* ChessContext, move_params MoveParams, memory_arena* Arena)
+{
+	PlayMoveOnBoard(ChessContext, MoveParams, Arena);
 
 	// NOTE(hugo) : Resolve situation for the other player
 	ChessContext->PlayerCheck = SearchForKingCheck(ChessContext, Arena);
@@ -1265,12 +1500,13 @@ ApplyMove(chess_game_context* ChessContext, move_params MoveParams, memory_arena
 	}
 	if(IsCurrentPlayerCheckmate)
 	{
-		printf("Checkmate !!\n");
+		ChessContext->Result = (ChessContext->PlayerToPlay == PieceColor_White) ?
+			GameResult_WhiteWins : GameResult_BlackWins;
 		//DEBUGWriteConfigListToFile(ChessContext->ChessboardConfigSentinel);
 	}
 	else if(IsDraw(ChessContext, Arena))
 	{
-		printf("PAT !!\n");
+		ChessContext->Result = GameResult_Draw;
 		//DEBUGWriteConfigListToFile(ChessContext->ChessboardConfigSentinel);
 	}
 
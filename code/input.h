@@ -9,18 +9,6 @@ enum mouse_button
 	MouseButton_Count,
 };
 
-struct button_state
-{
-	bool IsDown;
-	bool WasDown;
-};
-
-struct mouse_input
-{
-	v2 P;
-	button_state Buttons[MouseButton_Count];
-};
-
 enum scancode
 {
     SCANCODE_UNKNOWN = 0,
@@ -377,42 +365,171 @@ enum scancode
                                  for array bounds */
 };
 
-struct keyboard_input
+// NOTE(hugo) : The input is built from the SDL events, nothing is read
+// when nothing happens. A frame gets every button that went down or up
+// during it, in order, so that a click shorter than a frame is not lost
+// between two reads of the state. What is held is kept as one bit per
+// button, the scancodes first then the mouse buttons.
+#define INPUT_MAX_TRANSITION_COUNT 64
+#define INPUT_BUTTON_COUNT (NUM_SCANCODES + MouseButton_Count)
+
+struct input_transition
 {
-	button_state Buttons[NUM_SCANCODES];
+	u16 Button;
+	bool IsDown;
 };
 
 struct game_input
 {
-	mouse_input Mouse;
-	keyboard_input Keyboard;
+	// NOTE(hugo) : Where the mouse last was, in window pixels.
+	v2 MouseP;
+	u64 HeldButtons[(INPUT_BUTTON_COUNT + 63) / 64];
+
+	// NOTE(hugo) : This frame only. The ones past the capacity are dropped,
+	// the held buttons are still right.
+	u32 TransitionCount;
+	input_transition Transitions[INPUT_MAX_TRANSITION_COUNT];
+
 	float dtForFrame;
+	// NOTE(hugo) : Set by the platform when the window lost what was drawn
+	// in it (resized, uncovered), so the game has to draw even if
+	// nothing changed.
+	bool MustRedraw;
 };
 
-void SDLGetMouseInput(mouse_input* MouseInput)
+u32 GetInputButton(scancode Scancode)
 {
-	s32 X, Y;
-	u32 ButtonStateBitmask = SDL_GetMouseState(&X, &Y);
-	MouseInput->P = V2(X, Y);
-	MouseInput->Buttons[MouseButton_Left].IsDown = (ButtonStateBitmask & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
-	MouseInput->Buttons[MouseButton_Right].IsDown = (ButtonStateBitmask & SDL_BUTTON(SDL_BUTTON_RIGHT)) != 0;
-	MouseInput->Buttons[MouseButton_Middle].IsDown = (ButtonStateBitmask & SDL_BUTTON(SDL_BUTTON_MIDDLE)) != 0;
+	u32 Result = (u32)Scancode;
+	return(Result);
 }
 
-void SDLGetKeyboardInput(keyboard_input* KeyboardInput)
+u32 GetInputButton(mouse_button MouseButton)
 {
-	// TODO(hugo): Is a full copy of the 512 scancodes even a good idea ?
-	s32 KeyCount = 0;
-	const u8* KeyboardState = SDL_GetKeyboardState(&KeyCount);
-	Assert((u32)KeyCount <= ArrayCount(KeyboardInput->Buttons));
-	for(u32 KeyIndex = 0; KeyIndex < (u32)KeyCount; ++KeyIndex)
+	u32 Result = NUM_SCANCODES + (u32)MouseButton;
+	return(Result);
+}
+
+void BeginInputFrame(game_input* Input)
+{
+	Input->TransitionCount = 0;
+}
+
+void AddInputTransition(game_input* Input, u32 Button, bool IsDown)
+{
+	Assert(Button < INPUT_BUTTON_COUNT);
+	u64 Bit = (u64)1 << (Button % 64);
+	if(IsDown)
 	{
-		KeyboardInput->Buttons[KeyIndex].IsDown = (KeyboardState[KeyIndex] != 0);
+		Input->HeldButtons[Button / 64] |= Bit;
 	}
+	else
+	{
+		Input->HeldButtons[Button / 64] &= ~Bit;
+	}
+
+	if(Input->TransitionCount < ArrayCount(Input->Transitions))
+	{
+		input_transition* Transition = Input->Transitions + Input->TransitionCount++;
+		Transition->Button = (u16)Button;
+		Transition->IsDown = IsDown;
+	}
+}
+
+// NOTE(hugo) : Returns true if the event was input.
+bool SDLProcessInputEvent(game_input* Input, SDL_Event* Event)
+{
+	bool Result = true;
+	switch(Event->type)
+	{
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			{
+				// NOTE(hugo) : Held keys repeat, that is not a new press.
+				SDL_Scancode Scancode = Event->key.keysym.scancode;
+				if(!Event->key.repeat && ((u32)Scancode < NUM_SCANCODES))
+				{
+					AddInputTransition(Input, GetInputButton((scancode)Scancode), (Event->type == SDL_KEYDOWN));
+				}
+			} break;
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+			{
+				Input->MouseP = V2(Event->button.x, Event->button.y);
+				bool IsDown = (Event->type == SDL_MOUSEBUTTONDOWN);
+				if(Event->button.button == SDL_BUTTON_LEFT)
+				{
+					AddInputTransition(Input, GetInputButton(MouseButton_Left), IsDown);
+				}
+				else if(Event->button.button == SDL_BUTTON_RIGHT)
+				{
+					AddInputTransition(Input, GetInputButton(MouseButton_Right), IsDown);
+				}
+				else if(Event->button.button == SDL_BUTTON_MIDDLE)
+				{
+					AddInputTransition(Input, GetInputButton(MouseButton_Middle), IsDown);
+				}
+			} break;
+		case SDL_MOUSEMOTION:
+			{
+				Input->MouseP = V2(Event->motion.x, Event->motion.y);
+			} break;
+		case SDL_WINDOWEVENT:
+			{
+				// NOTE(hugo) : What is let go while away never comes as an event.
+				Result = (Event->window.event == SDL_WINDOWEVENT_FOCUS_LOST);
+				if(Result)
+				{
+					for(u32 WordIndex = 0; WordIndex < ArrayCount(Input->HeldButtons); ++WordIndex)
+					{
+						Input->HeldButtons[WordIndex] = 0;
+					}
+				}
+			} break;
+
+		default:
+			{
+				Result = false;
+			} break;
+	}
+
+	return(Result);
+}
+
+bool IsInputButtonPressed(game_input* Input, u32 Button)
+{
+	bool Result = false;
+	for(u32 TransitionIndex = 0; !Result && (TransitionIndex < Input->TransitionCount); ++TransitionIndex)
+	{
+		input_transition* Transition = Input->Transitions + TransitionIndex;
+		Result = (Transition->Button == Button) && Transition->IsDown;
+	}
+	return(Result);
+}
+
+// NOTE(hugo) : Whether the button went down during the frame, even if it
+// is already back up.
+bool Pressed(game_input* Input, scancode Scancode)
+{
+	bool Result = IsInputButtonPressed(Input, GetInputButton(Scancode));
+	return(Result);
+}
+
+bool Pressed(game_input* Input, mouse_button MouseButton)
+{
+	bool Result = IsInputButtonPressed(Input, GetInputButton(MouseButton));
+	return(Result);
+}
+
+bool IsDown(game_input* Input, scancode Scancode)
+{
+	u32 Button = GetInputButton(Scancode);
+	bool Result = (Input->HeldButtons[Button / 64] & ((u64)1 << (Button % 64))) != 0;
+	return(Result);
 }
 
-bool Pressed(button_state Button)
+bool IsDown(game_input* Input, mouse_button MouseButton)
 {
-	bool Result = (Button.IsDown && (!Button.WasDown));
+	u32 Button = GetInputButton(MouseButton);
+	bool Result = (Input->HeldButtons[Button / 64] & ((u64)1 << (Button % 64))) != 0;
 	return(Result);
 }
@@ -1,32 +1,216 @@
 #pragma once
 
 // TODO(hugo) : Parameter order is shit.
+internal void
+InitialiseTextureCache(texture_cache* Cache, u64 BudgetInBytes)
+{
+	*Cache = {};
+	Cache->BudgetInBytes = BudgetInBytes;
+	Cache->Sentinel.Next = &Cache->Sentinel;
+	Cache->Sentinel.Prev = &Cache->Sentinel;
+	for(u32 EntryIndex = 0; EntryIndex < ArrayCount(Cache->Entries); ++EntryIndex)
+	{
+		Cache->Entries[EntryIndex].NextInHash = Cache->FirstFreeEntry;
+		Cache->FirstFreeEntry = Cache->Entries + EntryIndex;
+	}
+}
+
 void InitialiseRenderer(renderer* Renderer, SDL_Renderer* SDLRenderer, u32 RenderArenaSize,
-		v2 WindowSizeInPixels, void* BaseMemory)
+		v2 WindowSizeInPixels, void* BaseMemory, u64 TextureCacheBudget)
 {
 	InitialiseArena(&Renderer->Arena, RenderArenaSize, BaseMemory);
 	Renderer->CommandCount = 0;
+	Renderer->OverlayCommandIndex = RENDER_NO_OVERLAY;
 	Renderer->TemporaryMemory = {};
 	Renderer->SDLContext = SDLRenderer;
 	Renderer->WindowSizeInPixels = WindowSizeInPixels;
+	InitialiseTextureCache(&Renderer->TextureCache, TextureCacheBudget);
+
+	// NOTE(hugo) : The bitmaps have their alpha premultiplied. Without
+	// custom blend modes (before SDL 2.0.6), the edges get a bit darker.
+#if SDL_VERSION_ATLEAST(2, 0, 6)
+	Renderer->BitmapBlendMode = SDL_ComposeCustomBlendMode(
+			SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+			SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+#else
+	Renderer->BitmapBlendMode = SDL_BLENDMODE_BLEND;
+#endif
+
+	Renderer->Target = 0;
+	if(SDL_RenderTargetSupported(SDLRenderer))
+	{
+		Renderer->Target = SDL_CreateTexture(SDLRenderer, SDL_PIXELFORMAT_RGBA8888,
+				SDL_TEXTUREACCESS_TARGET, (s32)WindowSizeInPixels.x, (s32)WindowSizeInPixels.y);
+	}
+}
+
+#define ATLAS_MAX_WIDTH 1024
+// NOTE(hugo) : Between the bitmaps of the atlas, so that filtering
+// never samples a neighbour.
+#define ATLAS_PADDING 1
+#define RENDER_BATCH_SIZE 256
+
+// NOTE(hugo) : Packs the bitmaps on shelves, left to right, and uploads
+// the whole atlas once. The bitmaps are told where they landed.
+void BuildBitmapAtlas(renderer* Renderer, bitmap* Bitmaps, u32 BitmapCount)
+{
+	u32 AtlasWidth = 0;
+	u32 AtlasHeight = 0;
+	u32 ShelfX = 0;
+	u32 ShelfHeight = 0;
+	for(u32 BitmapIndex = 0; BitmapIndex < BitmapCount; ++BitmapIndex)
+	{
+		bitmap* Bitmap = Bitmaps + BitmapIndex;
+		if(!Bitmap->IsValid)
+		{
+			continue;
+		}
+		Assert(Bitmap->Width + ATLAS_PADDING <= ATLAS_MAX_WIDTH);
+
+		if(ShelfX + Bitmap->Width + ATLAS_PADDING > ATLAS_MAX_WIDTH)
+		{
+			AtlasHeight += ShelfHeight;
+			ShelfX = 0;
+			ShelfHeight = 0;
+		}
+		// NOTE(hugo) : The UVs are in pixels until the atlas size is known.
+		Bitmap->AtlasMinUV = V2(ShelfX, AtlasHeight);
+		Bitmap->AtlasMaxUV = V2(ShelfX + Bitmap->Width, AtlasHeight + Bitmap->Height);
+		ShelfX += Bitmap->Width + ATLAS_PADDING;
+		if(ShelfX > AtlasWidth)
+		{
+			AtlasWidth = ShelfX;
+		}
+		if(Bitmap->Height + ATLAS_PADDING > ShelfHeight)
+		{
+			ShelfHeight = Bitmap->Height + ATLAS_PADDING;
+		}
+	}
+	AtlasHeight += ShelfHeight;
+	if((AtlasWidth == 0) || (AtlasHeight == 0))
+	{
+		return;
+	}
+
+	// NOTE(hugo) : Same byte order as the bitmaps (R, G, B, A in memory).
+	Renderer->Atlas = SDL_CreateTexture(Renderer->SDLContext, SDL_PIXELFORMAT_RGBA32,
+			SDL_TEXTUREACCESS_STATIC, AtlasWidth, AtlasHeight);
+	if(Renderer->Atlas)
+	{
+		SDL_SetTextureBlendMode(Renderer->Atlas, Renderer->BitmapBlendMode);
+
+		// NOTE(hugo) : Each bitmap goes up straight from where it was loaded,
+		// which may be the mapped pages of the asset pack. Only the padding
+		// on its right and below it is cleared, the rest is never sampled.
+		u32 ZeroPixels[ATLAS_MAX_WIDTH] = {};
+		for(u32 BitmapIndex = 0; BitmapIndex < BitmapCount; ++BitmapIndex)
+		{
+			bitmap* Bitmap = Bitmaps + BitmapIndex;
+			if(!Bitmap->IsValid)
+			{
+				continue;
+			}
+			Assert(Bitmap->Height + ATLAS_PADDING <= ATLAS_MAX_WIDTH);
+
+			SDL_Rect BitmapRect = {(s32)Bitmap->AtlasMinUV.x, (s32)Bitmap->AtlasMinUV.y,
+				(s32)Bitmap->Width, (s32)Bitmap->Height};
+			SDL_UpdateTexture(Renderer->Atlas, &BitmapRect, Bitmap->Data, 4 * Bitmap->Width);
+
+			SDL_Rect RightPadding = {BitmapRect.x + BitmapRect.w, BitmapRect.y,
+				ATLAS_PADDING, BitmapRect.h + ATLAS_PADDING};
+			SDL_UpdateTexture(Renderer->Atlas, &RightPadding, ZeroPixels, 4 * ATLAS_PADDING);
+			SDL_Rect BottomPadding = {BitmapRect.x, BitmapRect.y + BitmapRect.h, BitmapRect.w, ATLAS_PADDING};
+			SDL_UpdateTexture(Renderer->Atlas, &BottomPadding, ZeroPixels, 4 * BitmapRect.w);
+		}
+	}
+
+	v2 AtlasSize = V2(AtlasWidth, AtlasHeight);
+	for(u32 BitmapIndex = 0; BitmapIndex < BitmapCount; ++BitmapIndex)
+	{
+		bitmap* Bitmap = Bitmaps + BitmapIndex;
+		if(Bitmap->IsValid && Renderer->Atlas)
+		{
+			Bitmap->IsInAtlas = true;
+			Bitmap->AtlasMinUV = Hadamard(Bitmap->AtlasMinUV, V2(1.0f / AtlasSize.x, 1.0f / AtlasSize.y));
+			Bitmap->AtlasMaxUV = Hadamard(Bitmap->AtlasMaxUV, V2(1.0f / AtlasSize.x, 1.0f / AtlasSize.y));
+		}
+	}
 }
 
 void FlushCommands(renderer* Renderer)
 {
 	Renderer->CommandCount = 0;
+	Renderer->OverlayCommandIndex = RENDER_NO_OVERLAY;
 	EndTemporaryMemory(Renderer->TemporaryMemory);
 }
 
+internal texture_cache_entry**
+GetTextureCacheSlot(texture_cache* Cache, u64 AssetID)
+{
+	// NOTE(hugo) : The asset ids are hashes already, only the bits are mixed down.
+	u32 SlotIndex = (u32)((AssetID * 11400714819323198485ull) >> 55);
+	Assert(SlotIndex < ArrayCount(Cache->HashSlots));
+	return(Cache->HashSlots + SlotIndex);
+}
+
+internal void
+UnlinkTextureCacheEntry(texture_cache_entry* Entry)
+{
+	Entry->Prev->Next = Entry->Next;
+	Entry->Next->Prev = Entry->Prev;
+}
+
+internal void
+LinkTextureCacheEntryFirst(texture_cache* Cache, texture_cache_entry* Entry)
+{
+	Entry->Next = Cache->Sentinel.Next;
+	Entry->Prev = &Cache->Sentinel;
+	Entry->Next->Prev = Entry;
+	Entry->Prev->Next = Entry;
+}
+
+internal void
+EvictTextureCacheEntry(texture_cache* Cache, texture_cache_entry* Entry)
+{
+	texture_cache_entry** Slot = GetTextureCacheSlot(Cache, Entry->AssetID);
+	while(*Slot != Entry)
+	{
+		Slot = &(*Slot)->NextInHash;
+	}
+	*Slot = Entry->NextInHash;
+	UnlinkTextureCacheEntry(Entry);
+
+	SDL_DestroyTexture(Entry->Texture);
+	Cache->UsedBytes -= Entry->SizeInBytes;
+
+	*Entry = {};
+	Entry->NextInHash = Cache->FirstFreeEntry;
+	Cache->FirstFreeEntry = Entry;
+}
+
 void FlushRenderCache(renderer* Renderer)
 {
-	for(u32 CacheIndex = 0; 
-			CacheIndex < Renderer->CacheCount;
-			++CacheIndex)
+	texture_cache* Cache = &Renderer->TextureCache;
+	while(Cache->Sentinel.Prev != &Cache->Sentinel)
 	{
-		SDL_DestroyTexture(Renderer->CachedTextures[CacheIndex]);
+		EvictTextureCacheEntry(Cache, Cache->Sentinel.Prev);
 	}
+}
 
-	Renderer->CacheCount = 0;
+// NOTE(hugo) : Destroys every texture of the renderer, before the SDL renderer goes.
+void ReleaseRenderer(renderer* Renderer)
+{
+	FlushRenderCache(Renderer);
+	if(Renderer->Atlas)
+	{
+		SDL_DestroyTexture(Renderer->Atlas);
+		Renderer->Atlas = 0;
+	}
+	if(Renderer->Target)
+	{
+		SDL_DestroyTexture(Renderer->Target);
+		Renderer->Target = 0;
+	}
 }
 
 void BeginRender(renderer* Renderer)
@@ -41,6 +225,32 @@ void EndRender(renderer* Renderer)
 	//FlushRenderCache(Renderer);
 }
 
+// NOTE(hugo) : What is pushed from now on this frame goes over the target.
+void BeginOverlay(renderer* Renderer)
+{
+	Renderer->OverlayCommandIndex = Renderer->CommandCount;
+}
+
+// NOTE(hugo) : A batch never goes across the start of the overlay, the
+// commands on each side of it do not draw on the same texture.
+internal u32
+GetRenderPassEnd(renderer* Renderer, u32 CommandIndex)
+{
+	u32 Result = Renderer->CommandCount;
+	if((CommandIndex < Renderer->OverlayCommandIndex) && (Renderer->OverlayCommandIndex < Result))
+	{
+		Result = Renderer->OverlayCommandIndex;
+	}
+	return(Result);
+}
+
+internal void
+CopyRenderTarget(renderer* Renderer)
+{
+	SDL_SetRenderTarget(Renderer->SDLContext, 0);
+	SDL_RenderCopy(Renderer->SDLContext, Renderer->Target, 0, 0);
+}
+
 void PushCommand(renderer* Renderer, render_command Command)
 {
 	render_command* PushedCommand = PushStruct(&Renderer->Arena, render_command);
@@ -57,48 +267,196 @@ v2 SwitchBetweenWindowRenderCoords(renderer* Renderer, v2 P)
 	return(Result);
 }
 
-SDL_Texture* FindTextureInCache(renderer* Renderer, void* Data)
+// NOTE(hugo) : A texture found is now the most recently drawn.
+SDL_Texture* FindTextureInCache(renderer* Renderer, u64 AssetID)
 {
+	texture_cache* Cache = &Renderer->TextureCache;
+	texture_cache_entry* Entry = *GetTextureCacheSlot(Cache, AssetID);
+	while(Entry && (Entry->AssetID != AssetID))
+	{
+		Entry = Entry->NextInHash;
+	}
+
 	SDL_Texture* Found = 0;
-	for(u32 DataIndex = 0;
-			(!Found) && (DataIndex < Renderer->CacheCount);
-			++DataIndex)
+	if(Entry)
 	{
-		void* CachedData = Renderer->CachedData[DataIndex];
-		if(CachedData == Data)
-		{
-			Found = Renderer->CachedTextures[DataIndex];
-		}
+		UnlinkTextureCacheEntry(Entry);
+		LinkTextureCacheEntryFirst(Cache, Entry);
+		Found = Entry->Texture;
+		++Cache->Hits;
+	}
+	else
+	{
+		++Cache->Misses;
 	}
 
 	return(Found);
 }
 
-void PushRenderCache(renderer* Renderer, SDL_Texture* Texture, void* Data)
+// NOTE(hugo) : The cache owns the texture from now on. A texture bigger
+// than the whole budget still goes in, alone, since it is about to be drawn.
+void PushRenderCache(renderer* Renderer, SDL_Texture* Texture, u64 AssetID, u64 SizeInBytes)
+{
+	texture_cache* Cache = &Renderer->TextureCache;
+	while((Cache->Sentinel.Prev != &Cache->Sentinel) &&
+			(!Cache->FirstFreeEntry || (Cache->UsedBytes + SizeInBytes > Cache->BudgetInBytes)))
+	{
+		EvictTextureCacheEntry(Cache, Cache->Sentinel.Prev);
+		++Cache->Evictions;
+	}
+
+	texture_cache_entry* Entry = Cache->FirstFreeEntry;
+	Assert(Entry);
+	Cache->FirstFreeEntry = Entry->NextInHash;
+
+	Entry->AssetID = AssetID;
+	Entry->Texture = Texture;
+	Entry->SizeInBytes = SizeInBytes;
+	texture_cache_entry** Slot = GetTextureCacheSlot(Cache, AssetID);
+	Entry->NextInHash = *Slot;
+	*Slot = Entry;
+	LinkTextureCacheEntryFirst(Cache, Entry);
+	Cache->UsedBytes += SizeInBytes;
+}
+
+internal SDL_Rect
+GetBitmapDestRect(renderer* Renderer, render_command* Command)
 {
-	Assert(Renderer->CacheCount < ArrayCount(Renderer->CachedData));
-	Renderer->CachedData[Renderer->CacheCount] = Data;
-	Renderer->CachedTextures[Renderer->CacheCount] = Texture;
-	++Renderer->CacheCount;
+	v2 BitmapSize = V2(Command->Bitmap.Width, Command->Bitmap.Height);
+	v2 OffsetP = Hadamard(Command->Bitmap.Offset, BitmapSize);
+	rect2 DestRect = RectFromMinSize(Command->Pos - OffsetP, BitmapSize);
+
+	SDL_Rect Result = SDLRect(DestRect);
+	Result.y = Renderer->WindowSizeInPixels.y - Result.y;
+	return(Result);
+}
+
+// NOTE(hugo) : Draws the atlas bitmaps that follow from CommandIndex on,
+// two triangles each, in one draw. Returns the index of the last one.
+internal u32
+RenderAtlasBatch(renderer* Renderer, u32 CommandIndex)
+{
+	render_command* Commands = (render_command *)Renderer->Arena.Base;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	SDL_Vertex Vertices[4 * RENDER_BATCH_SIZE];
+	s32 Indices[6 * RENDER_BATCH_SIZE];
+	u32 SpriteCount = 0;
+	for(;;)
+	{
+		render_command* Command = Commands + CommandIndex;
+		SDL_Rect Dest = GetBitmapDestRect(Renderer, Command);
+		v2 MinUV = Command->Bitmap.AtlasMinUV;
+		v2 MaxUV = Command->Bitmap.AtlasMaxUV;
+
+		SDL_Vertex* Vertex = Vertices + 4 * SpriteCount;
+		SDL_Color White = {255, 255, 255, 255};
+		Vertex[0].position.x = (float)Dest.x;
+		Vertex[0].position.y = (float)Dest.y;
+		Vertex[0].tex_coord.x = MinUV.x;
+		Vertex[0].tex_coord.y = MinUV.y;
+		Vertex[1].position.x = (float)(Dest.x + Dest.w);
+		Vertex[1].position.y = (float)Dest.y;
+		Vertex[1].tex_coord.x = MaxUV.x;
+		Vertex[1].tex_coord.y = MinUV.y;
+		Vertex[2].position.x = (float)(Dest.x + Dest.w);
+		Vertex[2].position.y = (float)(Dest.y + Dest.h);
+		Vertex[2].tex_coord.x = MaxUV.x;
+		Vertex[2].tex_coord.y = MaxUV.y;
+		Vertex[3].position.x = (float)Dest.x;
+		Vertex[3].position.y = (float)(Dest.y + Dest.h);
+		Vertex[3].tex_coord.x = MinUV.x;
+		Vertex[3].tex_coord.y = MaxUV.y;
+		for(u32 VertexIndex = 0; VertexIndex < 4; ++VertexIndex)
+		{
+			Vertex[VertexIndex].color = White;
+		}
+
+		s32* Index = Indices + 6 * SpriteCount;
+		s32 FirstVertex = 4 * SpriteCount;
+		Index[0] = FirstVertex + 0;
+		Index[1] = FirstVertex + 1;
+		Index[2] = FirstVertex + 2;
+		Index[3] = FirstVertex + 0;
+		Index[4] = FirstVertex + 2;
+		Index[5] = FirstVertex + 3;
+		++SpriteCount;
+
+		render_command* NextCommand = Command + 1;
+		if((CommandIndex + 1 >= GetRenderPassEnd(Renderer, CommandIndex)) || (SpriteCount == RENDER_BATCH_SIZE) ||
+				(NextCommand->Type != RenderCommand_Bitmap) || !NextCommand->Bitmap.IsInAtlas)
+		{
+			break;
+		}
+		++CommandIndex;
+	}
+
+	SDL_RenderGeometry(Renderer->SDLContext, Renderer->Atlas, Vertices, 4 * SpriteCount, Indices, 6 * SpriteCount);
+#else
+	// NOTE(hugo) : No geometry before SDL 2.0.18, still one texture for all.
+	render_command* Command = Commands + CommandIndex;
+	SDL_Rect Dest = GetBitmapDestRect(Renderer, Command);
+	s32 AtlasWidth = 0;
+	s32 AtlasHeight = 0;
+	SDL_QueryTexture(Renderer->Atlas, 0, 0, &AtlasWidth, &AtlasHeight);
+	SDL_Rect Source = {};
+	Source.x = (s32)(Command->Bitmap.AtlasMinUV.x * AtlasWidth + 0.5f);
+	Source.y = (s32)(Command->Bitmap.AtlasMinUV.y * AtlasHeight + 0.5f);
+	Source.w = Command->Bitmap.Width;
+	Source.h = Command->Bitmap.Height;
+	SDL_RenderCopy(Renderer->SDLContext, Renderer->Atlas, &Source, &Dest);
+#endif
+
+	return(CommandIndex);
 }
 
 // TODO(hugo) : Is it better to change the coordinate system when rendering
 // or when a command is pushed in the renderer's buffer ?
 void Render(renderer* Renderer)
 {
+	u64 StartCounter = SDL_GetPerformanceCounter();
+	if(Renderer->Target)
+	{
+		SDL_SetRenderTarget(Renderer->SDLContext, Renderer->Target);
+	}
+
+	bool IsTargetCopied = !Renderer->Target;
 	for(u32 CommandIndex = 0; CommandIndex < Renderer->CommandCount; ++CommandIndex)
 	{
+		if((CommandIndex == Renderer->OverlayCommandIndex) && !IsTargetCopied)
+		{
+			CopyRenderTarget(Renderer);
+			IsTargetCopied = true;
+		}
+
 		render_command* Command = (render_command *)Renderer->Arena.Base + CommandIndex;
 		switch(Command->Type)
 		{
 			case RenderCommand_Rect:
 				{
-					rect2 DrawRect = Command->Rect;
-					SDL_Rect CommandRect = SDLRect(DrawRect);
-					CommandRect.y = Renderer->WindowSizeInPixels.y - CommandRect.y;
+					// NOTE(hugo) : The rects that follow in the same color go in the same draw.
+					SDL_Rect Rects[RENDER_BATCH_SIZE];
+					u32 RectCount = 0;
+					render_command* BatchCommand = Command;
+					for(;;)
+					{
+						SDL_Rect* BatchRect = Rects + RectCount++;
+						*BatchRect = SDLRect(BatchCommand->Rect);
+						BatchRect->y = Renderer->WindowSizeInPixels.y - BatchRect->y;
+
+						render_command* NextCommand = BatchCommand + 1;
+						if((CommandIndex + 1 >= GetRenderPassEnd(Renderer, CommandIndex)) || (RectCount == ArrayCount(Rects)) ||
+								(NextCommand->Type != RenderCommand_Rect) ||
+								(NextCommand->Color.r != Command->Color.r) || (NextCommand->Color.g != Command->Color.g) ||
+								(NextCommand->Color.b != Command->Color.b) || (NextCommand->Color.a != Command->Color.a))
+						{
+							break;
+						}
+						BatchCommand = NextCommand;
+						++CommandIndex;
+					}
 
 					SDLSetRenderColor(Renderer->SDLContext, Command->Color);
-					SDL_RenderFillRect(Renderer->SDLContext, &CommandRect);
+					SDL_RenderFillRects(Renderer->SDLContext, Rects, RectCount);
 				} break;
 
 			case RenderCommand_Line:
@@ -130,6 +488,11 @@ void Render(renderer* Renderer)
 			case RenderCommand_Bitmap:
 				{
 					Assert(Command->Bitmap.IsValid);
+					if(Command->Bitmap.IsInAtlas)
+					{
+						CommandIndex = RenderAtlasBatch(Renderer, CommandIndex);
+						break;
+					}
 
 					v2 BitmapSize = V2(Command->Bitmap.Width, Command->Bitmap.Height);
 					v2 OffsetP = Hadamard(Command->Bitmap.Offset, BitmapSize);
@@ -143,7 +506,7 @@ void Render(renderer* Renderer)
 					u32 Depth = 32;
 					u32 Pitch = 4 * Command->Bitmap.Width;
 
-					SDL_Texture* BitmapTexture = FindTextureInCache(Renderer, Command->Bitmap.Data);
+					SDL_Texture* BitmapTexture = FindTextureInCache(Renderer, Command->Bitmap.AssetID);
 					if(!BitmapTexture)
 					{
 						// NOTE(hugo) : The bitmap is not in the cache. Add it
@@ -156,8 +519,9 @@ void Render(renderer* Renderer)
 								BitmapSurface);
 						SDL_FreeSurface(BitmapSurface);
 						Assert(BitmapTexture);
+						SDL_SetTextureBlendMode(BitmapTexture, Renderer->BitmapBlendMode);
 
-						PushRenderCache(Renderer, BitmapTexture, Command->Bitmap.Data);
+						PushRenderCache(Renderer, BitmapTexture, Command->Bitmap.AssetID, Pitch * Command->Bitmap.Height);
 					}
 
 					SDL_Rect SDLDestRect = SDLRect(DestRect);
@@ -193,7 +557,15 @@ void Render(renderer* Renderer)
 		}
 	}
 
+	if(!IsTargetCopied)
+	{
+		CopyRenderTarget(Renderer);
+	}
+	RecordProfileSection(&GlobalProfiler, ProfileSection_Render, StartCounter);
+
+	StartCounter = SDL_GetPerformanceCounter();
 	SDL_RenderPresent(Renderer->SDLContext);
+	RecordProfileSection(&GlobalProfiler, ProfileSection_Present, StartCounter);
 }
 
 void PushLine(renderer* Renderer, v2 Begin, v2 End, v4 Color)
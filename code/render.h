@@ -68,6 +68,43 @@ struct render_command
 	};
 };
 
+// NOTE(hugo) : The textures made from bitmaps, by asset id. Holds at most
+// BudgetInBytes of texels, and when a new one does not fit, the textures
+// that were drawn the longest time ago are destroyed to make room.
+#define TEXTURE_CACHE_ENTRY_COUNT 256
+#define TEXTURE_CACHE_HASH_SIZE 512
+
+struct texture_cache_entry
+{
+	u64 AssetID;
+	SDL_Texture* Texture;
+	u64 SizeInBytes;
+
+	// NOTE(hugo) : Also the link of the free list.
+	texture_cache_entry* NextInHash;
+
+	// NOTE(hugo) : From the most recently drawn to the least.
+	texture_cache_entry* Next;
+	texture_cache_entry* Prev;
+};
+
+struct texture_cache
+{
+	texture_cache_entry* HashSlots[TEXTURE_CACHE_HASH_SIZE];
+	texture_cache_entry Entries[TEXTURE_CACHE_ENTRY_COUNT];
+	texture_cache_entry* FirstFreeEntry;
+	texture_cache_entry Sentinel;
+
+	u64 BudgetInBytes;
+	u64 UsedBytes;
+
+	u64 Hits;
+	u64 Misses;
+	u64 Evictions;
+};
+
+#define RENDER_NO_OVERLAY 0xFFFFFFFF
+
 struct renderer
 {
 	u32 CommandCount;
@@ -77,14 +114,25 @@ struct renderer
 
 	v2 WindowSizeInPixels;
 
+	// NOTE(hugo) : Retained mode. When there is a target, the commands draw
+	// into it instead of the window, and whatever they do not draw over
+	// stays from the previous frames. The window then only gets one copy
+	// of the target. 0 when the SDL renderer cannot render to a texture,
+	// then the commands have to draw the whole frame each time.
+	SDL_Texture* Target;
+	// NOTE(hugo) : The commands from this one on are drawn straight on the
+	// window, over the copy of the target, and so are gone the next frame.
+	// RENDER_NO_OVERLAY when there are none.
+	u32 OverlayCommandIndex;
+
+	SDL_BlendMode BitmapBlendMode;
+
+	// NOTE(hugo) : The bitmaps known at startup packed in a single texture,
+	// so that consecutive bitmap commands are a single draw.
+	SDL_Texture* Atlas;
+
 	// NOTE(hugo) : Caching to avoid 
 	// over computation of SDL_Texture
-	// WARNING(hugo) : VERY_IMPORTANT(hugo) :
-	//    The textures in the cache are _never_ destroyed in SDL
-	//    So if there is a cache-flush someday (when we hit the cache size limit)
-	//    then I _must_ destroy the texture to avoid memory leaks
-	void* CachedData[16];
-	SDL_Texture* CachedTextures[16];
-	u32 CacheCount;
+	texture_cache TextureCache;
 };
 
@@ -1,9 +1,7 @@
 #ifdef _WIN32
 #include <SDL.h>
-#include <SDL_net.h>
 #else
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_net.h>
 #endif
 
 #include <rivten.h>
@@ -16,6 +14,10 @@
 
 global_variable u32 GlobalWindowWidth = 512;
 global_variable u32 GlobalWindowHeight = 512;
+global_variable u64 GlobalTextureCacheBudget = Megabytes(64);
+global_variable char GlobalAssetPackPath[1024];
+
+#define SYNCHESS_CLIENT_EVENT_LOG_PATH "synchess_client.events"
 
 internal SDL_Rect
 SDLRect(rect2 Rect)
@@ -38,15 +40,25 @@ SDLSetRenderColor(SDL_Renderer* Renderer, v4 Color)
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "synchess_assetpack.h"
 struct bitmap
 {
 	u32 Width;
 	u32 Height;
 	void* Data;
+	// NOTE(hugo) : Names the image for the texture cache, never 0.
+	// The pixels have their alpha premultiplied.
+	u64 AssetID;
 
 	// NOTE(hugo) : Offset is in percent relative to the bitmap size
 	v2 Offset;
 	bool IsValid;
+
+	// NOTE(hugo) : Where the bitmap sits in the atlas of the renderer,
+	// if it was packed in there.
+	bool IsInAtlas;
+	v2 AtlasMinUV;
+	v2 AtlasMaxUV;
 };
 
 u32 SafeCastToU32(s32 Value)
@@ -72,18 +84,36 @@ bitmap LoadBitmap(char* Filename, v2 Offset = V2(0.0f, 0.0f))
 	Assert(Result.Height > 0);
 
 	Result.Offset = Offset;
+	Result.AssetID = GetAssetID(Filename);
+	PremultiplyAlpha((u8*)Result.Data, Result.Width * Result.Height);
 
 	Result.IsValid = true;
 
 	return(Result);
 }
 
+// NOTE(hugo) : The pixels stay in the mapped pages of the pack, so it
+// must stay open as long as the bitmap is used.
+bitmap LoadPackedBitmap(asset_pack* Pack, asset_pack_entry* Entry, v2 Offset = V2(0.0f, 0.0f))
+{
+	bitmap Result = {};
+	Result.Data = (u8*)Pack->Base + Entry->Offset;
+	Result.Width = Entry->Width;
+	Result.Height = Entry->Height;
+	Result.Offset = Offset;
+	Result.AssetID = Entry->AssetID;
+	Result.IsValid = true;
+
+	return(Result);
+}
+
 void FreeBitmap(bitmap Bitmap)
 {
 	stbi_image_free(Bitmap.Data);
 }
 
 
+#include "synchess_profiler.h"
 #include "render.h"
 #include "render.cpp"
 
@@ -94,6 +124,19 @@ struct game_memory
 };
 
 #include "synchess.h"
+#include "synchess_log.h"
+#include "synchess_network.h"
+
+// NOTE(hugo) : See synchess_client_network.h.
+struct client_network;
+
+// NOTE(hugo) : What a square of the board looks like on screen.
+struct square_look
+{
+	v4 BackgroundColor;
+	bool HasPiece;
+	chess_piece Piece;
+};
 
 enum user_mode
 {
@@ -108,6 +151,7 @@ struct game_state
 	memory_arena GameArena;
 
 	chess_game_context ChessContext;
+	chess_piece TilePieces[64];
 
 	u32 SquareSizeInPixels;
 
@@ -115,19 +159,50 @@ struct game_state
 	chess_piece* PawnToPromote;
 
 	move_type TileHighlighted[64];
+	// NOTE(hugo) : Built once per position, when it is ours to play in it.
+	legal_move_table LegalMoves;
+	asset_pack AssetPack;
 	bitmap PieceBitmaps[PieceType_Count * PieceColor_Count];
 	v2i ClickedTile;
 	v2i SelectedPieceP;
+	// NOTE(hugo) : The move the server plays for us after the opponent's,
+	// of type MoveType_None when there is none.
+	move_params Premove;
 
 	// NOTE(hugo) : Network
 	// TODO(hugo) : Are we sure we should put the network
 	// stuff into the game state or into its own struct ?
 	// Maybe do this into a platform_api struct in the future
-	TCPsocket ClientSocket;
+	client_network* Network;
 	piece_color MyPlayerColor; 
 	bool HasServerGameStarted;
+	// NOTE(hugo) : As of the last context update, the server keeps the real time.
+	u32 ClockMS[PieceColor_Count];
+	log_ring* LogRing;
+
+	// NOTE(hugo) : What it takes to get back to our game after losing the connexion.
+	u32 GameID;
+	u32 ReconnectToken;
+	u32 MoveSequence;
+	// NOTE(hugo) : Our move is played on our board as soon as it is made.
+	// Until the server answers, MoveSequence and ConfirmedPosition stay
+	// those of the position it was played in, that we go back to if the
+	// server does not play it.
+	bool IsMovePredicted;
+	u32 PredictedHash;
+	network_message_chess_context_update ConfirmedPosition;
+	// NOTE(hugo) : Until the network thread says it is connected.
+	bool IsConnectionLost;
+	u32 ConnectionIndex;
 
 	bool LocalGame;
+	// NOTE(hugo) : Set when what is on screen is not up to date anymore,
+	// nothing is drawn otherwise.
+	bool IsDirty;
+	// NOTE(hugo) : What the render target holds, only the squares that
+	// look different now are drawn again.
+	square_look DrawnSquares[64];
+	bool IsBoardDrawn;
 
 	bool IsInitialised;
 };
@@ -155,6 +230,22 @@ RGB8ToV4(rgb8 Color)
 	return(Result);
 }
 
+internal bool
+IsSameSquareLook(square_look* A, square_look* B)
+{
+	bool Result = (A->BackgroundColor.r == B->BackgroundColor.r) &&
+		(A->BackgroundColor.g == B->BackgroundColor.g) &&
+		(A->BackgroundColor.b == B->BackgroundColor.b) &&
+		(A->BackgroundColor.a == B->BackgroundColor.a) &&
+		(A->HasPiece == B->HasPiece);
+	if(Result && A->HasPiece)
+	{
+		Result = (A->Piece.Type == B->Piece.Type) && (A->Piece.Color == B->Piece.Color);
+	}
+
+	return(Result);
+}
+
 internal void
 DisplayChessboardToConsole(board_tile* Chessboard)
 {
@@ -253,22 +344,27 @@ GetPieceBitmap(game_state* GameState, chess_piece Piece)
 	return(Result);
 }
 
+// NOTE(hugo) : From the asset pack if there is one with the pieces at
+// that size, else decoded from the PNG files of the data folder.
 internal void
-LoadPieceBitmaps(bitmap* Bitmaps)
+LoadPieceBitmaps(bitmap* Bitmaps, asset_pack* Pack, u32 Size)
 {
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_Pawn] = LoadBitmap("../data/WhitePawn.png");
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_Knight] = LoadBitmap("../data/WhiteKnight.png");
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_Bishop] = LoadBitmap("../data/WhiteBishop.png");
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_Rook] = LoadBitmap("../data/WhiteRook.png");
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_Queen] = LoadBitmap("../data/WhiteQueen.png");
-	Bitmaps[PieceColor_White * PieceType_Count + PieceType_King] = LoadBitmap("../data/WhiteKing.png");
-
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_Pawn] = LoadBitmap("../data/BlackPawn.png");
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_Knight] = LoadBitmap("../data/BlackKnight.png");
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_Bishop] = LoadBitmap("../data/BlackBishop.png");
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_Rook] = LoadBitmap("../data/BlackRook.png");
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_Queen] = LoadBitmap("../data/BlackQueen.png");
-	Bitmaps[PieceColor_Black * PieceType_Count + PieceType_King] = LoadBitmap("../data/BlackKing.png");
+	Assert(ArrayCount(PieceAssetNames) == PieceColor_Count * PieceType_Count);
+	for(u32 PieceIndex = 0; PieceIndex < PieceColor_Count * PieceType_Count; ++PieceIndex)
+	{
+		char* Name = PieceAssetNames[PieceIndex];
+		asset_pack_entry* Entry = Pack->Base ? FindPackedAsset(Pack, Name, Size) : 0;
+		if(Entry)
+		{
+			Bitmaps[PieceIndex] = LoadPackedBitmap(Pack, Entry);
+		}
+		else
+		{
+			char Filename[256];
+			snprintf(Filename, sizeof(Filename), "../data/%s.png", Name);
+			Bitmaps[PieceIndex] = LoadBitmap(Filename);
+		}
+	}
 }
 
 internal v2i
@@ -324,39 +420,201 @@ HighlightPossibleMoves(game_state* GameState, tile_list* TileList)
 }
 
 internal void
-MapConfigToChessboard(board_tile* Chessboard, chessboard_config Config)
+HighlightLegalMoves(game_state* GameState, v2i PieceP)
 {
-	for(u32 SquareY = 0; SquareY < 8; ++SquareY)
+	Assert(GameState->LegalMoves.IsValid);
+	u64 DestMask = GameState->LegalMoves.DestMasks[BOARD_COORD(PieceP)];
+	for(u32 SquareIndex = 0; SquareIndex < ArrayCount(GameState->TileHighlighted); ++SquareIndex)
 	{
-		for(u32 SquareX = 0; SquareX < 8; ++SquareX)
+		if(DestMask & ((u64)1 << SquareIndex))
 		{
-			u8 ConfigTile = Config.Tiles[SquareX + 8 * SquareY];
-			chess_piece* PieceToWrite = Chessboard[SquareX + 8 * SquareY];
-			if(ConfigTile == 0)
+			v2i DestP = V2i(SquareIndex % 8, SquareIndex / 8);
+			GameState->TileHighlighted[SquareIndex] = GetMoveTypeToDest(GameState->ChessContext.Chessboard, PieceP, DestP);
+		}
+	}
+}
+
+#define PROFILER_OVERLAY_HEIGHT 100.0f
+#define PROFILER_OVERLAY_MARGIN 4.0f
+#define PROFILER_OVERLAY_MS_PER_PIXEL 0.25f
+#define PROFILER_OVERLAY_SLOWEST_BAR_WIDTH 5.0f
+
+// NOTE(hugo) : Along the bottom of the window, a bar per frame of the ring
+// from the oldest on the left, with the time of each section stacked in
+// its color, under a line at the budget of a 60Hz frame. On the right,
+// the slowest frames since the start, in the same scale. What does not
+// fit in the panel is cut.
+internal void
+PushProfilerOverlay(renderer* Renderer, frame_profiler* Profiler)
+{
+	v4 SectionColors[ProfileSection_Count] =
+	{
+		RGB8ToV4(RGB8(86, 156, 214)),
+		RGB8ToV4(RGB8(78, 201, 176)),
+		RGB8ToV4(RGB8(220, 220, 170)),
+		RGB8ToV4(RGB8(197, 134, 192)),
+		RGB8ToV4(RGB8(206, 145, 120)),
+		RGB8ToV4(RGB8(244, 71, 71)),
+	};
+
+	v2 WindowSize = Renderer->WindowSizeInPixels;
+	PushRect(Renderer, RectFromMinSize(V2(0.0f, 0.0f), V2(WindowSize.x, PROFILER_OVERLAY_HEIGHT)),
+			V4(0.1f, 0.1f, 0.1f, 1.0f));
+
+	float BarMaxHeight = PROFILER_OVERLAY_HEIGHT - 2.0f * PROFILER_OVERLAY_MARGIN;
+	float SlowestWidth = PROFILER_SLOWEST_FRAME_COUNT * (PROFILER_OVERLAY_SLOWEST_BAR_WIDTH + 1.0f);
+	float SlowestMinX = WindowSize.x - PROFILER_OVERLAY_MARGIN - SlowestWidth;
+	float GraphWidth = SlowestMinX - 3.0f * PROFILER_OVERLAY_MARGIN;
+	float FrameBarWidth = GraphWidth / (PROFILER_FRAME_COUNT - 1);
+
+	// NOTE(hugo) : A section after the other for all the bars, so that
+	// each color is a single batch.
+	float BarHeights[PROFILER_FRAME_COUNT - 1 + PROFILER_SLOWEST_FRAME_COUNT] = {};
+	u64 FirstFrameIndex = GetFirstProfileFrameIndex(Profiler);
+	for(u32 SectionIndex = 0; SectionIndex < ProfileSection_Count; ++SectionIndex)
+	{
+		u32 BarIndex = 0;
+		for(u64 FrameIndex = FirstFrameIndex; FrameIndex < Profiler->FrameCount; ++FrameIndex, ++BarIndex)
+		{
+			profile_frame* Frame = Profiler->Frames + (FrameIndex % PROFILER_FRAME_COUNT);
+			float X = PROFILER_OVERLAY_MARGIN + BarIndex * FrameBarWidth;
+			float Height = GetProfileMS(Profiler, Frame->SectionElapsedCounters[SectionIndex]) / PROFILER_OVERLAY_MS_PER_PIXEL;
+			if(Height > BarMaxHeight - BarHeights[BarIndex])
 			{
-				PieceToWrite = 0;
+				Height = BarMaxHeight - BarHeights[BarIndex];
 			}
-			else
+			if(Height > 0.0f)
+			{
+				PushRect(Renderer, RectFromMinSize(V2(X, PROFILER_OVERLAY_MARGIN + BarHeights[BarIndex]),
+							V2(FrameBarWidth, Height)), SectionColors[SectionIndex]);
+				BarHeights[BarIndex] += Height;
+			}
+		}
+
+		BarIndex = PROFILER_FRAME_COUNT - 1;
+		for(u32 SlowIndex = 0; SlowIndex < Profiler->SlowestFrameCount; ++SlowIndex, ++BarIndex)
+		{
+			profile_frame* Frame = Profiler->SlowestFrames + SlowIndex;
+			float X = SlowestMinX + SlowIndex * (PROFILER_OVERLAY_SLOWEST_BAR_WIDTH + 1.0f);
+			float Height = GetProfileMS(Profiler, Frame->SectionElapsedCounters[SectionIndex]) / PROFILER_OVERLAY_MS_PER_PIXEL;
+			if(Height > BarMaxHeight - BarHeights[BarIndex])
+			{
+				Height = BarMaxHeight - BarHeights[BarIndex];
+			}
+			if(Height > 0.0f)
 			{
-				u8 PieceID = ConfigTile - 1;
-				piece_type PieceType = piece_type(PieceID % PieceType_Count);
-				piece_color PieceColor = piece_color(PieceID / PieceColor_Count);
-				chess_piece Piece = {};
-				Piece.Type = PieceType;
-				Piece.Color = PieceColor;
-				// TODO(hugo) : Search in a LUT ?
-				NotImplemented;
+				PushRect(Renderer, RectFromMinSize(V2(X, PROFILER_OVERLAY_MARGIN + BarHeights[BarIndex]),
+							V2(PROFILER_OVERLAY_SLOWEST_BAR_WIDTH, Height)), SectionColors[SectionIndex]);
+				BarHeights[BarIndex] += Height;
 			}
 		}
 	}
+
+	float BudgetY = PROFILER_OVERLAY_MARGIN + (1000.0f / 60.0f) / PROFILER_OVERLAY_MS_PER_PIXEL;
+	v4 BudgetColor = V4(1.0f, 1.0f, 1.0f, 1.0f);
+	PushLine(Renderer, V2(PROFILER_OVERLAY_MARGIN, BudgetY), V2(SlowestMinX - 2.0f * PROFILER_OVERLAY_MARGIN, BudgetY), BudgetColor);
+	PushLine(Renderer, V2(SlowestMinX, BudgetY), V2(WindowSize.x - PROFILER_OVERLAY_MARGIN, BudgetY), BudgetColor);
 }
 
-#include "synchess_network.h"
+#include "synchess_client_network.h"
+
+// NOTE(hugo) : Returns false if the message is lost.
+internal bool
+NetSendMessage(game_state* GameState, network_synchess_message* Message)
+{
+	bool Result = !GameState->IsConnectionLost &&
+		QueueServerMessage(GameState->Network, GameState->ConnectionIndex, Message);
+	return(Result);
+}
+
+// NOTE(hugo) : The position part of a context update, clocks aside.
+internal void
+GetBoardPosition(game_state* GameState, network_message_chess_context_update* Position)
+{
+	chess_game_context* ChessContext = &GameState->ChessContext;
+	Position->NewBoardConfig = WriteConfig(ChessContext->Chessboard);
+	Position->CastlingPieceTracker[0] = ChessContext->CastlingPieceTracker[0];
+	Position->CastlingPieceTracker[1] = ChessContext->CastlingPieceTracker[1];
+	Position->PlayerCheck = ChessContext->PlayerCheck;
+	Position->LastDoubleStepCol = ChessContext->LastDoubleStepCol;
+	Position->PlayerToPlay = ChessContext->PlayerToPlay;
+}
+
+internal void
+SetBoardPosition(game_state* GameState, network_message_chess_context_update* Position)
+{
+	chess_game_context* ChessContext = &GameState->ChessContext;
+	MapConfigToChessboard(ChessContext->Chessboard, GameState->TilePieces, Position->NewBoardConfig);
+	ChessContext->CastlingPieceTracker[0] = Position->CastlingPieceTracker[0];
+	ChessContext->CastlingPieceTracker[1] = Position->CastlingPieceTracker[1];
+	ChessContext->PlayerCheck             = Position->PlayerCheck;
+	ChessContext->LastDoubleStepCol       = Position->LastDoubleStepCol;
+	ChessContext->PlayerToPlay            = Position->PlayerToPlay;
+	ChessContext->Result = GameResult_None;
+	GameState->LegalMoves.IsValid = false;
+}
+
+// NOTE(hugo) : Takes back the move we played ahead of the server, if any.
+internal void
+RollBackPredictedMove(game_state* GameState, u32 ServerMoveSequence)
+{
+	if(GameState->IsMovePredicted)
+	{
+		SetBoardPosition(GameState, &GameState->ConfirmedPosition);
+		GameState->IsMovePredicted = false;
+		LogEvent(GameState->LogRing, LogEvent_MoveRolledBack, GameState->MoveSequence + 1, ServerMoveSequence);
+	}
+}
+
+internal void
+LoseConnection(game_state* GameState)
+{
+	// NOTE(hugo) : The resume replays the moves we missed on the position
+	// of MoveSequence, whether or not our move got there.
+	RollBackPredictedMove(GameState, GameState->MoveSequence);
+	GameState->IsConnectionLost = true;
+	// NOTE(hugo) : A move we sent may be lost with the connexion, the
+	// server tells us whose turn it is once we are back.
+	GameState->UserMode = UserMode_WaitForServer;
+	GameState->Premove.Type = MoveType_None;
+	LogEvent(GameState->LogRing, LogEvent_ConnectionLost, GameState->GameID);
+}
+
+// NOTE(hugo) : The first thing said on a new connexion. Back to our seat
+// if we had one, back to watching or waiting for a game otherwise.
+internal void
+SayHello(game_state* GameState, u32 ConnectionIndex)
+{
+	GameState->ConnectionIndex = ConnectionIndex;
+	GameState->IsConnectionLost = false;
+
+	network_synchess_message Message = {};
+	if(GameState->ReconnectToken)
+	{
+		Message.Type = NetworkMessageType_ResumeGame;
+		Message.ResumeGame.GameID = GameState->GameID;
+		Message.ResumeGame.ReconnectToken = GameState->ReconnectToken;
+		Message.ResumeGame.LastMoveSequence = GameState->MoveSequence;
+	}
+	else if(GameState->GameID)
+	{
+		Message.Type = NetworkMessageType_SpectateGame;
+		Message.SpectateGame.GameID = GameState->GameID;
+		GameState->MyPlayerColor = PieceColor_Count;
+	}
+	else
+	{
+		Message.Type = NetworkMessageType_JoinGame;
+		Message.JoinGame.Rating = SYNCHESS_DEFAULT_RATING;
+	}
+
+	NetSendMessage(GameState, &Message);
+}
 
 // TODO(hugo) : Get rid of the SDL_Renderer parameter in there : 
 // this can be done using the platform_api struct (see HandmadeHero for more)
 internal void
-GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SDLRenderer, TCPsocket ClientSocket)
+GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SDLRenderer, client_network* Network, log_ring* LogRing)
 {
 	Assert(sizeof(game_state) <= GameMemory->StorageSize);
 	game_state* GameState = (game_state*) GameMemory->Storage;
@@ -368,7 +626,7 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 
 		// TODO(hugo) : Resizable window
 		InitialiseRenderer(&GameState->Renderer, SDLRenderer, RenderArenaSize,
-				V2(GlobalWindowWidth, GlobalWindowHeight), RenderArenaMemoryBase);
+				V2(GlobalWindowWidth, GlobalWindowHeight), RenderArenaMemoryBase, GlobalTextureCacheBudget);
 
 		u64 GameArenaSize = Megabytes(128);
 		void* GameArenaMemoryBase = (u8*)GameMemory->Storage + sizeof(game_state) + RenderArenaSize;
@@ -376,105 +634,230 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 		InitialiseChessContext(&GameState->ChessContext, &GameState->GameArena);
 
 		GameState->SquareSizeInPixels = 64;
-		LoadPieceBitmaps(&GameState->PieceBitmaps[0]);
+		OpenAssetPack(&GameState->AssetPack, GlobalAssetPackPath);
+		LoadPieceBitmaps(&GameState->PieceBitmaps[0], &GameState->AssetPack, GameState->SquareSizeInPixels);
+		BuildBitmapAtlas(&GameState->Renderer, &GameState->PieceBitmaps[0], ArrayCount(GameState->PieceBitmaps));
 
 		GameState->ChessContext.PlayerToPlay = PieceColor_White;
+		BuildLegalMoveTable(&GameState->ChessContext, &GameState->LegalMoves, &GameState->GameArena);
 
-		GameState->ClientSocket = ClientSocket;
+		GameState->Network = Network;
+		GameState->IsConnectionLost = true;
+		// NOTE(hugo) : So that the hello asks to watch that game.
+		GameState->GameID = Network->SpectatedGameID;
+		GameState->LogRing = LogRing;
 		GameState->LocalGame = false;
 		GameState->MyPlayerColor = PieceColor_Count; // NOTE(hugo) : Putting it to something invalid.
 		GameState->HasServerGameStarted = false;
 
 		GameState->UserMode = GameState->LocalGame ? UserMode_MakeMove : UserMode_WaitForServer;
+		GameState->IsDirty = true;
 
 		GameState->IsInitialised = true;
 	}
 
 	// NOTE(hugo) : Update network state
 	// {
+	u64 StartCounter = SDL_GetPerformanceCounter();
 	if(!GameState->LocalGame)
 	{
-		s32 ClientSocketActivity = SDLNet_SocketReady(GameState->ClientSocket);
-		Assert(ClientSocketActivity != -1);
-		if(ClientSocketActivity > 0)
+		// NOTE(hugo) : Everything the network thread got since the last update.
+		client_network_event Event = {};
+		while(PopSPSCQueue(&GameState->Network->Inbound, &Event))
 		{
-			network_synchess_message Message = {};
-			s32 ReceivedBytes = SDLNet_TCP_Recv(GameState->ClientSocket, &Message, sizeof(Message));
-			Assert(ReceivedBytes <= (s32)sizeof(Message));
+			GameState->IsDirty = true;
 
-			// NOTE(hugo) : Receiving message
-			switch(Message.Type)
+			if(Event.Type == ClientNetworkEvent_Connected)
 			{
-				case NetworkMessageType_ConnectionEstablished:
-					{
-						printf("Connection Established\n");
-						Assert(GameState->MyPlayerColor == PieceColor_Count);
-						GameState->MyPlayerColor = Message.ConnectionEstablished.GivenColor;
-						printf("We are %s\n", (GameState->MyPlayerColor == PieceColor_White) ? 
-								"white" : "black");
-					} break;
-				case NetworkMessageType_Quit:
-					{
-						printf("Quit\n");
-					} break;
-				case NetworkMessageType_NoRoomForClient:
-					{
-						// TODO(hugo) : Do something intelligent here
-						printf("No Room for you...\n");
-						InvalidCodePath;
-					} break;
-				case NetworkMessageType_ChessContextUpdate:
-					{
-						MapConfigToChessboard(GameState->ChessContext.Chessboard, Message.ContextUpdate.NewBoardConfig);
-						GameState->ChessContext.CastlingPieceTracker[0] = Message.ContextUpdate.CastlingPieceTracker[0];
-						GameState->ChessContext.CastlingPieceTracker[1] = Message.ContextUpdate.CastlingPieceTracker[1];
-						GameState->ChessContext.PlayerCheck             = Message.ContextUpdate.PlayerCheck;
-						GameState->ChessContext.LastDoubleStepCol       = Message.ContextUpdate.LastDoubleStepCol;
-						GameState->ChessContext.PlayerToPlay            = Message.ContextUpdate.PlayerToPlay;
-					} break;
-				case NetworkMessageType_GameStarted:
-					{
-						GameState->HasServerGameStarted = true;
-						if(GameState->MyPlayerColor == PieceColor_White)
+				SayHello(GameState, Event.ConnectionIndex);
+			}
+			else if(Event.Type == ClientNetworkEvent_ConnectionLost)
+			{
+				// NOTE(hugo) : The server closed the connexion, or the network dropped it.
+				LoseConnection(GameState);
+			}
+			else
+			{
+				network_synchess_message Message = Event.Message;
+				// NOTE(hugo) : Receiving message
+				switch(Message.Type)
+				{
+					case NetworkMessageType_ConnectionEstablished:
 						{
+							Assert(GameState->MyPlayerColor == PieceColor_Count);
+							GameState->MyPlayerColor = Message.ConnectionEstablished.GivenColor;
+							GameState->ReconnectToken = Message.ConnectionEstablished.ReconnectToken;
+							// NOTE(hugo) : PieceColor_Count when we are spectating.
+							LogEvent(GameState->LogRing, LogEvent_ConnectionEstablished, GameState->MyPlayerColor);
+						} break;
+					case NetworkMessageType_Quit:
+						{
+							LogEvent(GameState->LogRing, LogEvent_Quit);
+						} break;
+					case NetworkMessageType_NoRoomForClient:
+						{
+							// NOTE(hugo) : The answer to our hello when the game we wanted
+							// to resume or watch is over or never was, or when there is no
+							// room left to match us. We stay connected and idle, and the
+							// next connexion asks for a new game.
+							LogEvent(GameState->LogRing, LogEvent_NoRoomForClient, GameState->GameID);
+							GameState->ReconnectToken = 0;
+							GameState->GameID = 0;
+							GameState->MyPlayerColor = PieceColor_Count;
+							GameState->HasServerGameStarted = false;
+							GameState->Premove.Type = MoveType_None;
+							GameState->UserMode = UserMode_WaitForServer;
+						} break;
+					case NetworkMessageType_ChessContextUpdate:
+						{
+							network_message_chess_context_update* Update = &Message.ContextUpdate;
+							bool IsBoardUpToDate = false;
+							if(GameState->IsMovePredicted)
+							{
+								// NOTE(hugo) : The answer to the move we played ahead. If the
+								// server played it in the same position, our board is right
+								// already. If it did not play it, the update takes it back.
+								// One further on also has the premove of the opponent in it.
+								u32 PredictedSequence = GameState->MoveSequence + 1;
+								IsBoardUpToDate = (Update->MoveSequence == PredictedSequence) &&
+									(Update->PositionHash == GameState->PredictedHash);
+								if(!IsBoardUpToDate && (Update->MoveSequence <= PredictedSequence))
+								{
+									LogEvent(GameState->LogRing, LogEvent_MoveRolledBack, PredictedSequence, Update->MoveSequence);
+								}
+								GameState->IsMovePredicted = false;
+							}
+							if(!IsBoardUpToDate)
+							{
+								SetBoardPosition(GameState, Update);
+							}
+							GameState->ClockMS[PieceColor_White] = Update->ClockMS[PieceColor_White];
+							GameState->ClockMS[PieceColor_Black] = Update->ClockMS[PieceColor_Black];
+							GameState->MoveSequence = Update->MoveSequence;
+							LogEvent(GameState->LogRing, LogEvent_ClockUpdate, GameState->ClockMS[PieceColor_White],
+									GameState->ClockMS[PieceColor_Black], GameState->ChessContext.PlayerToPlay);
+
+							// NOTE(hugo) : The server answered, whoever's turn it is now.
+							// Our premove, if any, was played or dropped with the opponent's move.
+							ClearTileHighlighted(GameState);
+							GameState->Premove.Type = MoveType_None;
 							GameState->UserMode = UserMode_MakeMove;
-						}
-					} break;
-				case NetworkMessageType_MoveDone:
-					{
-						// NOTE(hugo) : The server should not
-						// send this message types
-						InvalidCodePath;
-					} break;
+						} break;
+					case NetworkMessageType_GameStarted:
+						{
+							LogEvent(GameState->LogRing, LogEvent_JoinedGame, Message.GameStarted.GameID);
+							GameState->GameID = Message.GameStarted.GameID;
+							GameState->MoveSequence = 0;
+							GameState->HasServerGameStarted = true;
+							if(GameState->MyPlayerColor == PieceColor_White)
+							{
+								GameState->UserMode = UserMode_MakeMove;
+							}
+						} break;
+					case NetworkMessageType_FlagFall:
+						{
+							piece_color FlaggedColor = Message.FlagFall.FlaggedColor;
+							LogEvent(GameState->LogRing, LogEvent_LostOnTime, FlaggedColor);
+							// NOTE(hugo) : Our move came after the flag, it was not played.
+							RollBackPredictedMove(GameState, GameState->MoveSequence);
+							GameState->ClockMS[FlaggedColor] = 0;
+							GameState->HasServerGameStarted = false;
+							GameState->UserMode = UserMode_WaitForServer;
+						} break;
+					case NetworkMessageType_GameEnded:
+						{
+							// NOTE(hugo) : The update with the last move came just before,
+							// the board is already the final one.
+							LogEvent(GameState->LogRing, LogEvent_GameOver, GameState->GameID, Message.GameEnded.Result);
+							GameState->ChessContext.Result = Message.GameEnded.Result;
+							GameState->HasServerGameStarted = false;
+							GameState->Premove.Type = MoveType_None;
+							ClearTileHighlighted(GameState);
+							GameState->UserMode = UserMode_WaitForServer;
+						} break;
+					case NetworkMessageType_GameResumed:
+						{
+							network_message_game_resumed* Resumed = &Message.GameResumed;
+							GameState->MyPlayerColor = Resumed->GivenColor;
+							GameState->ClockMS[PieceColor_White] = Resumed->ClockMS[PieceColor_White];
+							GameState->ClockMS[PieceColor_Black] = Resumed->ClockMS[PieceColor_Black];
+							GameState->HasServerGameStarted = true;
+							if(!Resumed->IsSnapshotFollowing)
+							{
+								// NOTE(hugo) : Our position is MoveSequence moves behind, the
+								// server sent those moves instead of the whole board.
+								chess_game_context* ChessContext = &GameState->ChessContext;
+								for(u32 MoveIndex = 0; MoveIndex < Resumed->TailMoveCount; ++MoveIndex)
+								{
+									ReplayMove(ChessContext, Resumed->TailMoves[MoveIndex], &GameState->GameArena);
+								}
+								if(Resumed->TailMoveCount > 0)
+								{
+									ChessContext->PlayerCheck = SearchForKingCheck(ChessContext, &GameState->GameArena);
+									GameState->LegalMoves.IsValid = false;
+								}
+								GameState->MoveSequence = Resumed->MoveSequence;
+								ClearTileHighlighted(GameState);
+								GameState->UserMode = UserMode_MakeMove;
+							}
+							LogEvent(GameState->LogRing, LogEvent_GameResumed, Resumed->GameID, Resumed->MoveSequence,
+									Resumed->TailMoveCount, Resumed->IsSnapshotFollowing);
+						} break;
+					case NetworkMessageType_MoveDone:
+					case NetworkMessageType_JoinGame:
+					case NetworkMessageType_SpectateGame:
+					case NetworkMessageType_ResumeGame:
+					case NetworkMessageType_Premove:
+						{
+							// NOTE(hugo) : The server should not
+							// send this message types
+							InvalidCodePath;
+						} break;
 
-				InvalidDefaultCase;
+					InvalidDefaultCase;
+				}
 			}
 		}
+		RecordProfileSection(&GlobalProfiler, ProfileSection_Network, StartCounter);
+		StartCounter = SDL_GetPerformanceCounter();
+
+		bool IsMyTurnToPlay = GameState->HasServerGameStarted &&
+			(GameState->ChessContext.PlayerToPlay == GameState->MyPlayerColor);
+		// NOTE(hugo) : In the update that brought the position, not on the click.
+		if(IsMyTurnToPlay && !GameState->LegalMoves.IsValid)
+		{
+			BuildLegalMoveTable(&GameState->ChessContext, &GameState->LegalMoves, &GameState->GameArena);
+		}
 
 		if(GameState->UserMode != UserMode_WaitForServer)
 		{
-			bool IsMyTurnToPlay = GameState->HasServerGameStarted &&
-				(GameState->ChessContext.PlayerToPlay == GameState->MyPlayerColor);
+			// NOTE(hugo) : During the opponent's turn our move is only a premove.
+			bool IsPremoving = GameState->HasServerGameStarted &&
+				(GameState->MyPlayerColor != PieceColor_Count) && !IsMyTurnToPlay;
 
-			if(IsMyTurnToPlay && Pressed(Input->Mouse.Buttons[MouseButton_Left]))
+			if((IsMyTurnToPlay || IsPremoving) && Pressed(Input, MouseButton_Left))
 			{
-				GameState->ClickedTile = GetClickedTile(GameState->ChessContext.Chessboard, Input->Mouse.P);
+				GameState->ClickedTile = GetClickedTile(GameState->ChessContext.Chessboard, Input->MouseP);
 				Assert(IsInsideBoard(GameState->ClickedTile));
 				chess_piece* Piece = GameState->ChessContext.Chessboard[BOARD_COORD(GameState->ClickedTile)];
-				if(Piece && (Piece->Color == GameState->ChessContext.PlayerToPlay))
+				if(Piece && (Piece->Color == GameState->MyPlayerColor))
 				{
 					ClearTileHighlighted(GameState);
 
-					temporary_memory HighlightingTileTempMemory = BeginTemporaryMemory(&GameState->GameArena);
-					tile_list* PossibleMoveList = GetPossibleMoveList(&GameState->ChessContext, Piece, 
-							GameState->ClickedTile, &GameState->GameArena);
-					if(PossibleMoveList)
+					if(IsMyTurnToPlay)
 					{
-						DeleteInvalidMoveDueToCheck(&GameState->ChessContext, Piece, GameState->ClickedTile, &PossibleMoveList, GameState->ChessContext.PlayerToPlay, &GameState->GameArena);
+						HighlightLegalMoves(GameState, GameState->ClickedTile);
+					}
+					else
+					{
+						// NOTE(hugo) : A premove is checked against the position
+						// it will be played in, that we do not know yet.
+						temporary_memory HighlightingTileTempMemory = BeginTemporaryMemory(&GameState->GameArena);
+						tile_list* PossibleMoveList = GetPossibleMoveList(&GameState->ChessContext, Piece, 
+								GameState->ClickedTile, &GameState->GameArena);
+						HighlightPossibleMoves(GameState, PossibleMoveList);
+						EndTemporaryMemory(HighlightingTileTempMemory);
 					}
-
-					HighlightPossibleMoves(GameState, PossibleMoveList);
-					EndTemporaryMemory(HighlightingTileTempMemory);
 
 
 					GameState->SelectedPieceP = GameState->ClickedTile;
@@ -490,19 +873,54 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 						MoveParams.DestP = GameState->ClickedTile;
 
 						network_synchess_message Message = {};
-						Message.Type = NetworkMessageType_MoveDone;
-						Message.MoveDone = MoveParams;
+						if(IsMyTurnToPlay)
+						{
+							// NOTE(hugo) : On our board at once, whatever the round trip.
+							// The move is highlighted so it is legal here, the server
+							// still has the last word on it.
+							GetBoardPosition(GameState, &GameState->ConfirmedPosition);
+							ApplyMove(&GameState->ChessContext, MoveParams, &GameState->GameArena);
+							GameState->LegalMoves.IsValid = false;
+							GameState->PredictedHash = GetPositionHash(&GameState->ChessContext);
+							GameState->IsMovePredicted = true;
+							ClearTileHighlighted(GameState);
 
-						NetSendMessage(GameState->ClientSocket, &Message);
-						GameState->UserMode = UserMode_WaitForServer;
+							Message.Type = NetworkMessageType_MoveDone;
+							Message.MoveDone.Move = MoveParams;
+							Message.MoveDone.MoveSequence = GameState->MoveSequence;
+							GameState->UserMode = UserMode_WaitForServer;
+						}
+						else
+						{
+							Message.Type = NetworkMessageType_Premove;
+							Message.Premove = MoveParams;
+							GameState->Premove = MoveParams;
+							ClearTileHighlighted(GameState);
+						}
+
+						// NOTE(hugo) : A move lost with the connexion is handled when
+						// the network thread tells us it is lost.
+						NetSendMessage(GameState, &Message);
 					}
 				}
+				GameState->IsDirty = true;
 			}
-			if(Pressed(Input->Mouse.Buttons[MouseButton_Right]))
+			if(Pressed(Input, MouseButton_Right))
 			{
 				ClearTileHighlighted(GameState);
+				if(GameState->Premove.Type != MoveType_None)
+				{
+					GameState->Premove.Type = MoveType_None;
+
+					network_synchess_message Message = {};
+					Message.Type = NetworkMessageType_Premove;
+					Message.Premove.Type = MoveType_None;
+					NetSendMessage(GameState, &Message);
+				}
+				GameState->IsDirty = true;
 			}
 		}
+		RecordProfileSection(&GlobalProfiler, ProfileSection_Update, StartCounter);
 	}
 	// }
 
@@ -514,25 +932,15 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 		{
 			case UserMode_MakeMove:
 				{
-					if(Pressed(Input->Mouse.Buttons[MouseButton_Left]))
+					if(Pressed(Input, MouseButton_Left))
 					{
-						GameState->ClickedTile = GetClickedTile(GameState->ChessContext.Chessboard, Input->Mouse.P);
+						GameState->ClickedTile = GetClickedTile(GameState->ChessContext.Chessboard, Input->MouseP);
 						Assert(IsInsideBoard(GameState->ClickedTile));
 						chess_piece* Piece = GameState->ChessContext.Chessboard[BOARD_COORD(GameState->ClickedTile)];
 						if(Piece && (Piece->Color == GameState->ChessContext.PlayerToPlay))
 						{
 							ClearTileHighlighted(GameState);
-
-							temporary_memory HighlightingTileTempMemory = BeginTemporaryMemory(&GameState->GameArena);
-							tile_list* PossibleMoveList = GetPossibleMoveList(&GameState->ChessContext, Piece, 
-									GameState->ClickedTile, &GameState->GameArena);
-							if(PossibleMoveList)
-							{
-								DeleteInvalidMoveDueToCheck(&GameState->ChessContext, Piece, GameState->ClickedTile, &PossibleMoveList, GameState->ChessContext.PlayerToPlay, &GameState->GameArena);
-							}
-
-							HighlightPossibleMoves(GameState, PossibleMoveList);
-							EndTemporaryMemory(HighlightingTileTempMemory);
+							HighlightLegalMoves(GameState, GameState->ClickedTile);
 
 
 							GameState->SelectedPieceP = GameState->ClickedTile;
@@ -549,38 +957,44 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 								MoveParams.InitialP = GameState->SelectedPieceP;
 								MoveParams.DestP = GameState->ClickedTile;
 								ApplyMove(&GameState->ChessContext, MoveParams, &GameState->GameArena);
+								GameState->LegalMoves.IsValid = false;
 
 								ClearTileHighlighted(GameState);
 
 							}
 						}
 					}
-					if(Pressed(Input->Mouse.Buttons[MouseButton_Right]))
+					if(Pressed(Input, MouseButton_Right))
 					{
 						ClearTileHighlighted(GameState);
 					}
+					if(Pressed(Input, MouseButton_Left) ||
+							Pressed(Input, MouseButton_Right))
+					{
+						GameState->IsDirty = true;
+					}
 				} break;
 			case UserMode_PromotePawn:
 				{
 					Assert(GameState->PawnToPromote);
 
 					bool PromotionChosen = false;
-					if(Pressed(Input->Keyboard.Buttons[SCANCODE_Q]))
+					if(Pressed(Input, SCANCODE_Q))
 					{
 						GameState->PawnToPromote->Type = PieceType_Queen;
 						PromotionChosen = true;
 					}
-					else if(Pressed(Input->Keyboard.Buttons[SCANCODE_R]))
+					else if(Pressed(Input, SCANCODE_R))
 					{
 						GameState->PawnToPromote->Type = PieceType_Rook;
 						PromotionChosen = true;
 					}
-					else if(Pressed(Input->Keyboard.Buttons[SCANCODE_B]))
+					else if(Pressed(Input, SCANCODE_B))
 					{
 						GameState->PawnToPromote->Type = PieceType_Bishop;
 						PromotionChosen = true;
 					}
-					else if(Pressed(Input->Keyboard.Buttons[SCANCODE_N]))
+					else if(Pressed(Input, SCANCODE_N))
 					{
 						GameState->PawnToPromote->Type = PieceType_Knight;
 						PromotionChosen = true;
@@ -589,30 +1003,56 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 					if(PromotionChosen)
 					{
 						GameState->UserMode = UserMode_MakeMove;
+						GameState->LegalMoves.IsValid = false;
 						GameState->PawnToPromote = 0;
+						GameState->IsDirty = true;
 					}
 
 				} break;
 			InvalidDefaultCase;
 		}
+
+		// NOTE(hugo) : Right after the move, not on the next click.
+		if(!GameState->LegalMoves.IsValid)
+		{
+			BuildLegalMoveTable(&GameState->ChessContext, &GameState->LegalMoves, &GameState->GameArena);
+		}
+		RecordProfileSection(&GlobalProfiler, ProfileSection_Update, StartCounter);
 	}
 
 #if 0
-	if(Pressed(Input->Keyboard.Buttons[SCANCODE_E]))
+	if(Pressed(Input, SCANCODE_E))
 	{
-		Assert(ClientSocket);
+		Assert(!GameState->IsConnectionLost);
 		network_synchess_message Message = {};
 		Message.Type = NetworkMessageType_NoRoomForClient;
-		NetSendMessage(GameState->ClientSocket, &Message);
+		NetSendMessage(GameState, &Message);
 	}
 #endif
 	// }
 
+	// NOTE(hugo) : The overlay shows the frames that came before, so it
+	// changes with every frame.
+	if(!GameState->IsDirty && !Input->MustRedraw && !GlobalProfiler.IsOverlayVisible)
+	{
+		return;
+	}
+	GameState->IsDirty = false;
+	StartCounter = SDL_GetPerformanceCounter();
+
 	renderer* Renderer = &GameState->Renderer;
+	if(Input->MustRedraw || !Renderer->Target)
+	{
+		// NOTE(hugo) : The target may have been lost with the window content.
+		GameState->IsBoardDrawn = false;
+	}
 
 	BeginRender(Renderer);
 
-	PushClear(Renderer, V4(0.0f, 0.0f, 0.0f, 1.0f));
+	if(!GameState->IsBoardDrawn)
+	{
+		PushClear(Renderer, V4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
 
 	// NOTE(hugo) : Render background
 	// {
@@ -624,38 +1064,101 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 	u32 SquareSizeInPixels = (u32)(BoardSizeInPixels / 8);
 	v2i SquareSize = V2i(SquareSizeInPixels, SquareSizeInPixels);
 
+	// NOTE(hugo) : The squares are pushed as all the backgrounds, one color
+	// after the other, then all the pieces, so that the renderer can draw
+	// each run of them at once. No two squares overlap so the order
+	// does not change the picture.
+	u32 DirtySquares[64];
+	u32 DirtySquareCount = 0;
 	for(u32 SquareY = 0; SquareY < 8; ++SquareY)
 	{
 		for(u32 SquareX = 0; SquareX < 8; ++SquareX)
 		{
-			v2 SquareMin = Hadamard(V2(SquareX, SquareY), V2(SquareSize)) + BoardMin;
-			rect2 SquareRect = RectFromMinSize(SquareMin, V2(SquareSize));
 			bool IsWhiteTile = (SquareX + SquareY) % 2 != 0;
-			v4 SquareBackgroundColor = (IsWhiteTile) ? 
+			square_look Look = {};
+			Look.BackgroundColor = (IsWhiteTile) ? 
 				V4(1.0f, 1.0f, 1.0f, 1.0f) : RGB8ToV4(RGB8(64, 146, 59));
 
 			if(GameState->TileHighlighted[SquareX + 8 * SquareY] != MoveType_None)
 			{
-				SquareBackgroundColor = V4(0.0f, 1.0f, 1.0f, 1.0f);
+				Look.BackgroundColor = V4(0.0f, 1.0f, 1.0f, 1.0f);
+			}
+			move_params* Premove = &GameState->Premove;
+			if((Premove->Type != MoveType_None) &&
+					(((Premove->InitialP.x == (s32)SquareX) && (Premove->InitialP.y == (s32)SquareY)) ||
+					 ((Premove->DestP.x == (s32)SquareX) && (Premove->DestP.y == (s32)SquareY))))
+			{
+				Look.BackgroundColor = RGB8ToV4(RGB8(214, 92, 64));
 			}
 
-			PushRect(Renderer, SquareRect, SquareBackgroundColor);
-
-			// NOTE(hugo) : Draw the possible piece
 			chess_piece* Piece = GameState->ChessContext.Chessboard[SquareX + 8 * SquareY];
 			if(Piece)
 			{
-				v2 SquareMin = Hadamard(V2(SquareX, SquareY), V2(SquareSize)) + BoardMin;
-				bitmap PieceBitmap = GetPieceBitmap(GameState, *Piece);
-				if(PieceBitmap.IsValid)
-				{
-					PushBitmap(&GameState->Renderer, PieceBitmap, SquareMin);
-				}
+				Look.HasPiece = true;
+				Look.Piece = *Piece;
+			}
+
+			square_look* DrawnLook = GameState->DrawnSquares + (SquareX + 8 * SquareY);
+			if(GameState->IsBoardDrawn && IsSameSquareLook(&Look, DrawnLook))
+			{
+				continue;
+			}
+			*DrawnLook = Look;
+
+			DirtySquares[DirtySquareCount++] = SquareX + 8 * SquareY;
+		}
+	}
+
+	bool IsBackgroundPushed[64] = {};
+	for(u32 DirtyIndex = 0; DirtyIndex < DirtySquareCount; ++DirtyIndex)
+	{
+		if(IsBackgroundPushed[DirtyIndex])
+		{
+			continue;
+		}
+
+		v4 BackgroundColor = GameState->DrawnSquares[DirtySquares[DirtyIndex]].BackgroundColor;
+		for(u32 SameColorIndex = DirtyIndex; SameColorIndex < DirtySquareCount; ++SameColorIndex)
+		{
+			u32 SquareIndex = DirtySquares[SameColorIndex];
+			square_look* Look = GameState->DrawnSquares + SquareIndex;
+			if(!IsBackgroundPushed[SameColorIndex] &&
+					(Look->BackgroundColor.r == BackgroundColor.r) && (Look->BackgroundColor.g == BackgroundColor.g) &&
+					(Look->BackgroundColor.b == BackgroundColor.b) && (Look->BackgroundColor.a == BackgroundColor.a))
+			{
+				v2 SquareMin = Hadamard(V2(SquareIndex % 8, SquareIndex / 8), V2(SquareSize)) + BoardMin;
+				rect2 SquareRect = RectFromMinSize(SquareMin, V2(SquareSize));
+				PushRect(Renderer, SquareRect, Look->BackgroundColor);
+				IsBackgroundPushed[SameColorIndex] = true;
+			}
+		}
+	}
+
+	// NOTE(hugo) : Draw the possible pieces
+	for(u32 DirtyIndex = 0; DirtyIndex < DirtySquareCount; ++DirtyIndex)
+	{
+		u32 SquareIndex = DirtySquares[DirtyIndex];
+		square_look* Look = GameState->DrawnSquares + SquareIndex;
+		if(Look->HasPiece)
+		{
+			bitmap PieceBitmap = GetPieceBitmap(GameState, Look->Piece);
+			if(PieceBitmap.IsValid)
+			{
+				v2 SquareMin = Hadamard(V2(SquareIndex % 8, SquareIndex / 8), V2(SquareSize)) + BoardMin;
+				PushBitmap(&GameState->Renderer, PieceBitmap, SquareMin);
 			}
 		}
 	}
+	GameState->IsBoardDrawn = true;
 	// }
 
+	if(GlobalProfiler.IsOverlayVisible)
+	{
+		BeginOverlay(Renderer);
+		PushProfilerOverlay(Renderer, &GlobalProfiler);
+	}
+	RecordProfileSection(&GlobalProfiler, ProfileSection_Commands, StartCounter);
+
 	// NOTE(hugo): Render the commands
 	Render(Renderer);
 	EndRender(Renderer);
@@ -663,9 +1166,60 @@ GameUpdateAndRender(game_memory* GameMemory, game_input* Input, SDL_Renderer* SD
 
 s32 main(s32 ArgumentCount, char** Arguments)
 { 
+	// NOTE(hugo) : 0 means we want to play, not to watch.
+	u32 SpectatedGameID = 0;
+	char* EventLogPath = SYNCHESS_CLIENT_EVENT_LOG_PATH;
+	// NOTE(hugo) : By default the loop sleeps until there is input, something
+	// from the server or a timer of the game, and only draws what changed.
+	// The fixed-rate loop updates and draws every frame.
+	bool IsFixedRate = false;
+	char* AssetPackPath = 0;
+	char* TracePath = SYNCHESS_CLIENT_TRACE_PATH;
+	for(s32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+	{
+		if((strcmp(Arguments[ArgumentIndex], "-spectate") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			SpectatedGameID = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Arguments[ArgumentIndex], "-events") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			EventLogPath = Arguments[++ArgumentIndex];
+		}
+		else if(strcmp(Arguments[ArgumentIndex], "-fixed-rate") == 0)
+		{
+			IsFixedRate = true;
+		}
+		else if((strcmp(Arguments[ArgumentIndex], "-texture-cache-mb") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			GlobalTextureCacheBudget = Megabytes((u64)atoi(Arguments[++ArgumentIndex]));
+		}
+		else if((strcmp(Arguments[ArgumentIndex], "-pack") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			AssetPackPath = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Arguments[ArgumentIndex], "-trace") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			TracePath = Arguments[++ArgumentIndex];
+		}
+	}
+
 	u32 SDLInitResult = SDL_Init(SDL_INIT_EVERYTHING);
 	Assert(SDLInitResult == 0);
 
+	// NOTE(hugo) : By default the pack sits next to the executable, so
+	// that the client can be started from any folder.
+	if(AssetPackPath)
+	{
+		snprintf(GlobalAssetPackPath, sizeof(GlobalAssetPackPath), "%s", AssetPackPath);
+	}
+	else
+	{
+		char* BasePath = SDL_GetBasePath();
+		snprintf(GlobalAssetPackPath, sizeof(GlobalAssetPackPath), "%s%s",
+				BasePath ? BasePath : "", SYNCHESS_ASSET_PACK_PATH);
+		SDL_free(BasePath);
+	}
+
 	bool Running = true;
 
 	// TODO(hugo) : Should the window be resizable ?
@@ -686,12 +1240,20 @@ s32 main(s32 ArgumentCount, char** Arguments)
 
 	Assert(GameMemory.Storage);
 
-	game_input Inputs[2] = {};
-	game_input* NewInput = Inputs + 0;
-	game_input* OldInput = Inputs + 1;
+	// NOTE(hugo) : The game loop is the only thread that logs.
+	u64 LogArenaSize = EVENT_LOG_RING_SIZE * sizeof(log_record);
+	memory_arena LogArena = {};
+	InitialiseArena(&LogArena, LogArenaSize, Allocate_(LogArenaSize));
+	event_log EventLog = {};
+	log_ring* LogRing = AddLogRing(&EventLog, "client", &LogArena);
+	if(!StartEventLog(&EventLog, EventLogPath))
+	{
+		LogRing = 0;
+	}
+
+	game_input Input = {};
 
 	// NOTE(hugo) : Timing info
-	u32 LastCounter = SDL_GetTicks();
 	u32 MonitorRefreshHz = 60;
 	SDL_DisplayMode DisplayMode = {};
 	if(SDL_GetCurrentDisplayMode(0, &DisplayMode) == 0)
@@ -705,34 +1267,19 @@ s32 main(s32 ArgumentCount, char** Arguments)
 	u32 TargetMSPerFrame = (u32)(1000.0f / GameUpdateHz);
 
 	// TODO(hugo) : Maybe a little bit ugly to do this here
-	NewInput->dtForFrame = 1.0f / GameUpdateHz;
-	OldInput->dtForFrame = 1.0f / GameUpdateHz;
+	Input.dtForFrame = 1.0f / GameUpdateHz;
 
-	// NOTE(hugo):  SDLNet Init
+	// NOTE(hugo) : Network thread
 	// {
-	s32 SDLNetInitResult = SDLNet_Init();
-	Assert(SDLNetInitResult != -1);
-
-	SDLNet_SocketSet SocketSet = SDLNet_AllocSocketSet(1);
-	Assert(SocketSet);
-
-	u32 ServerPort = SYNCHESS_PORT;
-	char* ServerName = SYNCHESS_SERVER_IP;
-	IPaddress ServerAddress;
-	s32 HostResolvedResult = SDLNet_ResolveHost(&ServerAddress, ServerName, ServerPort);
-	Assert(HostResolvedResult != -1);
-
-	TCPsocket ClientSocket = SDLNet_TCP_Open(&ServerAddress);
-	Assert(ClientSocket);
-
-	s32 AddSocketResult = SDLNet_TCP_AddSocket(SocketSet, ClientSocket);
-	Assert(AddSocketResult != -1);
-
-	s32 ActiveSocketCount = SDLNet_CheckSockets(SocketSet, 5000);
-	Assert(ActiveSocketCount != -1);
-
-	s32 ClientSocketActivity = SDLNet_SocketReady(ClientSocket);
-	Assert(ClientSocketActivity != -1);
+	u64 NetworkArenaSize = Kilobytes(128);
+	memory_arena NetworkArena = {};
+	InitialiseArena(&NetworkArena, NetworkArenaSize, Allocate_(NetworkArenaSize));
+	client_network* Network = PushStruct(&NetworkArena, client_network);
+	*Network = {};
+	Network->HostName = SYNCHESS_SERVER_IP;
+	Network->Port = SYNCHESS_PORT;
+	Network->SpectatedGameID = SpectatedGameID;
+	StartClientNetwork(Network, &NetworkArena);
 	// }
 
 	while(Running)
@@ -741,70 +1288,105 @@ s32 main(s32 ArgumentCount, char** Arguments)
 		// NOTE(hugo) : Input gathering
 		// {
 		//
+		BeginInputFrame(&Input);
+		Input.MustRedraw = IsFixedRate;
 		SDL_Event Event;
-		while(SDL_PollEvent(&Event))
+		bool HasEvent = false;
+		if(IsFixedRate)
+		{
+			HasEvent = SDL_PollEvent(&Event);
+		}
+		else
+		{
+			// NOTE(hugo) : Nothing changes on its own, the network thread
+			// wakes us up with an event when the server said something.
+			HasEvent = SDL_WaitEvent(&Event);
+		}
+		// NOTE(hugo) : The time spent asleep is not part of the frame.
+		BeginProfileFrame(&GlobalProfiler);
+		u64 StartCounter = SDL_GetPerformanceCounter();
+		while(HasEvent)
 		{
-			switch(Event.type)
+			if(Event.type == SDL_QUIT)
 			{
-				case SDL_QUIT:
-					{
-						Running = false;
-					} break;
-				default:
-					{
-					} break;
+				Running = false;
+			}
+			else if(((Event.type == SDL_WINDOWEVENT) &&
+						((Event.window.event == SDL_WINDOWEVENT_EXPOSED) ||
+						 (Event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED))) ||
+					(Event.type == SDL_RENDER_TARGETS_RESET))
+			{
+				Input.MustRedraw = true;
+			}
+			else
+			{
+				// NOTE(hugo) : Input, or the network thread telling us there
+				// are messages, which are read in the update.
+				SDLProcessInputEvent(&Input, &Event);
 			}
+
+			HasEvent = SDL_PollEvent(&Event);
+		}
+
+		if(Pressed(&Input, SCANCODE_F3))
+		{
+			GlobalProfiler.IsOverlayVisible = !GlobalProfiler.IsOverlayVisible;
+			// NOTE(hugo) : The overlay is not in the target, one frame
+			// without it is enough to have it gone.
+			Input.MustRedraw = true;
 		}
-		SDLGetMouseInput(&NewInput->Mouse);
-		SDLGetKeyboardInput(&NewInput->Keyboard);
+		if(Pressed(&Input, SCANCODE_F4))
+		{
+			bool IsExported = ExportProfileTrace(&GlobalProfiler, TracePath);
+			LogEvent(LogRing, LogEvent_TraceExported, IsExported,
+					(u32)(GlobalProfiler.FrameCount - GetFirstProfileFrameIndex(&GlobalProfiler)),
+					GlobalProfiler.SlowestFrameCount);
+		}
+		RecordProfileSection(&GlobalProfiler, ProfileSection_Input, StartCounter);
 		//
 		// }
 		//
 
-		s32 CheckSocketResult = SDLNet_CheckSockets(SocketSet, 0);
-		Assert(CheckSocketResult != -1);
-
-		GameUpdateAndRender(&GameMemory, NewInput, Renderer, ClientSocket);
+		GameUpdateAndRender(&GameMemory, &Input, Renderer, Network, LogRing);
 
 		// NOTE(hugo) : Framerate computation
-		u32 WorkMSElapsedForFrame = SDL_GetTicks() - LastCounter;
-
-		// NOTE(hugo) : Setting the window title
-		char WindowTitle[128];
-		sprintf(WindowTitle, "synchess @ rivten - (%i, %i) - %i %i %i - %ims", (s32)NewInput->Mouse.P.x, (s32)NewInput->Mouse.P.y, (s32)NewInput->Mouse.Buttons[MouseButton_Left].IsDown, (s32)NewInput->Mouse.Buttons[MouseButton_Middle].IsDown, (s32)NewInput->Mouse.Buttons[MouseButton_Right].IsDown, WorkMSElapsedForFrame);
-		SDL_SetWindowTitle(Window, WindowTitle);
+		EndProfileFrame(&GlobalProfiler);
+		profile_frame* LastFrame = GlobalProfiler.Frames + ((GlobalProfiler.FrameCount - 1) % PROFILER_FRAME_COUNT);
+		u32 WorkMSElapsedForFrame = (u32)GetProfileMS(&GlobalProfiler, GetProfileFrameElapsed(LastFrame));
 
-		if(WorkMSElapsedForFrame < TargetMSPerFrame)
+		if(IsFixedRate)
 		{
-			u32 SleepMS = TargetMSPerFrame - WorkMSElapsedForFrame;
-			if(SleepMS > 0)
+			if(WorkMSElapsedForFrame < TargetMSPerFrame)
 			{
-				SDL_Delay(SleepMS);
+				u32 SleepMS = TargetMSPerFrame - WorkMSElapsedForFrame;
+				if(SleepMS > 0)
+				{
+					SDL_Delay(SleepMS);
+				}
+			}
+			else
+			{
+				// TODO(hugo) : Missed framerate
 			}
 		}
-		else
-		{
-			// TODO(hugo) : Missed framerate
-		}
+	}
 
-		// NOTE(hugo) : This must be at the very end
-		LastCounter = SDL_GetTicks();
+	StopClientNetwork(Network);
 
-		// NOTE(hugo) : Switch inputs
-		game_input* TempInput = NewInput;
-		NewInput = OldInput;
-		OldInput = TempInput;
+	game_state* GameState = (game_state*)GameMemory.Storage;
+	if(GameState->IsInitialised)
+	{
+		// NOTE(hugo) : Before the log stops, so that the drain writes it.
+		texture_cache* TextureCache = &GameState->Renderer.TextureCache;
+		LogEvent(LogRing, LogEvent_TextureCacheStats, (u32)TextureCache->Hits, (u32)TextureCache->Misses,
+				(u32)TextureCache->Evictions, (u32)TextureCache->UsedBytes, (u32)TextureCache->BudgetInBytes);
+	}
+	StopEventLog(&EventLog);
 
-		// TODO(hugo) : I think this is ok for perf but can we be sure ?
-		// TODO(hugo): Is a full copy of the 512 scancodes even a good idea ?
-		for(u32 ButtonIndex = 0; ButtonIndex < MouseButton_Count; ++ButtonIndex)
-		{
-			NewInput->Mouse.Buttons[ButtonIndex].WasDown = OldInput->Mouse.Buttons[ButtonIndex].IsDown;
-		}
-		for(u32 KeyButtonIndex = 0; KeyButtonIndex < ArrayCount(Inputs[0].Keyboard.Buttons); ++KeyButtonIndex)
-		{
-			NewInput->Keyboard.Buttons[KeyButtonIndex].WasDown = OldInput->Keyboard.Buttons[KeyButtonIndex].IsDown;
-		}
+	if(GameState->IsInitialised)
+	{
+		ReleaseRenderer(&GameState->Renderer);
+		CloseAssetPack(&GameState->AssetPack);
 	}
 
 	SDL_DestroyRenderer(Renderer);
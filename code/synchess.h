@@ -80,6 +80,27 @@ struct move_params
 	v2i DestP;
 };
 
+enum game_result
+{
+	GameResult_None,
+	GameResult_WhiteWins,
+	GameResult_BlackWins,
+	GameResult_Draw,
+
+	GameResult_Count,
+};
+
+// NOTE(hugo) : Each player starts with BaseMS on the clock and gets
+// IncrementMS back after each move (Fischer). The clock only starts to
+// run DelayMS after the beginning of the turn (simple delay). A zero
+// BaseMS is an untimed game.
+struct time_control
+{
+	u32 BaseMS;
+	u32 IncrementMS;
+	u32 DelayMS;
+};
+
 #define NO_PREVIOUS_DOUBLE_STEP 8
 struct chess_game_context
 {
@@ -104,6 +125,17 @@ struct chess_game_context
 	u32 LastDoubleStepCol;
 
 	piece_color PlayerToPlay;
+
+	game_result Result;
+};
+
+// NOTE(hugo) : Every legal move of the player to play in a position, as
+// one mask of destination squares (bit BOARD_COORD) per starting square.
+// The type of a move follows from where it goes, see GetMoveTypeToDest.
+struct legal_move_table
+{
+	u64 DestMasks[64];
+	bool IsValid;
 };
 
 struct tile_list
@@ -0,0 +1,165 @@
+#ifdef _WIN32
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+// NOTE(hugo) : Offline baker of the asset pack (see synchess_assetpack.h).
+// Decodes every piece image of the data folder, premultiplies it and
+// box-filters it down to each of the AssetPackSizes, then writes it all
+// in one file for the client to map.
+//
+// Usage : assetpack [-data folder] [output]
+
+#include <rivten.h>
+#include <rivten_math.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "synchess_assetpack.h"
+
+#define ASSET_PACK_MAX_ENTRY_COUNT (ArrayCount(PieceAssetNames) * ArrayCount(AssetPackSizes))
+
+// NOTE(hugo) : Each destination pixel is the mean of a Factor x Factor
+// block of the source. The pixels are premultiplied, so the mean is right
+// even across transparent edges.
+internal void
+BoxDownsample(u8* Dest, u8* Source, u32 SourceWidth, u32 SourceHeight, u32 Factor)
+{
+	u32 DestWidth = SourceWidth / Factor;
+	u32 DestHeight = SourceHeight / Factor;
+	for(u32 Y = 0; Y < DestHeight; ++Y)
+	{
+		for(u32 X = 0; X < DestWidth; ++X)
+		{
+			u32 Sums[4] = {};
+			for(u32 BlockY = 0; BlockY < Factor; ++BlockY)
+			{
+				u8* SourceRow = Source + 4 * ((Y * Factor + BlockY) * SourceWidth + X * Factor);
+				for(u32 BlockX = 0; BlockX < Factor; ++BlockX)
+				{
+					for(u32 Channel = 0; Channel < 4; ++Channel)
+					{
+						Sums[Channel] += SourceRow[4 * BlockX + Channel];
+					}
+				}
+			}
+
+			u8* DestPixel = Dest + 4 * (Y * DestWidth + X);
+			u32 SampleCount = Factor * Factor;
+			for(u32 Channel = 0; Channel < 4; ++Channel)
+			{
+				DestPixel[Channel] = (u8)((Sums[Channel] + SampleCount / 2) / SampleCount);
+			}
+		}
+	}
+}
+
+internal u64
+AlignAssetPackOffset(u64 Offset)
+{
+	u64 Result = (Offset + ASSET_PACK_ALIGNMENT - 1) & ~(u64)(ASSET_PACK_ALIGNMENT - 1);
+	return(Result);
+}
+
+s32 main(s32 ArgumentCount, char** Arguments)
+{
+	char* DataPath = "../data";
+	char* OutputPath = SYNCHESS_ASSET_PACK_PATH;
+	for(s32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+	{
+		char* Argument = Arguments[ArgumentIndex];
+		if((strcmp(Argument, "-data") == 0) && (ArgumentIndex + 1 < ArgumentCount))
+		{
+			DataPath = Arguments[++ArgumentIndex];
+		}
+		else
+		{
+			OutputPath = Argument;
+		}
+	}
+
+	asset_pack_entry Entries[ASSET_PACK_MAX_ENTRY_COUNT] = {};
+	u8* Pixels[ASSET_PACK_MAX_ENTRY_COUNT] = {};
+	u32 EntryCount = 0;
+	u64 Offset = AlignAssetPackOffset(sizeof(asset_pack_header) + sizeof(Entries));
+	for(u32 NameIndex = 0; NameIndex < ArrayCount(PieceAssetNames); ++NameIndex)
+	{
+		char* Name = PieceAssetNames[NameIndex];
+		Assert(strlen(Name) < ASSET_PACK_NAME_SIZE);
+
+		char Filename[1024];
+		snprintf(Filename, sizeof(Filename), "%s/%s.png", DataPath, Name);
+		s32 Width = 0;
+		s32 Height = 0;
+		s32 Depth = 0;
+		u8* Source = stbi_load(Filename, &Width, &Height, &Depth, 4);
+		if(!Source)
+		{
+			fprintf(stderr, "Cannot load %s.\n", Filename);
+			return(1);
+		}
+		PremultiplyAlpha(Source, (u32)(Width * Height));
+
+		for(u32 SizeIndex = 0; SizeIndex < ArrayCount(AssetPackSizes); ++SizeIndex)
+		{
+			u32 Size = AssetPackSizes[SizeIndex];
+			if(((u32)Width % Size != 0) || ((u32)Height != (u32)Width))
+			{
+				fprintf(stderr, "%s is %dx%d, not a square multiple of %u, skipped at that size.\n",
+						Filename, Width, Height, Size);
+				continue;
+			}
+
+			u32 Factor = (u32)Width / Size;
+			u8* Dest = (u8*)Allocate_(4 * Size * Size);
+			Assert(Dest);
+			BoxDownsample(Dest, Source, (u32)Width, (u32)Height, Factor);
+
+			asset_pack_entry* Entry = Entries + EntryCount;
+			strcpy(Entry->Name, Name);
+			Entry->AssetID = GetPackedAssetID(Name, Size);
+			Entry->Width = Size;
+			Entry->Height = Size;
+			Entry->Offset = Offset;
+			Pixels[EntryCount] = Dest;
+			++EntryCount;
+
+			Offset = AlignAssetPackOffset(Offset + 4 * Size * Size);
+		}
+
+		stbi_image_free(Source);
+	}
+
+	FILE* File = fopen(OutputPath, "wb");
+	if(!File)
+	{
+		fprintf(stderr, "Cannot open %s.\n", OutputPath);
+		return(1);
+	}
+
+	asset_pack_header Header = {};
+	Header.Magic = ASSET_PACK_MAGIC;
+	Header.Version = ASSET_PACK_VERSION;
+	Header.EntryCount = EntryCount;
+	bool IsWritten = (fwrite(&Header, sizeof(Header), 1, File) == 1) &&
+		(fwrite(Entries, sizeof(asset_pack_entry), EntryCount, File) == EntryCount);
+	for(u32 EntryIndex = 0; IsWritten && (EntryIndex < EntryCount); ++EntryIndex)
+	{
+		asset_pack_entry* Entry = Entries + EntryIndex;
+		IsWritten = (fseek(File, (long)Entry->Offset, SEEK_SET) == 0) &&
+			(fwrite(Pixels[EntryIndex], 4 * Entry->Width, Entry->Height, File) == Entry->Height);
+	}
+	IsWritten = (fclose(File) == 0) && IsWritten;
+	if(!IsWritten)
+	{
+		fprintf(stderr, "Cannot write %s.\n", OutputPath);
+		return(1);
+	}
+
+	printf("%u images written to %s, %llu bytes.\n", EntryCount, OutputPath,
+			(unsigned long long)Offset);
+
+	return(0);
+}
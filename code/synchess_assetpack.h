@@ -0,0 +1,232 @@
+#pragma once
+
+// NOTE(hugo) : The images of the game, baked offline by the assetpack
+// tool into a single file that the client maps as is. Every image is
+// stored at a few sizes, already decoded and with its alpha
+// premultiplied, so there is nothing left to do at startup but to hand
+// the mapped pages to the GPU.
+//
+// Layout : an asset_pack_header, EntryCount asset_pack_entry, then the
+// pixels of every entry (RGBA8, 4 * Width bytes per row) each starting
+// on an ASSET_PACK_ALIGNMENT boundary.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SYNCHESS_ASSET_PACK_PATH "synchess.pack"
+#define ASSET_PACK_MAGIC 0x4B505953 // NOTE(hugo) : 'SYPK'
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 64
+#define ASSET_PACK_NAME_SIZE 32
+
+// NOTE(hugo) : The sizes the images are baked at, the source image must
+// be a multiple of each of them.
+global_variable u32 AssetPackSizes[] = {64, 32, 16};
+
+// NOTE(hugo) : Indexed by Color * PieceType_Count + Type.
+global_variable char* PieceAssetNames[] =
+{
+	"WhitePawn",
+	"WhiteKnight",
+	"WhiteBishop",
+	"WhiteRook",
+	"WhiteQueen",
+	"WhiteKing",
+
+	"BlackPawn",
+	"BlackKnight",
+	"BlackBishop",
+	"BlackRook",
+	"BlackQueen",
+	"BlackKing",
+};
+
+struct asset_pack_header
+{
+	u32 Magic;
+	u32 Version;
+	u32 EntryCount;
+	u32 Reserved;
+};
+
+struct asset_pack_entry
+{
+	char Name[ASSET_PACK_NAME_SIZE];
+	u64 AssetID;
+	u32 Width;
+	u32 Height;
+	// NOTE(hugo) : From the start of the file.
+	u64 Offset;
+};
+
+struct asset_pack
+{
+	void* Base;
+	u64 Size;
+	asset_pack_header* Header;
+	asset_pack_entry* Entries;
+#ifdef _WIN32
+	HANDLE File;
+	HANDLE Mapping;
+#endif
+};
+
+// NOTE(hugo) : FNV-1a of the name, so that an image keeps its id
+// whatever memory it is loaded at.
+internal u64
+GetAssetID(char* Name)
+{
+	u64 Result = 14695981039346656037ull;
+	for(char* Char = Name; *Char; ++Char)
+	{
+		Result ^= (u8)*Char;
+		Result *= 1099511628211ull;
+	}
+	if(Result == 0)
+	{
+		Result = 1;
+	}
+
+	return(Result);
+}
+
+internal u64
+GetPackedAssetID(char* Name, u32 Size)
+{
+	char SizedName[ASSET_PACK_NAME_SIZE + 16];
+	snprintf(SizedName, sizeof(SizedName), "%s@%u", Name, Size);
+	u64 Result = GetAssetID(SizedName);
+	return(Result);
+}
+
+internal void
+PremultiplyAlpha(u8* Pixels, u32 PixelCount)
+{
+	for(u32 PixelIndex = 0; PixelIndex < PixelCount; ++PixelIndex)
+	{
+		u8* Pixel = Pixels + 4 * PixelIndex;
+		u32 Alpha = Pixel[3];
+		Pixel[0] = (u8)((Pixel[0] * Alpha + 127) / 255);
+		Pixel[1] = (u8)((Pixel[1] * Alpha + 127) / 255);
+		Pixel[2] = (u8)((Pixel[2] * Alpha + 127) / 255);
+	}
+}
+
+internal void
+CloseAssetPack(asset_pack* Pack)
+{
+	if(Pack->Base)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(Pack->Base);
+		CloseHandle(Pack->Mapping);
+		CloseHandle(Pack->File);
+#else
+		munmap(Pack->Base, Pack->Size);
+#endif
+	}
+	*Pack = {};
+}
+
+// NOTE(hugo) : Maps the whole pack read-only and checks that its index
+// stays inside of the file. Returns false if there is no usable pack.
+internal bool
+OpenAssetPack(asset_pack* Pack, char* Path)
+{
+	*Pack = {};
+#ifdef _WIN32
+	Pack->File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if(Pack->File == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+	LARGE_INTEGER FileSize = {};
+	GetFileSizeEx(Pack->File, &FileSize);
+	Pack->Mapping = CreateFileMappingA(Pack->File, 0, PAGE_READONLY, 0, 0, 0);
+	if(Pack->Mapping)
+	{
+		Pack->Base = MapViewOfFile(Pack->Mapping, FILE_MAP_READ, 0, 0, 0);
+		Pack->Size = (u64)FileSize.QuadPart;
+	}
+	if(!Pack->Base)
+	{
+		if(Pack->Mapping)
+		{
+			CloseHandle(Pack->Mapping);
+		}
+		CloseHandle(Pack->File);
+		*Pack = {};
+		return(false);
+	}
+#else
+	s32 File = open(Path, O_RDONLY | O_CLOEXEC);
+	if(File == -1)
+	{
+		return(false);
+	}
+	struct stat FileStat = {};
+	if((fstat(File, &FileStat) == 0) && (FileStat.st_size > 0))
+	{
+		void* Mapping = mmap(0, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+		if(Mapping != MAP_FAILED)
+		{
+			Pack->Base = Mapping;
+			Pack->Size = (u64)FileStat.st_size;
+		}
+	}
+	// NOTE(hugo) : The mapping keeps the file alive.
+	close(File);
+	if(!Pack->Base)
+	{
+		return(false);
+	}
+#endif
+
+	bool IsValid = (Pack->Size >= sizeof(asset_pack_header));
+	if(IsValid)
+	{
+		Pack->Header = (asset_pack_header*)Pack->Base;
+		Pack->Entries = (asset_pack_entry*)(Pack->Header + 1);
+		IsValid = (Pack->Header->Magic == ASSET_PACK_MAGIC) &&
+			(Pack->Header->Version == ASSET_PACK_VERSION) &&
+			(sizeof(asset_pack_header) + (u64)Pack->Header->EntryCount * sizeof(asset_pack_entry) <= Pack->Size);
+	}
+	for(u32 EntryIndex = 0; IsValid && (EntryIndex < Pack->Header->EntryCount); ++EntryIndex)
+	{
+		asset_pack_entry* Entry = Pack->Entries + EntryIndex;
+		u64 PixelSize = 4 * (u64)Entry->Width * (u64)Entry->Height;
+		IsValid = (Entry->Name[ASSET_PACK_NAME_SIZE - 1] == 0) &&
+			(Entry->Offset % ASSET_PACK_ALIGNMENT == 0) &&
+			(Entry->Offset <= Pack->Size) && (PixelSize <= Pack->Size - Entry->Offset);
+	}
+
+	if(!IsValid)
+	{
+		CloseAssetPack(Pack);
+	}
+
+	return(IsValid);
+}
+
+// NOTE(hugo) : Returns 0 if the pack does not have the image at that size.
+internal asset_pack_entry*
+FindPackedAsset(asset_pack* Pack, char* Name, u32 Size)
+{
+	asset_pack_entry* Result = 0;
+	for(u32 EntryIndex = 0; !Result && (EntryIndex < Pack->Header->EntryCount); ++EntryIndex)
+	{
+		asset_pack_entry* Entry = Pack->Entries + EntryIndex;
+		if((Entry->Width == Size) && (strcmp(Entry->Name, Name) == 0))
+		{
+			Result = Entry;
+		}
+	}
+
+	return(Result);
+}
@@ -0,0 +1,771 @@
+#ifdef _WIN32
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+// NOTE(hugo) : Headless load generator. Opens a bunch of connexions to
+// the server, every one of them being a bot that joins a game and plays
+// legal moves, and reports the round-trip latency of the moves
+// (MoveDone sent -> context update received) and the throughput.
+// No window, no renderer : only SDL for its timer.
+
+#include <rivten.h>
+#include <rivten_math.h>
+
+#include "synchess.h"
+#include "synchess_network.h"
+#include "chess.cpp"
+#include "synchess_socket.h"
+#include "synchess_local.h"
+#include "synchess_histogram.h"
+
+#define MAX_BOT_COUNT 4096
+#define BOT_POLL_TIMEOUT_MS 10
+#define BOT_REPORT_PERIOD_MS 1000
+#define INBOUND_BUFFER_SIZE (4 * sizeof(network_synchess_message))
+
+enum bot_strategy
+{
+	BotStrategy_Random,
+	// NOTE(hugo) : Takes the most valuable piece it can, random otherwise.
+	BotStrategy_Greedy,
+
+	BotStrategy_Count,
+};
+
+enum bot_mode
+{
+	BotMode_Lobby,
+	BotMode_WaitForGame,
+	BotMode_Playing,
+	BotMode_WaitForAnswer,
+};
+
+struct bot
+{
+	bool IsConnected;
+	platform_socket Socket;
+	// NOTE(hugo) : All zero when the bot talks to the server over TCP.
+	local_channel Local;
+	bot_mode Mode;
+
+	u32 Rating;
+	piece_color Color;
+	chess_game_context ChessContext;
+	chess_piece TilePieces[64];
+
+	u32 GameID;
+	u32 ReconnectToken;
+	u32 MoveSequence;
+	// NOTE(hugo) : MoveSequence when we sent our premove, if we have one.
+	bool HasPremove;
+	u32 PremoveSequence;
+
+	// NOTE(hugo) : Performance counter values.
+	u64 NextMoveTime;
+	u64 MoveSentTime;
+
+	u32 InboundSize;
+	u8 InboundBuffer[INBOUND_BUFFER_SIZE];
+};
+
+struct bot_config
+{
+	char* HostName;
+	u16 Port;
+	u32 BotCount;
+	// NOTE(hugo) : Moves per second per bot, 0 to play as fast as possible.
+	float MoveRate;
+	u32 DurationSeconds;
+	bot_strategy Strategy;
+	// NOTE(hugo) : All zero for the default of the server.
+	time_control TimeControl;
+	// NOTE(hugo) : The bots are rated uniformly in [RatingMin, RatingMax].
+	u32 RatingMin;
+	u32 RatingMax;
+	// NOTE(hugo) : Chance, in percent, that a bot drops its connexion right
+	// after sending a move, and resumes its game on a new one.
+	u32 DropPercent;
+	// NOTE(hugo) : Chance, in percent, that a bot sends a premove at the
+	// start of the opponent's turn.
+	u32 PremovePercent;
+	// NOTE(hugo) : Connect through the shared memory rings of the server
+	// listening on that path instead of TCP.
+	char* LocalPath;
+	// NOTE(hugo) : Busy-poll the rings instead of sleeping on the doorbell.
+	bool IsSpinning;
+	bool IsNagleEnabled;
+};
+
+struct bot_stats
+{
+	// NOTE(hugo) : Round trips of the moves, in microseconds.
+	latency_histogram Latency;
+	u64 MoveCount;
+	u64 GameCount;
+	u64 FlagCount;
+	u64 RejectedCount;
+	u64 ResumeCount;
+	u64 PremoveCount;
+	u64 PremovePlayedCount;
+};
+
+struct bot_state
+{
+	bot_config Config;
+	memory_arena ScratchArena;
+	u64 RandomState;
+
+	bot Bots[MAX_BOT_COUNT];
+	socket_poll Polls[MAX_BOT_COUNT];
+	bot* PolledBots[MAX_BOT_COUNT];
+
+	bot_stats Interval;
+	bot_stats Total;
+};
+
+internal void
+MergeStats(bot_stats* Dest, bot_stats* Source)
+{
+	MergeLatencyHistogram(&Dest->Latency, &Source->Latency);
+	Dest->MoveCount += Source->MoveCount;
+	Dest->GameCount += Source->GameCount;
+	Dest->FlagCount += Source->FlagCount;
+	Dest->RejectedCount += Source->RejectedCount;
+	Dest->ResumeCount += Source->ResumeCount;
+	Dest->PremoveCount += Source->PremoveCount;
+	Dest->PremovePlayedCount += Source->PremovePlayedCount;
+}
+
+internal void
+PrintStats(char* Label, bot_stats* Stats, float Seconds, u32 ConnectedCount)
+{
+	latency_histogram* Latency = &Stats->Latency;
+	printf("%s %u bots | %.0f moves/s | %llu bot games | RTT us p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu | %llu flags %llu rejected %llu resumes %llu/%llu premoves played\n",
+			Label, ConnectedCount, (Seconds > 0.0f) ? (float)Stats->MoveCount / Seconds : 0.0f,
+			(unsigned long long)Stats->GameCount,
+			(unsigned long long)GetLatencyPercentile(Latency, 50.0f),
+			(unsigned long long)GetLatencyPercentile(Latency, 90.0f),
+			(unsigned long long)GetLatencyPercentile(Latency, 99.0f),
+			(unsigned long long)GetLatencyPercentile(Latency, 99.9f),
+			(unsigned long long)Latency->MaxValue,
+			(unsigned long long)Stats->FlagCount,
+			(unsigned long long)Stats->RejectedCount,
+			(unsigned long long)Stats->ResumeCount,
+			(unsigned long long)Stats->PremovePlayedCount,
+			(unsigned long long)Stats->PremoveCount);
+}
+
+internal u32
+RandomNext(bot_state* BotState)
+{
+	// NOTE(hugo) : xorshift64*
+	u64 X = BotState->RandomState;
+	X ^= X >> 12;
+	X ^= X << 25;
+	X ^= X >> 27;
+	BotState->RandomState = X;
+	u32 Result = (u32)((X * 0x2545F4914F6CDD1DULL) >> 32);
+	return(Result);
+}
+
+internal bool
+BotSendMessage(bot* Bot, network_synchess_message* Message)
+{
+	// NOTE(hugo) : A bot only ever has one message in flight and the
+	// socket buffer is empty by then, so a short send means trouble.
+	send_slice Slice = {Message, sizeof(network_synchess_message)};
+	s32 SentBytes = SendSlicesToPeer(Bot->Socket, &Bot->Local, &Slice, 1);
+	bool Result = (SentBytes == (s32)sizeof(network_synchess_message));
+	return(Result);
+}
+
+internal void
+BotJoinGame(bot_state* BotState, bot* Bot)
+{
+	network_synchess_message Message = {};
+	Message.Type = NetworkMessageType_JoinGame;
+	Message.JoinGame.Rating = Bot->Rating;
+	Message.JoinGame.TimeControl = BotState->Config.TimeControl;
+	BotSendMessage(Bot, &Message);
+	Bot->Mode = BotMode_WaitForGame;
+	Bot->Color = PieceColor_Count;
+	Bot->ReconnectToken = 0;
+}
+
+internal bool
+BotConnect(bot_config* Config, bot* Bot)
+{
+	if(Config->LocalPath)
+	{
+		Bot->Socket = OpenLocalConnection(Config->LocalPath, &Bot->Local);
+	}
+	else
+	{
+		Bot->Socket = OpenConnection(Config->HostName, Config->Port);
+		if(Bot->Socket != INVALID_PLATFORM_SOCKET)
+		{
+			SetSocketNoDelay(Bot->Socket, !Config->IsNagleEnabled);
+		}
+	}
+
+	bool Result = (Bot->Socket != INVALID_PLATFORM_SOCKET);
+	if(Result)
+	{
+		SetSocketNonBlocking(Bot->Socket);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Plays a player on a flaky network : drops the connexion
+// and asks for its seat back on a new one. Returns false if the server
+// cannot be reached anymore.
+internal bool
+BotDropAndResume(bot_state* BotState, bot* Bot)
+{
+	ClosePeer(Bot->Socket, &Bot->Local);
+	Bot->InboundSize = 0;
+	bool Result = BotConnect(&BotState->Config, Bot);
+	if(Result)
+	{
+		network_synchess_message Message = {};
+		Message.Type = NetworkMessageType_ResumeGame;
+		Message.ResumeGame.GameID = Bot->GameID;
+		Message.ResumeGame.ReconnectToken = Bot->ReconnectToken;
+		Message.ResumeGame.LastMoveSequence = Bot->MoveSequence;
+		BotSendMessage(Bot, &Message);
+	}
+
+	return(Result);
+}
+
+internal float
+GetPieceValue(chess_piece* Piece)
+{
+	float Result = 0.0f;
+	if(Piece)
+	{
+		switch(Piece->Type)
+		{
+			case PieceType_Pawn: {Result = 1.0f;} break;
+			case PieceType_Knight:
+			case PieceType_Bishop: {Result = 3.0f;} break;
+			case PieceType_Rook: {Result = 5.0f;} break;
+			case PieceType_Queen: {Result = 9.0f;} break;
+			case PieceType_King: {Result = 0.0f;} break;
+			InvalidDefaultCase;
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Returns false if Color has no legal move, that is the
+// game is over (checkmate or stalemate).
+internal bool
+ChooseMove(bot_state* BotState, bot* Bot, piece_color Color, move_params* ChosenMove)
+{
+	chess_game_context* ChessContext = &Bot->ChessContext;
+	memory_arena* Arena = &BotState->ScratchArena;
+	temporary_memory MoveTempMemory = BeginTemporaryMemory(Arena);
+
+	u32 MoveCount = 0;
+	float BestValue = -1.0f;
+	for(u32 SquareIndex = 0; SquareIndex < ArrayCount(ChessContext->Chessboard); ++SquareIndex)
+	{
+		chess_piece* Piece = ChessContext->Chessboard[SquareIndex];
+		if(Piece && (Piece->Color == Color))
+		{
+			v2i PieceP = V2i(SquareIndex % 8, SquareIndex / 8);
+			tile_list* PossibleMoveList = GetPossibleMoveList(ChessContext, Piece, PieceP, Arena);
+			if(PossibleMoveList)
+			{
+				DeleteInvalidMoveDueToCheck(ChessContext, Piece, PieceP, &PossibleMoveList, Color, Arena);
+			}
+
+			for(tile_list* Move = PossibleMoveList; Move; Move = Move->Next)
+			{
+				float Value = 0.0f;
+				if(BotState->Config.Strategy == BotStrategy_Greedy)
+				{
+					Value = GetPieceValue(ChessContext->Chessboard[BOARD_COORD(Move->P)]);
+				}
+
+				// NOTE(hugo) : Reservoir sampling among the best moves seen so far.
+				if(Value > BestValue)
+				{
+					BestValue = Value;
+					MoveCount = 0;
+				}
+				if(Value == BestValue)
+				{
+					++MoveCount;
+					if((RandomNext(BotState) % MoveCount) == 0)
+					{
+						ChosenMove->Type = Move->MoveType;
+						ChosenMove->InitialP = PieceP;
+						ChosenMove->DestP = Move->P;
+					}
+				}
+			}
+		}
+	}
+
+	EndTemporaryMemory(MoveTempMemory);
+
+	return(MoveCount > 0);
+}
+
+internal u64
+GetThinkTime(bot_state* BotState, u64 CounterFrequency)
+{
+	u64 Result = 0;
+	if(BotState->Config.MoveRate > 0.0f)
+	{
+		// NOTE(hugo) : Jitter the think time so that the bots do not
+		// all fire at the same tick.
+		float Seconds = (0.5f + (float)(RandomNext(BotState) % 1000) / 1000.0f) / BotState->Config.MoveRate;
+		Result = (u64)(Seconds * (float)CounterFrequency);
+	}
+
+	return(Result);
+}
+
+internal void
+HandleServerMessage(bot_state* BotState, bot* Bot, network_synchess_message* Message, u64 Now, u64 CounterFrequency)
+{
+	switch(Message->Type)
+	{
+		case NetworkMessageType_ConnectionEstablished:
+			{
+				Bot->Color = Message->ConnectionEstablished.GivenColor;
+				Bot->ReconnectToken = Message->ConnectionEstablished.ReconnectToken;
+			} break;
+		case NetworkMessageType_NoRoomForClient:
+			{
+				// NOTE(hugo) : The server is full. Try again later.
+				++BotState->Interval.RejectedCount;
+				Bot->Mode = BotMode_Lobby;
+				Bot->NextMoveTime = Now + CounterFrequency;
+			} break;
+		case NetworkMessageType_GameStarted:
+			{
+				// NOTE(hugo) : The pieces are moved into the bot so that the
+				// scratch arena does not grow with each game.
+				temporary_memory InitTempMemory = BeginTemporaryMemory(&BotState->ScratchArena);
+				InitialiseChessContext(&Bot->ChessContext, &BotState->ScratchArena);
+				MapConfigToChessboard(Bot->ChessContext.Chessboard, Bot->TilePieces,
+						WriteConfig(Bot->ChessContext.Chessboard));
+				EndTemporaryMemory(InitTempMemory);
+
+				Bot->GameID = Message->GameStarted.GameID;
+				Bot->MoveSequence = 0;
+				Bot->HasPremove = false;
+				Bot->Mode = BotMode_Playing;
+				Bot->NextMoveTime = Now + GetThinkTime(BotState, CounterFrequency);
+			} break;
+		case NetworkMessageType_ChessContextUpdate:
+			{
+				if((Bot->Mode != BotMode_Playing) && (Bot->Mode != BotMode_WaitForAnswer))
+				{
+					// NOTE(hugo) : Late answer from a game we gave up on.
+					break;
+				}
+
+				chess_game_context* ChessContext = &Bot->ChessContext;
+				MapConfigToChessboard(ChessContext->Chessboard, Bot->TilePieces,
+						Message->ContextUpdate.NewBoardConfig);
+				ChessContext->CastlingPieceTracker[0] = Message->ContextUpdate.CastlingPieceTracker[0];
+				ChessContext->CastlingPieceTracker[1] = Message->ContextUpdate.CastlingPieceTracker[1];
+				ChessContext->PlayerCheck             = Message->ContextUpdate.PlayerCheck;
+				ChessContext->LastDoubleStepCol       = Message->ContextUpdate.LastDoubleStepCol;
+				ChessContext->PlayerToPlay            = Message->ContextUpdate.PlayerToPlay;
+				if(Bot->HasPremove)
+				{
+					// NOTE(hugo) : The opponent's move and our premove in one update.
+					if(Message->ContextUpdate.MoveSequence == Bot->PremoveSequence + 2)
+					{
+						++BotState->Interval.PremovePlayedCount;
+					}
+					Bot->HasPremove = false;
+				}
+				Bot->MoveSequence = Message->ContextUpdate.MoveSequence;
+
+				if(Bot->Mode == BotMode_WaitForAnswer)
+				{
+					// NOTE(hugo) : This is the answer to our move.
+					u64 LatencyMicroSeconds = ((Now - Bot->MoveSentTime) * 1000000) / CounterFrequency;
+					RecordLatency(&BotState->Interval.Latency, LatencyMicroSeconds);
+					++BotState->Interval.MoveCount;
+				}
+				Bot->Mode = BotMode_Playing;
+				Bot->NextMoveTime = Now + GetThinkTime(BotState, CounterFrequency);
+
+				// NOTE(hugo) : If that was the last move, the GameEnded that
+				// follows sends us looking for a new game.
+				if((ChessContext->PlayerToPlay != Bot->Color) &&
+						((RandomNext(BotState) % 100) < BotState->Config.PremovePercent))
+				{
+					// NOTE(hugo) : Any of our moves in the current position, the
+					// server drops it if the opponent's move makes it illegal.
+					network_synchess_message Premove = {};
+					Premove.Type = NetworkMessageType_Premove;
+					if(ChooseMove(BotState, Bot, Bot->Color, &Premove.Premove))
+					{
+						Bot->HasPremove = true;
+						Bot->PremoveSequence = Bot->MoveSequence;
+						++BotState->Interval.PremoveCount;
+						BotSendMessage(Bot, &Premove);
+					}
+				}
+			} break;
+		case NetworkMessageType_FlagFall:
+			{
+				++BotState->Interval.GameCount;
+				++BotState->Interval.FlagCount;
+				BotJoinGame(BotState, Bot);
+			} break;
+		case NetworkMessageType_GameEnded:
+			{
+				++BotState->Interval.GameCount;
+				BotJoinGame(BotState, Bot);
+			} break;
+		case NetworkMessageType_GameResumed:
+			{
+				++BotState->Interval.ResumeCount;
+				// NOTE(hugo) : The server forgot our premove when we left.
+				Bot->HasPremove = false;
+				network_message_game_resumed* Resumed = &Message->GameResumed;
+				// NOTE(hugo) : If our move got lost with the connexion, it is our turn again.
+				Bot->Mode = BotMode_Playing;
+				Bot->NextMoveTime = Now + GetThinkTime(BotState, CounterFrequency);
+				if(!Resumed->IsSnapshotFollowing)
+				{
+					// NOTE(hugo) : The moves are replayed in the scratch arena,
+					// then the pieces are moved back into the bot.
+					chess_game_context* ChessContext = &Bot->ChessContext;
+					temporary_memory ReplayTempMemory = BeginTemporaryMemory(&BotState->ScratchArena);
+					for(u32 MoveIndex = 0; MoveIndex < Resumed->TailMoveCount; ++MoveIndex)
+					{
+						ReplayMove(ChessContext, Resumed->TailMoves[MoveIndex], &BotState->ScratchArena);
+					}
+					ChessContext->PlayerCheck = SearchForKingCheck(ChessContext, &BotState->ScratchArena);
+					MapConfigToChessboard(ChessContext->Chessboard, Bot->TilePieces,
+							WriteConfig(ChessContext->Chessboard));
+					EndTemporaryMemory(ReplayTempMemory);
+
+					Bot->MoveSequence = Resumed->MoveSequence;
+				}
+			} break;
+		case NetworkMessageType_Quit:
+		case NetworkMessageType_MoveDone:
+		case NetworkMessageType_JoinGame:
+		case NetworkMessageType_SpectateGame:
+		case NetworkMessageType_ResumeGame:
+		case NetworkMessageType_Premove:
+			{
+				// NOTE(hugo) : The server should not
+				// send this message types
+				InvalidCodePath;
+			} break;
+
+		InvalidDefaultCase;
+	}
+}
+
+internal void
+UpdateBot(bot_state* BotState, bot* Bot, u64 Now, u64 CounterFrequency)
+{
+	switch(Bot->Mode)
+	{
+		case BotMode_Lobby:
+			{
+				if(Now >= Bot->NextMoveTime)
+				{
+					BotJoinGame(BotState, Bot);
+				}
+			} break;
+		case BotMode_WaitForGame:
+			{
+			} break;
+		case BotMode_Playing:
+		case BotMode_WaitForAnswer:
+			{
+				bool IsMyTurnToPlay = (Bot->Mode == BotMode_Playing) &&
+					(Bot->ChessContext.PlayerToPlay == Bot->Color);
+				if(IsMyTurnToPlay)
+				{
+					network_synchess_message Message = {};
+					Message.Type = NetworkMessageType_MoveDone;
+					Message.MoveDone.MoveSequence = Bot->MoveSequence;
+					if((Now >= Bot->NextMoveTime) && ChooseMove(BotState, Bot, Bot->Color, &Message.MoveDone.Move))
+					{
+						Bot->MoveSentTime = Now;
+						Bot->Mode = BotMode_WaitForAnswer;
+						BotSendMessage(Bot, &Message);
+
+						if((RandomNext(BotState) % 100) < BotState->Config.DropPercent)
+						{
+							// NOTE(hugo) : The round trip of this move is not measured,
+							// the answer comes with the resume.
+							Bot->Mode = BotMode_WaitForGame;
+							Bot->IsConnected = BotDropAndResume(BotState, Bot);
+						}
+					}
+				}
+			} break;
+		InvalidDefaultCase;
+	}
+}
+
+s32 main(s32 ArgumentCount, char** Arguments)
+{
+	bot_config Config = {};
+	Config.HostName = SYNCHESS_SERVER_IP;
+	Config.Port = SYNCHESS_PORT;
+	Config.BotCount = 100;
+	Config.MoveRate = 1.0f;
+	Config.DurationSeconds = 0;
+	Config.Strategy = BotStrategy_Random;
+	Config.RatingMin = 1000;
+	Config.RatingMax = 2000;
+	for(s32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+	{
+		char* Argument = Arguments[ArgumentIndex];
+		bool HasValue = (ArgumentIndex + 1 < ArgumentCount);
+		if((strcmp(Argument, "-host") == 0) && HasValue)
+		{
+			Config.HostName = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Argument, "-port") == 0) && HasValue)
+		{
+			Config.Port = (u16)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-bots") == 0) && HasValue)
+		{
+			Config.BotCount = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-rate") == 0) && HasValue)
+		{
+			Config.MoveRate = (float)atof(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-duration") == 0) && HasValue)
+		{
+			Config.DurationSeconds = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if(strcmp(Argument, "-greedy") == 0)
+		{
+			Config.Strategy = BotStrategy_Greedy;
+		}
+		else if((strcmp(Argument, "-clock") == 0) && HasValue)
+		{
+			char* Clock = Arguments[++ArgumentIndex];
+			Config.TimeControl.BaseMS = (u32)(atof(Clock) * 60.0 * 1000.0);
+			char* Increment = strchr(Clock, '+');
+			Config.TimeControl.IncrementMS = Increment ? (u32)(atof(Increment + 1) * 1000.0) : 0;
+		}
+		else if((strcmp(Argument, "-drop") == 0) && HasValue)
+		{
+			Config.DropPercent = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-premove") == 0) && HasValue)
+		{
+			Config.PremovePercent = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-local") == 0) && HasValue)
+		{
+			Config.LocalPath = Arguments[++ArgumentIndex];
+		}
+		else if(strcmp(Argument, "-spin") == 0)
+		{
+			Config.IsSpinning = true;
+		}
+		else if(strcmp(Argument, "-nagle") == 0)
+		{
+			Config.IsNagleEnabled = true;
+		}
+		else if((strcmp(Argument, "-ratings") == 0) && HasValue)
+		{
+			// NOTE(hugo) : "1000-2000", or a single rating for all.
+			char* Ratings = Arguments[++ArgumentIndex];
+			Config.RatingMin = (u32)atoi(Ratings);
+			char* Dash = strchr(Ratings, '-');
+			Config.RatingMax = Dash ? (u32)atoi(Dash + 1) : Config.RatingMin;
+		}
+		else
+		{
+			printf("Usage : %s [-host name] [-port n] [-bots n] [-rate moves_per_second_per_bot] [-duration seconds] [-greedy] [-clock minutes+increment] [-ratings min-max] [-drop percent] [-premove percent] [-local path [-spin]] [-nagle]\n", Arguments[0]);
+			return(1);
+		}
+	}
+	if(Config.BotCount > MAX_BOT_COUNT)
+	{
+		Config.BotCount = MAX_BOT_COUNT;
+	}
+	if(Config.RatingMax < Config.RatingMin)
+	{
+		Config.RatingMax = Config.RatingMin;
+	}
+
+	s32 SDLInitResult = SDL_Init(SDL_INIT_TIMER);
+	Assert(SDLInitResult == 0);
+	InitialiseSockets();
+
+	u64 StorageSize = sizeof(bot_state) + Megabytes(16);
+	void* Storage = Allocate_(StorageSize);
+	Assert(Storage);
+	bot_state* BotState = (bot_state*)Storage;
+	*BotState = {};
+	BotState->Config = Config;
+	InitialiseArena(&BotState->ScratchArena, StorageSize - sizeof(bot_state), (u8*)Storage + sizeof(bot_state));
+
+	u64 CounterFrequency = SDL_GetPerformanceFrequency();
+	u64 StartTime = SDL_GetPerformanceCounter();
+	BotState->RandomState = StartTime | 1;
+
+	u32 ConnectedCount = 0;
+	for(u32 BotIndex = 0; BotIndex < Config.BotCount; ++BotIndex)
+	{
+		bot* Bot = BotState->Bots + BotIndex;
+		if(!BotConnect(&Config, Bot))
+		{
+			if(Config.LocalPath)
+			{
+				printf("Could not open connexion #%u to %s, going on with %u bots.\n",
+						BotIndex, Config.LocalPath, ConnectedCount);
+			}
+			else
+			{
+				printf("Could not open connexion #%u to %s:%u, going on with %u bots.\n",
+						BotIndex, Config.HostName, Config.Port, ConnectedCount);
+			}
+			break;
+		}
+
+		Bot->IsConnected = true;
+		Bot->Rating = Config.RatingMin + (u32)(RandomNext(BotState) % (Config.RatingMax - Config.RatingMin + 1));
+		Bot->Mode = BotMode_Lobby;
+		Bot->NextMoveTime = StartTime;
+		++ConnectedCount;
+	}
+
+	u64 LastReportTime = SDL_GetPerformanceCounter();
+	bool Running = (ConnectedCount > 0);
+	while(Running)
+	{
+		u32 PollCount = 0;
+		// NOTE(hugo) : A local bot with something already in its ring must
+		// not sleep in poll, nothing will ring its doorbell for that.
+		bool HasLocalInput = Config.IsSpinning;
+		for(u32 BotIndex = 0; BotIndex < Config.BotCount; ++BotIndex)
+		{
+			bot* Bot = BotState->Bots + BotIndex;
+			if(Bot->IsConnected)
+			{
+				if(IsLocalChannel(&Bot->Local) && !Config.IsSpinning && !PrepareLocalWait(&Bot->Local))
+				{
+					HasLocalInput = true;
+				}
+				BotState->Polls[PollCount].fd = Bot->Socket;
+				BotState->Polls[PollCount].events = POLLIN;
+				BotState->Polls[PollCount].revents = 0;
+				BotState->PolledBots[PollCount] = Bot;
+				++PollCount;
+			}
+		}
+
+		s32 ActiveSocketCount = PollSockets(BotState->Polls, PollCount, HasLocalInput ? 0 : BOT_POLL_TIMEOUT_MS);
+		Assert(ActiveSocketCount != -1);
+
+		u64 Now = SDL_GetPerformanceCounter();
+		for(u32 PollIndex = 0; PollIndex < PollCount; ++PollIndex)
+		{
+			bot* Bot = BotState->PolledBots[PollIndex];
+			bool IsLocal = IsLocalChannel(&Bot->Local);
+			if(IsLocal && !Config.IsSpinning)
+			{
+				EndLocalWait(&Bot->Local);
+			}
+			if(!(BotState->Polls[PollIndex].revents & (POLLIN | POLLHUP | POLLERR)) &&
+					!(IsLocal && HasLocalInbound(&Bot->Local)))
+			{
+				continue;
+			}
+
+			s32 ReceivedBytes = ReceiveFromPeer(Bot->Socket, &Bot->Local,
+					Bot->InboundBuffer + Bot->InboundSize,
+					INBOUND_BUFFER_SIZE - Bot->InboundSize);
+			if(ReceivedBytes == SOCKET_WOULD_BLOCK)
+			{
+				continue;
+			}
+			if(ReceivedBytes <= 0)
+			{
+				ClosePeer(Bot->Socket, &Bot->Local);
+				Bot->IsConnected = false;
+				--ConnectedCount;
+				continue;
+			}
+
+			Bot->InboundSize += ReceivedBytes;
+			u32 MessageSize = sizeof(network_synchess_message);
+			u32 ReadOffset = 0;
+			while(Bot->InboundSize - ReadOffset >= MessageSize)
+			{
+				network_synchess_message Message = {};
+				memcpy(&Message, Bot->InboundBuffer + ReadOffset, MessageSize);
+				ReadOffset += MessageSize;
+				HandleServerMessage(BotState, Bot, &Message, Now, CounterFrequency);
+			}
+			Bot->InboundSize -= ReadOffset;
+			memmove(Bot->InboundBuffer, Bot->InboundBuffer + ReadOffset, Bot->InboundSize);
+		}
+
+		for(u32 BotIndex = 0; BotIndex < Config.BotCount; ++BotIndex)
+		{
+			bot* Bot = BotState->Bots + BotIndex;
+			if(Bot->IsConnected)
+			{
+				UpdateBot(BotState, Bot, Now, CounterFrequency);
+				if(!Bot->IsConnected)
+				{
+					--ConnectedCount;
+				}
+			}
+		}
+
+		if(Now - LastReportTime >= (BOT_REPORT_PERIOD_MS * CounterFrequency) / 1000)
+		{
+			float Seconds = (float)(Now - LastReportTime) / (float)CounterFrequency;
+			PrintStats("[interval]", &BotState->Interval, Seconds, ConnectedCount);
+			MergeStats(&BotState->Total, &BotState->Interval);
+			BotState->Interval = {};
+			LastReportTime = Now;
+		}
+
+		float ElapsedSeconds = (float)(Now - StartTime) / (float)CounterFrequency;
+		if(((Config.DurationSeconds > 0) && (ElapsedSeconds >= (float)Config.DurationSeconds)) ||
+				(ConnectedCount == 0))
+		{
+			Running = false;
+		}
+	}
+
+	MergeStats(&BotState->Total, &BotState->Interval);
+	float TotalSeconds = (float)(SDL_GetPerformanceCounter() - StartTime) / (float)CounterFrequency;
+	PrintStats("[total]", &BotState->Total, TotalSeconds, ConnectedCount);
+
+	for(u32 BotIndex = 0; BotIndex < Config.BotCount; ++BotIndex)
+	{
+		bot* Bot = BotState->Bots + BotIndex;
+		if(Bot->IsConnected)
+		{
+			ClosePeer(Bot->Socket, &Bot->Local);
+		}
+	}
+	SDL_Quit();
+
+	return(0);
+}
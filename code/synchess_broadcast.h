@@ -0,0 +1,199 @@
+#pragma once
+
+// NOTE(hugo) : A message that goes to several peers (players and
+// spectators of a room) is encoded once into a shared, reference-counted
+// buffer. Each peer only queues a pointer to it, and the queue is
+// flushed with a single gathered send, so there is never a copy per
+// recipient in userland.
+//
+// Messages are ~100 bytes, far below the size where MSG_ZEROCOPY
+// pays for its completion notifications, so plain writev it is.
+
+struct shared_message
+{
+	u32 RefCount;
+	u32 Size;
+	shared_message* NextFree;
+
+	network_synchess_message Message;
+};
+
+struct shared_message_pool
+{
+	memory_arena* Arena;
+	shared_message* FirstFree;
+
+	u64 LiveCount;
+	u64 AllocatedCount;
+};
+
+// NOTE(hugo) : Must be a power of two.
+#define OUTBOUND_QUEUE_SIZE 64
+
+struct outbound_queue
+{
+	shared_message* Messages[OUTBOUND_QUEUE_SIZE];
+	u32 ReadIndex;
+	u32 WriteIndex;
+
+	// NOTE(hugo) : Bytes of the oldest message already sent.
+	u32 ReadOffset;
+};
+
+internal void
+InitialiseSharedMessagePool(shared_message_pool* Pool, memory_arena* Arena)
+{
+	Pool->Arena = Arena;
+	Pool->FirstFree = 0;
+	Pool->LiveCount = 0;
+	Pool->AllocatedCount = 0;
+}
+
+// NOTE(hugo) : The returned message holds one reference for the caller,
+// that must be released once it has been queued to every recipient.
+internal shared_message*
+EncodeSharedMessage(shared_message_pool* Pool, network_synchess_message* Message)
+{
+	shared_message* Result = Pool->FirstFree;
+	if(Result)
+	{
+		Pool->FirstFree = Result->NextFree;
+	}
+	else
+	{
+		// NOTE(hugo) : The pool only grows up to the peak number of
+		// messages in flight, after that everything is recycled.
+		Result = PushStruct(Pool->Arena, shared_message);
+		++Pool->AllocatedCount;
+	}
+
+	Result->RefCount = 1;
+	Result->Size = sizeof(network_synchess_message);
+	Result->NextFree = 0;
+	Result->Message = *Message;
+	++Pool->LiveCount;
+
+	return(Result);
+}
+
+internal void
+ReleaseSharedMessage(shared_message_pool* Pool, shared_message* Shared)
+{
+	Assert(Shared->RefCount > 0);
+	--Shared->RefCount;
+	if(Shared->RefCount == 0)
+	{
+		Shared->NextFree = Pool->FirstFree;
+		Pool->FirstFree = Shared;
+		--Pool->LiveCount;
+	}
+}
+
+internal u32
+GetOutboundQueueCount(outbound_queue* Queue)
+{
+	u32 Result = Queue->WriteIndex - Queue->ReadIndex;
+	return(Result);
+}
+
+internal bool
+QueueSharedMessage(outbound_queue* Queue, shared_message* Shared)
+{
+	bool Queued = false;
+	if(GetOutboundQueueCount(Queue) < OUTBOUND_QUEUE_SIZE)
+	{
+		++Shared->RefCount;
+		Queue->Messages[Queue->WriteIndex & (OUTBOUND_QUEUE_SIZE - 1)] = Shared;
+		++Queue->WriteIndex;
+		Queued = true;
+	}
+
+	return(Queued);
+}
+
+// NOTE(hugo) : Swaps the newest queued message for a fresher one, as long
+// as it has not started to go out. Only valid for messages that carry
+// the whole state (context updates), where the newest supersedes the old.
+internal bool
+ReplaceNewestQueuedMessage(outbound_queue* Queue, shared_message* Shared, shared_message_pool* Pool)
+{
+	bool Replaced = false;
+	u32 Count = GetOutboundQueueCount(Queue);
+	u32 NewestIndex = Queue->WriteIndex - 1;
+	if((Count > 0) && ((NewestIndex != Queue->ReadIndex) || (Queue->ReadOffset == 0)))
+	{
+		shared_message** Newest = Queue->Messages + (NewestIndex & (OUTBOUND_QUEUE_SIZE - 1));
+		if((*Newest)->Message.Type == Shared->Message.Type)
+		{
+			ReleaseSharedMessage(Pool, *Newest);
+			++Shared->RefCount;
+			*Newest = Shared;
+			Replaced = true;
+		}
+	}
+
+	return(Replaced);
+}
+
+internal void
+ClearOutboundQueue(outbound_queue* Queue, shared_message_pool* Pool)
+{
+	while(Queue->ReadIndex != Queue->WriteIndex)
+	{
+		ReleaseSharedMessage(Pool, Queue->Messages[Queue->ReadIndex & (OUTBOUND_QUEUE_SIZE - 1)]);
+		++Queue->ReadIndex;
+	}
+	Queue->ReadOffset = 0;
+}
+
+// NOTE(hugo) : Hands all the queued messages to the peer in one
+// gathered send (or one copy into its local ring) and drops the ones
+// that went through. The socket is non-blocking and the ring bounded,
+// so this might only send part of the queue.
+// Returns the number of bytes sent, -1 on error.
+internal s32
+FlushOutboundQueue(platform_socket Socket, local_channel* Channel, outbound_queue* Queue, shared_message_pool* Pool)
+{
+	send_slice Slices[MAX_SEND_SLICE_COUNT];
+	u32 SliceCount = 0;
+	for(u32 QueueIndex = Queue->ReadIndex;
+			(QueueIndex != Queue->WriteIndex) && (SliceCount < ArrayCount(Slices));
+			++QueueIndex)
+	{
+		shared_message* Shared = Queue->Messages[QueueIndex & (OUTBOUND_QUEUE_SIZE - 1)];
+		u32 Offset = (QueueIndex == Queue->ReadIndex) ? Queue->ReadOffset : 0;
+		Slices[SliceCount].Data = (u8*)&Shared->Message + Offset;
+		Slices[SliceCount].Size = Shared->Size - Offset;
+		++SliceCount;
+	}
+
+	s32 Result = 0;
+	if(SliceCount > 0)
+	{
+		Result = SendSlicesToPeer(Socket, Channel, Slices, SliceCount);
+	}
+
+	if(Result > 0)
+	{
+		u32 SentBytes = (u32)Result;
+		while(SentBytes > 0)
+		{
+			shared_message* Shared = Queue->Messages[Queue->ReadIndex & (OUTBOUND_QUEUE_SIZE - 1)];
+			u32 RemainingBytes = Shared->Size - Queue->ReadOffset;
+			if(SentBytes >= RemainingBytes)
+			{
+				SentBytes -= RemainingBytes;
+				ReleaseSharedMessage(Pool, Shared);
+				++Queue->ReadIndex;
+				Queue->ReadOffset = 0;
+			}
+			else
+			{
+				Queue->ReadOffset += SentBytes;
+				SentBytes = 0;
+			}
+		}
+	}
+
+	return(Result);
+}
@@ -0,0 +1,336 @@
+#pragma once
+
+// NOTE(hugo) : The connexion of the client to the server, on a thread of
+// its own. The network thread connects without blocking, cuts the byte
+// stream into messages, and connects again whenever the connexion is
+// lost. It hands the game the decoded messages (and the news of the
+// connexion) through the Inbound queue, and takes the messages to send
+// from the Outbound queue, so the game loop never waits on the network.
+//
+// Every connexion gets a new index. The game stamps what it sends with
+// the index of the connexion it knows of, so that a message meant for
+// a connexion that is already gone is dropped instead of going out
+// ahead of the hello of the next one.
+
+#include "synchess_socket.h"
+#include "synchess_queue.h"
+
+#define CLIENT_QUEUE_CAPACITY 256
+#define CLIENT_BUFFER_MESSAGE_COUNT 64
+#define RECONNECT_PERIOD_MS 1000
+
+enum client_network_event_type
+{
+	ClientNetworkEvent_Connected,
+	ClientNetworkEvent_Message,
+	ClientNetworkEvent_ConnectionLost,
+};
+
+struct client_network_event
+{
+	client_network_event_type Type;
+	u32 ConnectionIndex;
+	network_synchess_message Message;
+};
+
+struct client_outbound_message
+{
+	u32 ConnectionIndex;
+	network_synchess_message Message;
+};
+
+struct client_network
+{
+	char* HostName;
+	u16 Port;
+	// NOTE(hugo) : 0 to play, the game to watch otherwise.
+	u32 SpectatedGameID;
+
+	// NOTE(hugo) : The network thread is the producer of Inbound and the
+	// consumer of Outbound. It sleeps in poll, the game wakes it up with
+	// the wakeup pair after a push. It pushes a NetworkEventType SDL event
+	// after its pushes, for a game loop that sleeps in SDL_WaitEvent.
+	spsc_queue Inbound;
+	spsc_queue Outbound;
+	platform_socket WakeupReceiver;
+	platform_socket WakeupSender;
+	u32 NetworkEventType;
+	SDL_atomic_t IsRunning;
+	SDL_Thread* Thread;
+
+	// NOTE(hugo) : Network thread only from here on.
+	platform_socket Socket;
+	bool IsConnecting;
+	u32 ConnectionIndex;
+	u32 NextConnectTicks;
+
+	u32 InboundSize;
+	u8 InboundBuffer[CLIENT_BUFFER_MESSAGE_COUNT * sizeof(network_synchess_message)];
+	u32 OutboundSize;
+	u8 OutboundBuffer[CLIENT_BUFFER_MESSAGE_COUNT * sizeof(network_synchess_message)];
+
+	// NOTE(hugo) : What did not fit in a full Inbound queue. Nothing is
+	// read from the socket until it is all pushed, so this only ever holds
+	// what one read brought, plus the news of the connexion.
+	u32 PendingEventCount;
+	client_network_event PendingEvents[CLIENT_BUFFER_MESSAGE_COUNT + 2];
+};
+
+internal void
+PostNetworkEvent(client_network* Network, client_network_event_type Type, network_synchess_message* Message)
+{
+	client_network_event Event = {};
+	Event.Type = Type;
+	Event.ConnectionIndex = Network->ConnectionIndex;
+	if(Message)
+	{
+		Event.Message = *Message;
+	}
+
+	// NOTE(hugo) : Behind the ones already waiting, to keep the order.
+	if((Network->PendingEventCount > 0) || !PushSPSCQueue(&Network->Inbound, &Event))
+	{
+		Assert(Network->PendingEventCount < ArrayCount(Network->PendingEvents));
+		Network->PendingEvents[Network->PendingEventCount++] = Event;
+	}
+}
+
+internal void
+FlushPendingNetworkEvents(client_network* Network)
+{
+	u32 PushedCount = 0;
+	while((PushedCount < Network->PendingEventCount) &&
+			PushSPSCQueue(&Network->Inbound, Network->PendingEvents + PushedCount))
+	{
+		++PushedCount;
+	}
+	Network->PendingEventCount -= PushedCount;
+	memmove(Network->PendingEvents, Network->PendingEvents + PushedCount,
+			Network->PendingEventCount * sizeof(client_network_event));
+}
+
+internal void
+DropServerConnection(client_network* Network)
+{
+	Assert(Network->Socket != INVALID_PLATFORM_SOCKET);
+	CloseSocket(Network->Socket);
+	Network->Socket = INVALID_PLATFORM_SOCKET;
+	Network->InboundSize = 0;
+	Network->OutboundSize = 0;
+	if(!Network->IsConnecting)
+	{
+		PostNetworkEvent(Network, ClientNetworkEvent_ConnectionLost, 0);
+		// NOTE(hugo) : Straight back at it, the period is between failed attempts.
+		Network->NextConnectTicks = SDL_GetTicks();
+	}
+	Network->IsConnecting = false;
+}
+
+// NOTE(hugo) : Reads what the socket has, as long as there is room for it,
+// and posts every whole message.
+internal void
+ReceiveServerMessages(client_network* Network)
+{
+	u32 MessageSize = sizeof(network_synchess_message);
+	while((Network->Socket != INVALID_PLATFORM_SOCKET) && (Network->PendingEventCount == 0))
+	{
+		s32 ReceivedBytes = ReceiveFromSocket(Network->Socket, Network->InboundBuffer + Network->InboundSize,
+				sizeof(Network->InboundBuffer) - Network->InboundSize);
+		if(ReceivedBytes == SOCKET_WOULD_BLOCK)
+		{
+			break;
+		}
+		if(ReceivedBytes <= 0)
+		{
+			// NOTE(hugo) : The server closed the connexion, or the network dropped it.
+			DropServerConnection(Network);
+			break;
+		}
+
+		Network->InboundSize += ReceivedBytes;
+		u32 ReadOffset = 0;
+		while(Network->InboundSize - ReadOffset >= MessageSize)
+		{
+			network_synchess_message Message = {};
+			memcpy(&Message, Network->InboundBuffer + ReadOffset, MessageSize);
+			PostNetworkEvent(Network, ClientNetworkEvent_Message, &Message);
+			ReadOffset += MessageSize;
+		}
+		Network->InboundSize -= ReadOffset;
+		memmove(Network->InboundBuffer, Network->InboundBuffer + ReadOffset, Network->InboundSize);
+	}
+}
+
+// NOTE(hugo) : Takes what the game queued for this connexion, as long as
+// there is room for it, and sends as much of it as the socket takes.
+internal void
+SendServerMessages(client_network* Network)
+{
+	u32 MessageSize = sizeof(network_synchess_message);
+	client_outbound_message Outbound = {};
+	while((Network->OutboundSize + MessageSize <= sizeof(Network->OutboundBuffer)) &&
+			PopSPSCQueue(&Network->Outbound, &Outbound))
+	{
+		if((Network->Socket != INVALID_PLATFORM_SOCKET) && !Network->IsConnecting &&
+				(Outbound.ConnectionIndex == Network->ConnectionIndex))
+		{
+			memcpy(Network->OutboundBuffer + Network->OutboundSize, &Outbound.Message, MessageSize);
+			Network->OutboundSize += MessageSize;
+		}
+	}
+
+	if((Network->OutboundSize > 0) && (Network->Socket != INVALID_PLATFORM_SOCKET) && !Network->IsConnecting)
+	{
+		send_slice Slice = {Network->OutboundBuffer, Network->OutboundSize};
+		s32 SentBytes = SendSlices(Network->Socket, &Slice, 1);
+		if(SentBytes < 0)
+		{
+			DropServerConnection(Network);
+		}
+		else
+		{
+			Network->OutboundSize -= SentBytes;
+			memmove(Network->OutboundBuffer, Network->OutboundBuffer + SentBytes, Network->OutboundSize);
+		}
+	}
+}
+
+internal s32
+ClientNetworkThread(void* Data)
+{
+	client_network* Network = (client_network*)Data;
+	while(SDL_AtomicGet(&Network->IsRunning))
+	{
+		FlushPendingNetworkEvents(Network);
+
+		u32 NowTicks = SDL_GetTicks();
+		if((Network->Socket == INVALID_PLATFORM_SOCKET) && (Network->PendingEventCount == 0) &&
+				((s32)(NowTicks - Network->NextConnectTicks) >= 0))
+		{
+			Network->NextConnectTicks = NowTicks + RECONNECT_PERIOD_MS;
+			Network->Socket = StartConnection(Network->HostName, Network->Port);
+			Network->IsConnecting = (Network->Socket != INVALID_PLATFORM_SOCKET);
+		}
+
+		SendServerMessages(Network);
+
+		socket_poll Polls[2] = {};
+		Polls[0].fd = Network->WakeupReceiver;
+		Polls[0].events = POLLIN;
+		u32 PollCount = 1;
+		if(Network->Socket != INVALID_PLATFORM_SOCKET)
+		{
+			Polls[1].fd = Network->Socket;
+			if(Network->IsConnecting || (Network->OutboundSize > 0))
+			{
+				Polls[1].events |= POLLOUT;
+			}
+			if(!Network->IsConnecting && (Network->PendingEventCount == 0))
+			{
+				Polls[1].events |= POLLIN;
+			}
+			// NOTE(hugo) : Not even for a hang up while the events are stuck,
+			// that would only spin until they are pushed.
+			if(Polls[1].events)
+			{
+				++PollCount;
+			}
+		}
+
+		// NOTE(hugo) : The game does not wake us up when it makes room in
+		// Inbound, so check back soon while events are pending.
+		s32 TimeoutMS = -1;
+		if(Network->PendingEventCount > 0)
+		{
+			TimeoutMS = 5;
+		}
+		else if(Network->Socket == INVALID_PLATFORM_SOCKET)
+		{
+			s32 UntilConnect = (s32)(Network->NextConnectTicks - SDL_GetTicks());
+			TimeoutMS = (UntilConnect > 0) ? UntilConnect : 0;
+		}
+		u32 WriteBefore = (u32)SDL_AtomicGet(&Network->Inbound.WritePosition);
+		PollSockets(Polls, PollCount, TimeoutMS);
+
+		if(Polls[0].revents)
+		{
+			DrainWakeups(Network->WakeupReceiver);
+		}
+		if((PollCount > 1) && Polls[1].revents)
+		{
+			if(Network->IsConnecting)
+			{
+				if(FinishConnection(Network->Socket))
+				{
+					Network->IsConnecting = false;
+					++Network->ConnectionIndex;
+					SetSocketNoDelay(Network->Socket, true);
+					PostNetworkEvent(Network, ClientNetworkEvent_Connected, 0);
+				}
+				else
+				{
+					DropServerConnection(Network);
+				}
+			}
+			else
+			{
+				ReceiveServerMessages(Network);
+			}
+		}
+
+		if((u32)SDL_AtomicGet(&Network->Inbound.WritePosition) != WriteBefore)
+		{
+			SDL_Event Event = {};
+			Event.type = Network->NetworkEventType;
+			SDL_PushEvent(&Event);
+		}
+	}
+
+	if(Network->Socket != INVALID_PLATFORM_SOCKET)
+	{
+		CloseSocket(Network->Socket);
+		Network->Socket = INVALID_PLATFORM_SOCKET;
+	}
+
+	return(0);
+}
+
+internal void
+StartClientNetwork(client_network* Network, memory_arena* Arena)
+{
+	InitialiseSockets();
+	InitialiseSPSCQueue(&Network->Inbound, CLIENT_QUEUE_CAPACITY, sizeof(client_network_event), Arena);
+	InitialiseSPSCQueue(&Network->Outbound, CLIENT_QUEUE_CAPACITY, sizeof(client_outbound_message), Arena);
+	OpenWakeupPair(&Network->WakeupReceiver, &Network->WakeupSender);
+	Network->NetworkEventType = SDL_RegisterEvents(1);
+	Assert(Network->NetworkEventType != (u32)-1);
+
+	Network->Socket = INVALID_PLATFORM_SOCKET;
+	Network->NextConnectTicks = SDL_GetTicks();
+	SDL_AtomicSet(&Network->IsRunning, 1);
+	Network->Thread = SDL_CreateThread(ClientNetworkThread, "network", Network);
+	Assert(Network->Thread);
+}
+
+internal void
+StopClientNetwork(client_network* Network)
+{
+	SDL_AtomicSet(&Network->IsRunning, 0);
+	SendWakeup(Network->WakeupSender);
+	SDL_WaitThread(Network->Thread, 0);
+	CloseSocket(Network->WakeupReceiver);
+	CloseSocket(Network->WakeupSender);
+}
+
+// NOTE(hugo) : Game thread. Returns false if the message could not be
+// queued, it is then as lost as if the connexion had dropped it.
+internal bool
+QueueServerMessage(client_network* Network, u32 ConnectionIndex, network_synchess_message* Message)
+{
+	client_outbound_message Outbound = {};
+	Outbound.ConnectionIndex = ConnectionIndex;
+	Outbound.Message = *Message;
+	bool Result = PushSPSCQueue(&Network->Outbound, &Outbound);
+	SendWakeup(Network->WakeupSender);
+	return(Result);
+}
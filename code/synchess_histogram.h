@@ -0,0 +1,100 @@
+#pragma once
+
+// NOTE(hugo) : Log-linear histogram of latencies (HDR style), in whatever
+// unit the caller records them. Each power of two is split in
+// LATENCY_SUB_BUCKET_COUNT buckets, which bounds the relative error to
+// ~6% for a constant size, and recording a value is a single increment.
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKET_COUNT (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKET_COUNT (32 * LATENCY_SUB_BUCKET_COUNT)
+
+struct latency_histogram
+{
+	u64 Buckets[LATENCY_BUCKET_COUNT];
+	u64 SampleCount;
+	u64 MaxValue;
+};
+
+internal u32
+GetLatencyBucketIndex(u64 Value)
+{
+	u32 Result = (u32)Value;
+	if(Value >= LATENCY_SUB_BUCKET_COUNT)
+	{
+		u32 HighBit = 0;
+		for(u64 Shifted = Value >> 1; Shifted; Shifted >>= 1)
+		{
+			++HighBit;
+		}
+		u32 SubBucket = (u32)(Value >> (HighBit - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKET_COUNT - 1);
+		Result = (HighBit - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_COUNT + SubBucket;
+	}
+	if(Result >= LATENCY_BUCKET_COUNT)
+	{
+		Result = LATENCY_BUCKET_COUNT - 1;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Smallest value that lands in the bucket.
+internal u64
+GetLatencyBucketValue(u32 BucketIndex)
+{
+	u64 Result = BucketIndex;
+	if(BucketIndex >= LATENCY_SUB_BUCKET_COUNT)
+	{
+		u32 Shift = (BucketIndex / LATENCY_SUB_BUCKET_COUNT) - 1;
+		u64 SubBucket = BucketIndex & (LATENCY_SUB_BUCKET_COUNT - 1);
+		Result = (LATENCY_SUB_BUCKET_COUNT + SubBucket) << Shift;
+	}
+
+	return(Result);
+}
+
+internal void
+RecordLatency(latency_histogram* Histogram, u64 Value)
+{
+	++Histogram->Buckets[GetLatencyBucketIndex(Value)];
+	++Histogram->SampleCount;
+	if(Value > Histogram->MaxValue)
+	{
+		Histogram->MaxValue = Value;
+	}
+}
+
+internal u64
+GetLatencyPercentile(latency_histogram* Histogram, float Percentile)
+{
+	u64 Result = 0;
+	if(Histogram->SampleCount > 0)
+	{
+		u64 Rank = (u64)(Percentile * 0.01f * (float)(Histogram->SampleCount - 1));
+		u64 SeenCount = 0;
+		for(u32 BucketIndex = 0; BucketIndex < LATENCY_BUCKET_COUNT; ++BucketIndex)
+		{
+			SeenCount += Histogram->Buckets[BucketIndex];
+			if(SeenCount > Rank)
+			{
+				Result = GetLatencyBucketValue(BucketIndex);
+				break;
+			}
+		}
+	}
+
+	return(Result);
+}
+
+internal void
+MergeLatencyHistogram(latency_histogram* Dest, latency_histogram* Source)
+{
+	for(u32 BucketIndex = 0; BucketIndex < LATENCY_BUCKET_COUNT; ++BucketIndex)
+	{
+		Dest->Buckets[BucketIndex] += Source->Buckets[BucketIndex];
+	}
+	Dest->SampleCount += Source->SampleCount;
+	if(Source->MaxValue > Dest->MaxValue)
+	{
+		Dest->MaxValue = Source->MaxValue;
+	}
+}
@@ -0,0 +1,580 @@
+#pragma once
+
+// NOTE(hugo) : Append-only write-ahead log of the server games.
+//
+// The game thread only appends fixed-size records into an in-memory
+// buffer and goes on with its life : it never waits for the disk.
+// A dedicated I/O thread swaps the buffers, writes the whole batch
+// and issues a single fdatasync for it (group commit). Everything
+// appended while a sync is in flight ends up in the next batch, so
+// the number of syncs adapts to the disk speed, not to the move rate.
+//
+// On startup the journal is replayed to rebuild every game that was
+// still running, then rewritten with only those games so that it does
+// not grow forever across restarts.
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define SYNCHESS_JOURNAL_PATH "synchess.journal"
+#define JOURNAL_MAGIC 0x4A4E5953 // NOTE(hugo) : 'SYNJ'
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUFFER_SIZE Megabytes(1)
+
+enum journal_record_type
+{
+	JournalRecord_GameCreated,
+	JournalRecord_Move,
+	JournalRecord_GameEnded,
+
+	JournalRecord_Count,
+};
+
+struct journal_header
+{
+	u32 Magic;
+	u32 Version;
+};
+
+// NOTE(hugo) : What it takes for the players to get back to a recovered game.
+struct journal_game_created
+{
+	time_control TimeControl;
+	u32 ReconnectTokens[PieceColor_Count];
+};
+
+// NOTE(hugo) : RemainingMS is the time the mover has left once the move
+// is played, 0 for a game without a clock.
+struct journal_move
+{
+	move_params Move;
+	u32 RemainingMS;
+};
+
+struct journal_record
+{
+	journal_record_type Type;
+	u32 GameID;
+
+	union
+	{
+		journal_game_created GameCreated;
+		journal_move Move;
+		game_result Result;
+	};
+};
+
+struct journal_buffer
+{
+	u8* Base;
+	u32 Used;
+};
+
+struct game_journal
+{
+	FILE* File;
+
+	SDL_Thread* Thread;
+	SDL_mutex* Mutex;
+	SDL_cond* WorkAvailable;
+	SDL_cond* BufferSwapped;
+
+	// NOTE(hugo) : The game thread appends into the front buffer,
+	// the I/O thread writes the back buffer to the disk.
+	journal_buffer Buffers[2];
+	u32 FrontBufferIndex;
+	bool IsWriterIdle;
+	bool IsRunning;
+
+	// NOTE(hugo) : Stats, only touched under the mutex.
+	u64 RecordCount;
+	u64 CommitCount;
+};
+
+internal bool
+SyncFileToDisk(FILE* File)
+{
+	bool Result = (fflush(File) == 0);
+#ifdef _WIN32
+	Result = (_commit(_fileno(File)) == 0) && Result;
+#else
+	Result = (fdatasync(fileno(File)) == 0) && Result;
+#endif
+	return(Result);
+}
+
+internal s32
+JournalWriterThread(void* Data)
+{
+	game_journal* Journal = (game_journal*)Data;
+
+	SDL_LockMutex(Journal->Mutex);
+	for(;;)
+	{
+		journal_buffer* Front = Journal->Buffers + Journal->FrontBufferIndex;
+		if(Front->Used == 0)
+		{
+			if(!Journal->IsRunning)
+			{
+				break;
+			}
+			Journal->IsWriterIdle = true;
+			SDL_CondWait(Journal->WorkAvailable, Journal->Mutex);
+			Journal->IsWriterIdle = false;
+			continue;
+		}
+
+		// NOTE(hugo) : Take everything that was appended so far as one batch.
+		u32 BackBufferIndex = Journal->FrontBufferIndex;
+		Journal->FrontBufferIndex = 1 - Journal->FrontBufferIndex;
+		SDL_CondBroadcast(Journal->BufferSwapped);
+		SDL_UnlockMutex(Journal->Mutex);
+
+		journal_buffer* Back = Journal->Buffers + BackBufferIndex;
+		size_t WrittenBytes = fwrite(Back->Base, 1, Back->Used, Journal->File);
+		Assert(WrittenBytes == Back->Used);
+		SyncFileToDisk(Journal->File);
+
+		SDL_LockMutex(Journal->Mutex);
+		Back->Used = 0;
+		++Journal->CommitCount;
+	}
+	SDL_UnlockMutex(Journal->Mutex);
+
+	return(0);
+}
+
+internal void
+StartJournal(game_journal* Journal, char* Path, memory_arena* Arena)
+{
+	Journal->File = fopen(Path, "ab");
+	Assert(Journal->File);
+
+	for(u32 BufferIndex = 0; BufferIndex < ArrayCount(Journal->Buffers); ++BufferIndex)
+	{
+		Journal->Buffers[BufferIndex].Base = (u8*)PushSize(Arena, JOURNAL_BUFFER_SIZE);
+		Journal->Buffers[BufferIndex].Used = 0;
+	}
+	Journal->FrontBufferIndex = 0;
+	Journal->IsWriterIdle = false;
+	Journal->IsRunning = true;
+	Journal->RecordCount = 0;
+	Journal->CommitCount = 0;
+
+	Journal->Mutex = SDL_CreateMutex();
+	Journal->WorkAvailable = SDL_CreateCond();
+	Journal->BufferSwapped = SDL_CreateCond();
+	Assert(Journal->Mutex && Journal->WorkAvailable && Journal->BufferSwapped);
+
+	Journal->Thread = SDL_CreateThread(JournalWriterThread, "JournalWriter", Journal);
+	Assert(Journal->Thread);
+}
+
+internal void
+StopJournal(game_journal* Journal)
+{
+	SDL_LockMutex(Journal->Mutex);
+	Journal->IsRunning = false;
+	SDL_CondSignal(Journal->WorkAvailable);
+	SDL_UnlockMutex(Journal->Mutex);
+
+	SDL_WaitThread(Journal->Thread, 0);
+	fclose(Journal->File);
+
+	SDL_DestroyCond(Journal->BufferSwapped);
+	SDL_DestroyCond(Journal->WorkAvailable);
+	SDL_DestroyMutex(Journal->Mutex);
+}
+
+internal void
+AppendJournalRecord(game_journal* Journal, journal_record* Record)
+{
+	SDL_LockMutex(Journal->Mutex);
+
+	// NOTE(hugo) : Only happens if the disk cannot keep up with a whole
+	// buffer worth of records. Then we have no choice but to wait.
+	while(Journal->Buffers[Journal->FrontBufferIndex].Used + sizeof(*Record) > JOURNAL_BUFFER_SIZE)
+	{
+		SDL_CondSignal(Journal->WorkAvailable);
+		SDL_CondWait(Journal->BufferSwapped, Journal->Mutex);
+	}
+
+	journal_buffer* Front = Journal->Buffers + Journal->FrontBufferIndex;
+	memcpy(Front->Base + Front->Used, Record, sizeof(*Record));
+	Front->Used += sizeof(*Record);
+	++Journal->RecordCount;
+
+	if(Journal->IsWriterIdle)
+	{
+		SDL_CondSignal(Journal->WorkAvailable);
+	}
+
+	SDL_UnlockMutex(Journal->Mutex);
+}
+
+internal void
+JournalGameCreated(game_journal* Journal, game_room* Room)
+{
+	journal_record Record = {};
+	Record.Type = JournalRecord_GameCreated;
+	Record.GameID = Room->GameID;
+	Record.GameCreated.TimeControl = Room->Clock.TimeControl;
+	Record.GameCreated.ReconnectTokens[PieceColor_White] = Room->ReconnectTokens[PieceColor_White];
+	Record.GameCreated.ReconnectTokens[PieceColor_Black] = Room->ReconnectTokens[PieceColor_Black];
+	AppendJournalRecord(Journal, &Record);
+}
+
+internal void
+JournalMove(game_journal* Journal, u32 GameID, move_params Move, u32 RemainingMS)
+{
+	journal_record Record = {};
+	Record.Type = JournalRecord_Move;
+	Record.GameID = GameID;
+	Record.Move.Move = Move;
+	Record.Move.RemainingMS = RemainingMS;
+	AppendJournalRecord(Journal, &Record);
+}
+
+internal void
+JournalGameEnded(game_journal* Journal, u32 GameID, game_result Result)
+{
+	journal_record Record = {};
+	Record.Type = JournalRecord_GameEnded;
+	Record.GameID = GameID;
+	Record.Result = Result;
+	AppendJournalRecord(Journal, &Record);
+}
+
+//
+// NOTE(hugo) : Recovery
+// {
+//
+
+struct journal_game_slot
+{
+	u32 GameID;
+	game_room* Room;
+};
+
+internal u32
+GetJournalGameSlotHome(u32 SlotCount, u32 GameID)
+{
+	u32 Result = (GameID * 2654435761u) & (SlotCount - 1);
+	return(Result);
+}
+
+// NOTE(hugo) : Open addressing, SlotCount is a power of two. Only the games
+// that have a room hold a slot, so the table is never more than half full,
+// but a full table would have us probe forever : better to stop there.
+internal journal_game_slot*
+FindJournalGameSlot(journal_game_slot* Slots, u32 SlotCount, u32 GameID)
+{
+	Assert(GameID != 0);
+	u32 SlotMask = SlotCount - 1;
+	u32 SlotIndex = GetJournalGameSlotHome(SlotCount, GameID);
+	u32 ProbeCount = 0;
+	while(Slots[SlotIndex].GameID && (Slots[SlotIndex].GameID != GameID))
+	{
+		++ProbeCount;
+		if(ProbeCount == SlotCount)
+		{
+			printf("The journal game table is full, cannot recover game %u.\n", GameID);
+			InvalidCodePath;
+		}
+		SlotIndex = (SlotIndex + 1) & SlotMask;
+	}
+
+	return(Slots + SlotIndex);
+}
+
+// NOTE(hugo) : Backward-shift deletion, every slot after the hole that can
+// be reached from its home through the hole moves into it, so that no
+// tombstone is left behind and the probe chains stay whole.
+internal void
+DeleteJournalGameSlot(journal_game_slot* Slots, u32 SlotCount, journal_game_slot* Slot)
+{
+	u32 SlotMask = SlotCount - 1;
+	u32 HoleIndex = (u32)(Slot - Slots);
+	u32 SlotIndex = HoleIndex;
+	for(;;)
+	{
+		SlotIndex = (SlotIndex + 1) & SlotMask;
+		if(!Slots[SlotIndex].GameID)
+		{
+			break;
+		}
+
+		u32 HomeIndex = GetJournalGameSlotHome(SlotCount, Slots[SlotIndex].GameID);
+		if(((SlotIndex - HomeIndex) & SlotMask) >= ((SlotIndex - HoleIndex) & SlotMask))
+		{
+			Slots[HoleIndex] = Slots[SlotIndex];
+			HoleIndex = SlotIndex;
+		}
+	}
+	Slots[HoleIndex] = {};
+}
+
+// NOTE(hugo) : A game always lives in the pool of index GameID % PoolCount,
+// so that anyone can tell where a game is from its ID alone.
+internal u32
+GetGamePoolIndex(u32 GameID, u32 PoolCount)
+{
+	u32 Result = GameID % PoolCount;
+	return(Result);
+}
+
+// NOTE(hugo) : Returns false if the snapshot could not be written whole,
+// in which case the old journal is left as it was.
+internal bool
+WriteJournalSnapshot(char* Path, game_room_pool** Pools, u32 PoolCount)
+{
+	// NOTE(hugo) : Written aside and renamed over the old journal so that
+	// a crash in the middle of the rewrite does not lose anything.
+	char TempPath[512];
+	snprintf(TempPath, sizeof(TempPath), "%s.tmp", Path);
+	FILE* File = fopen(TempPath, "wb");
+	if(!File)
+	{
+		return(false);
+	}
+
+	journal_header Header = {};
+	Header.Magic = JOURNAL_MAGIC;
+	Header.Version = JOURNAL_VERSION;
+	bool IsWritten = (fwrite(&Header, sizeof(Header), 1, File) == 1);
+
+	for(u32 PoolIndex = 0; PoolIndex < PoolCount; ++PoolIndex)
+	{
+		game_room_pool* Pool = Pools[PoolIndex];
+		for(u32 RoomIndex = 0; RoomIndex < Pool->RoomCount; ++RoomIndex)
+		{
+			game_room* Room = Pool->Rooms + RoomIndex;
+			if(!Room->IsActive)
+			{
+				continue;
+			}
+
+			journal_record Record = {};
+			Record.Type = JournalRecord_GameCreated;
+			Record.GameID = Room->GameID;
+			Record.GameCreated.TimeControl = Room->Clock.TimeControl;
+			Record.GameCreated.ReconnectTokens[PieceColor_White] = Room->ReconnectTokens[PieceColor_White];
+			Record.GameCreated.ReconnectTokens[PieceColor_Black] = Room->ReconnectTokens[PieceColor_Black];
+			IsWritten = IsWritten && (fwrite(&Record, sizeof(Record), 1, File) == 1);
+
+			for(u32 MoveIndex = 0; MoveIndex < Room->MoveCount; ++MoveIndex)
+			{
+				// NOTE(hugo) : The replay keeps the last clock of each player, the
+				// one it has now is as good for every move of that player. The
+				// last move was played by the other side than the one to play.
+				piece_color Mover = (((Room->MoveCount - MoveIndex) % 2) == 1) ?
+					OtherColor(Room->ChessContext.PlayerToPlay) : Room->ChessContext.PlayerToPlay;
+				Record = {};
+				Record.Type = JournalRecord_Move;
+				Record.GameID = Room->GameID;
+				Record.Move.Move = Room->MoveHistory[MoveIndex];
+				Record.Move.RemainingMS = Room->Clock.RemainingMS[Mover];
+				IsWritten = IsWritten && (fwrite(&Record, sizeof(Record), 1, File) == 1);
+			}
+		}
+	}
+
+	IsWritten = SyncFileToDisk(File) && IsWritten;
+	IsWritten = (fclose(File) == 0) && IsWritten;
+	if(!IsWritten)
+	{
+		remove(TempPath);
+		return(false);
+	}
+
+#ifdef _WIN32
+	remove(Path);
+#endif
+	if(rename(TempPath, Path) != 0)
+	{
+		remove(TempPath);
+		return(false);
+	}
+
+	return(true);
+}
+
+// NOTE(hugo) : Rebuilds every game that has no GameEnded record into a room
+// of its pool, then compacts the journal. Returns the next free GameID.
+internal u32
+RecoverFromJournal(char* Path, game_room_pool** Pools, u32 PoolCount, memory_arena* TempArena, log_ring* LogRing)
+{
+	u32 NextGameID = 1;
+
+	FILE* File = fopen(Path, "rb");
+	if(!File)
+	{
+		// NOTE(hugo) : First start, nothing to recover.
+		if(!WriteJournalSnapshot(Path, Pools, PoolCount))
+		{
+			printf("Cannot write the journal %s.\n", Path);
+			InvalidCodePath;
+		}
+		return(NextGameID);
+	}
+
+	journal_header Header = {};
+	size_t HeaderRead = fread(&Header, sizeof(Header), 1, File);
+	if((HeaderRead != 1) || (Header.Magic != JOURNAL_MAGIC) || (Header.Version != JOURNAL_VERSION))
+	{
+		printf("%s is not a valid synchess journal, refusing to overwrite it.\n", Path);
+		InvalidCodePath;
+	}
+
+	u64 StartCounter = SDL_GetPerformanceCounter();
+	temporary_memory RecoveryTempMemory = BeginTemporaryMemory(TempArena);
+
+	u32 TotalRoomCount = 0;
+	for(u32 PoolIndex = 0; PoolIndex < PoolCount; ++PoolIndex)
+	{
+		TotalRoomCount += Pools[PoolIndex]->RoomCount;
+	}
+	u32 SlotCount = 1;
+	while(SlotCount < 2 * TotalRoomCount)
+	{
+		SlotCount *= 2;
+	}
+	journal_game_slot* Slots = PushArray(TempArena, SlotCount, journal_game_slot);
+	memset(Slots, 0, SlotCount * sizeof(journal_game_slot));
+
+	u32 ChunkRecordCount = JOURNAL_BUFFER_SIZE / sizeof(journal_record);
+	journal_record* Chunk = PushArray(TempArena, ChunkRecordCount, journal_record);
+
+	u64 ReplayedRecordCount = 0;
+	u32 DroppedGameCount = 0;
+	bool IsTruncated = false;
+	size_t ReadRecordCount = 0;
+	// NOTE(hugo) : A record torn by a crash is shorter than sizeof(journal_record)
+	// so fread does not count it and it is dropped with the rewrite below.
+	while(!IsTruncated &&
+			((ReadRecordCount = fread(Chunk, sizeof(journal_record), ChunkRecordCount, File)) > 0))
+	{
+		for(u32 RecordIndex = 0; RecordIndex < ReadRecordCount; ++RecordIndex)
+		{
+			journal_record* Record = Chunk + RecordIndex;
+
+			// NOTE(hugo) : A tail zeroed or garbled by a crash still reads as
+			// whole records. The replay stops at the first one that cannot be
+			// right, and the rewrite drops it with all that follows, as it does
+			// for a torn record.
+			bool IsRecordValid = (Record->GameID != 0) && ((u32)Record->Type < JournalRecord_Count);
+			journal_game_slot* Slot = 0;
+			if(IsRecordValid)
+			{
+				Slot = FindJournalGameSlot(Slots, SlotCount, Record->GameID);
+				IsRecordValid = !((Record->Type == JournalRecord_GameCreated) && Slot->GameID);
+			}
+			if(!IsRecordValid)
+			{
+				LogEvent(LogRing, LogEvent_JournalTruncated,
+						(u32)ReplayedRecordCount, (u32)Record->Type, Record->GameID);
+				IsTruncated = true;
+				break;
+			}
+
+			if(Record->GameID >= NextGameID)
+			{
+				NextGameID = Record->GameID + 1;
+			}
+
+			switch(Record->Type)
+			{
+				case JournalRecord_GameCreated:
+					{
+						game_room* Room = AcquireRoom(Pools[GetGamePoolIndex(Record->GameID, PoolCount)]);
+						if(Room)
+						{
+							Room->GameID = Record->GameID;
+							Room->HasStarted = true;
+							// NOTE(hugo) : The clock starts again once both players are back,
+							// with the time each one had after its last move.
+							time_control TimeControl = Record->GameCreated.TimeControl;
+							Room->Clock.TimeControl = TimeControl;
+							Room->Clock.RemainingMS[PieceColor_White] = TimeControl.BaseMS;
+							Room->Clock.RemainingMS[PieceColor_Black] = TimeControl.BaseMS;
+							Room->ReconnectTokens[PieceColor_White] = Record->GameCreated.ReconnectTokens[PieceColor_White];
+							Room->ReconnectTokens[PieceColor_Black] = Record->GameCreated.ReconnectTokens[PieceColor_Black];
+							Slot->GameID = Record->GameID;
+							Slot->Room = Room;
+						}
+						else
+						{
+							++DroppedGameCount;
+						}
+					} break;
+				case JournalRecord_Move:
+					{
+						if(Slot->Room)
+						{
+							game_room* Room = Slot->Room;
+							Room->Clock.RemainingMS[Room->ChessContext.PlayerToPlay] = Record->Move.RemainingMS;
+							ReplayMove(&Room->ChessContext, Record->Move.Move, &Room->Arena);
+							PushMoveHistory(Room, Record->Move.Move);
+						}
+					} break;
+				case JournalRecord_GameEnded:
+					{
+						if(Slot->Room)
+						{
+							ReleaseRoom(Pools[GetGamePoolIndex(Record->GameID, PoolCount)], Slot->Room);
+							DeleteJournalGameSlot(Slots, SlotCount, Slot);
+						}
+					} break;
+				InvalidDefaultCase;
+			}
+			++ReplayedRecordCount;
+		}
+	}
+	// NOTE(hugo) : Whether the journal ends right after the last record
+	// replayed, with no torn or invalid record behind it.
+	bool IsTailClean = ((u64)ftell(File) == sizeof(Header) + ReplayedRecordCount * sizeof(journal_record));
+	fclose(File);
+
+	// NOTE(hugo) : The replay did not adjudicate anything,
+	// only the final position of each game needs it.
+	u32 RecoveredGameCount = 0;
+	for(u32 PoolIndex = 0; PoolIndex < PoolCount; ++PoolIndex)
+	{
+		game_room_pool* Pool = Pools[PoolIndex];
+		for(u32 RoomIndex = 0; RoomIndex < Pool->RoomCount; ++RoomIndex)
+		{
+			game_room* Room = Pool->Rooms + RoomIndex;
+			if(Room->IsActive)
+			{
+				Room->ChessContext.PlayerCheck = SearchForKingCheck(&Room->ChessContext, &Room->Arena);
+				++RecoveredGameCount;
+			}
+		}
+	}
+
+	EndTemporaryMemory(RecoveryTempMemory);
+
+	if(!WriteJournalSnapshot(Path, Pools, PoolCount))
+	{
+		// NOTE(hugo) : The old journal still has every recovered game, the
+		// new records can go after it as long as it ends on a whole record.
+		LogEvent(LogRing, LogEvent_JournalSnapshotFailed, RecoveredGameCount);
+		if(!IsTailClean)
+		{
+			printf("Cannot rewrite the journal %s without its invalid end.\n", Path);
+			InvalidCodePath;
+		}
+	}
+
+	float RecoverySeconds = (float)(SDL_GetPerformanceCounter() - StartCounter) / (float)SDL_GetPerformanceFrequency();
+	printf("Journal replayed : %llu records, %u games recovered, %u dropped, in %.3fs.\n",
+			(unsigned long long)ReplayedRecordCount, RecoveredGameCount, DroppedGameCount, RecoverySeconds);
+
+	return(NextGameID);
+}
+//
+// }
+//
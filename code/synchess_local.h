@@ -0,0 +1,451 @@
+#pragma once
+
+// NOTE(hugo) : Local transport, for the bots and engines that run on the
+// game host itself. The bytes of a connexion go through two
+// single-producer single-consumer rings in a memory segment that both
+// processes map, so a message costs a copy and a couple of atomics
+// instead of two trips through the kernel network stack. What goes
+// through the rings is the very same stream of messages as over TCP,
+// only the pipe changes.
+//
+// The connexion starts on a Unix-domain socket. The server answers with
+// the segment, as a file descriptor (SCM_RIGHTS), and the socket then
+// stays open as a doorbell : a side that is about to sleep in poll says
+// so in its inbound ring, and only then does the other side write a byte
+// on the socket after filling the ring. Two busy sides never make a
+// system call for a message, and the socket still tells each side when
+// its peer is gone.
+//
+// POSIX only. On Windows the server does not listen locally and the
+// bots cannot connect locally.
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/un.h>
+#endif
+
+#define SYNCHESS_LOCAL_PATH "/tmp/synchess.sock"
+#define LOCAL_SEGMENT_MAGIC 0x4C435953 // NOTE(hugo) : 'SYCL'
+#define LOCAL_SEGMENT_VERSION 1
+// NOTE(hugo) : In bytes, must be a power of two. About 550 messages.
+#define LOCAL_RING_SIZE Kilobytes(64)
+#define CACHE_LINE_SIZE 64
+
+struct local_ring
+{
+	// NOTE(hugo) : Each written by one side only, and on its own cache
+	// line so that the two sides do not fight over it.
+	SDL_atomic_t WritePosition;
+	u8 WritePositionPad[CACHE_LINE_SIZE - sizeof(SDL_atomic_t)];
+	SDL_atomic_t ReadPosition;
+	u8 ReadPositionPad[CACHE_LINE_SIZE - sizeof(SDL_atomic_t)];
+	// NOTE(hugo) : Set by the reader before it sleeps in poll, cleared
+	// by whoever wakes it up.
+	SDL_atomic_t IsReaderWaiting;
+	u8 IsReaderWaitingPad[CACHE_LINE_SIZE - sizeof(SDL_atomic_t)];
+
+	u8 Bytes[LOCAL_RING_SIZE];
+};
+
+// NOTE(hugo) : What both processes map.
+struct local_segment
+{
+	u32 Magic;
+	u32 Version;
+	u32 RingSize;
+	u8 HeaderPad[CACHE_LINE_SIZE - 3 * sizeof(u32)];
+
+	local_ring ToServer;
+	local_ring ToClient;
+};
+
+// NOTE(hugo) : One side's view of the segment. All zero for a TCP connexion.
+struct local_channel
+{
+	local_segment* Segment;
+	local_ring* Inbound;
+	local_ring* Outbound;
+};
+
+internal bool
+IsLocalChannel(local_channel* Channel)
+{
+	bool Result = (Channel->Segment != 0);
+	return(Result);
+}
+
+internal void
+CopyToLocalRing(local_ring* Ring, u32 Position, void* Data, u32 Size)
+{
+	u32 FirstIndex = Position & (LOCAL_RING_SIZE - 1);
+	u32 FirstSize = (FirstIndex + Size > LOCAL_RING_SIZE) ? (LOCAL_RING_SIZE - FirstIndex) : Size;
+	memcpy(Ring->Bytes + FirstIndex, Data, FirstSize);
+	memcpy(Ring->Bytes, (u8*)Data + FirstSize, Size - FirstSize);
+}
+
+internal void
+CopyFromLocalRing(local_ring* Ring, u32 Position, void* Data, u32 Size)
+{
+	u32 FirstIndex = Position & (LOCAL_RING_SIZE - 1);
+	u32 FirstSize = (FirstIndex + Size > LOCAL_RING_SIZE) ? (LOCAL_RING_SIZE - FirstIndex) : Size;
+	memcpy(Data, Ring->Bytes + FirstIndex, FirstSize);
+	memcpy((u8*)Data + FirstSize, Ring->Bytes, Size - FirstSize);
+}
+
+// NOTE(hugo) : Writer side only. Takes as much of the slices as fits,
+// like a send on a non-blocking socket, and returns how much it took.
+internal u32
+WriteLocalRing(local_ring* Ring, send_slice* Slices, u32 SliceCount)
+{
+	u32 WritePosition = (u32)SDL_AtomicGet(&Ring->WritePosition);
+	u32 ReadPosition = (u32)SDL_AtomicGet(&Ring->ReadPosition);
+	// NOTE(hugo) : The reader is done with everything before ReadPosition.
+	SDL_MemoryBarrierAcquire();
+	u32 FreeSize = LOCAL_RING_SIZE - (WritePosition - ReadPosition);
+
+	u32 Result = 0;
+	for(u32 SliceIndex = 0; (SliceIndex < SliceCount) && (Result < FreeSize); ++SliceIndex)
+	{
+		u32 Size = Slices[SliceIndex].Size;
+		if(Size > FreeSize - Result)
+		{
+			Size = FreeSize - Result;
+		}
+		CopyToLocalRing(Ring, WritePosition + Result, Slices[SliceIndex].Data, Size);
+		Result += Size;
+	}
+
+	if(Result > 0)
+	{
+		// NOTE(hugo) : An atomic add is a full barrier : the bytes are
+		// visible before the new position, and the position is visible
+		// before we look at IsReaderWaiting.
+		SDL_AtomicAdd(&Ring->WritePosition, (s32)Result);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Reader side only. Returns how many bytes it read, 0 if the ring is empty.
+internal u32
+ReadLocalRing(local_ring* Ring, void* Buffer, u32 Size)
+{
+	u32 ReadPosition = (u32)SDL_AtomicGet(&Ring->ReadPosition);
+	u32 WritePosition = (u32)SDL_AtomicGet(&Ring->WritePosition);
+	SDL_MemoryBarrierAcquire();
+
+	u32 Result = WritePosition - ReadPosition;
+	if(Result > Size)
+	{
+		Result = Size;
+	}
+	if(Result > 0)
+	{
+		CopyFromLocalRing(Ring, ReadPosition, Buffer, Result);
+		// NOTE(hugo) : The bytes must be copied out before the writer may reuse them.
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&Ring->ReadPosition, (s32)(ReadPosition + Result));
+	}
+
+	return(Result);
+}
+
+internal bool
+HasLocalInbound(local_channel* Channel)
+{
+	local_ring* Ring = Channel->Inbound;
+	bool Result = (SDL_AtomicGet(&Ring->WritePosition) != SDL_AtomicGet(&Ring->ReadPosition));
+	return(Result);
+}
+
+// NOTE(hugo) : Before sleeping in poll on the doorbell. Returns false if
+// something came in meanwhile, then the caller must not sleep.
+internal bool
+PrepareLocalWait(local_channel* Channel)
+{
+	// NOTE(hugo) : The CAS is a full barrier, so the writer either sees
+	// the flag or we see its bytes.
+	SDL_AtomicCAS(&Channel->Inbound->IsReaderWaiting, 0, 1);
+	bool Result = !HasLocalInbound(Channel);
+	return(Result);
+}
+
+internal void
+EndLocalWait(local_channel* Channel)
+{
+	SDL_AtomicSet(&Channel->Inbound->IsReaderWaiting, 0);
+}
+
+// NOTE(hugo) : Same contract as ReceiveFromSocket.
+internal s32
+ReceiveFromLocalChannel(platform_socket Socket, local_channel* Channel, void* Buffer, u32 Size)
+{
+	// NOTE(hugo) : The doorbell bytes only woke us up, but the socket
+	// is also how we learn that the peer is gone.
+	s32 SocketResult = SOCKET_WOULD_BLOCK;
+	u8 Doorbell[64];
+	do
+	{
+		SocketResult = ReceiveFromSocket(Socket, Doorbell, sizeof(Doorbell));
+	} while(SocketResult > 0);
+
+	// NOTE(hugo) : What the peer wrote before leaving is still read.
+	s32 Result = (s32)ReadLocalRing(Channel->Inbound, Buffer, Size);
+	if(Result == 0)
+	{
+		Result = SocketResult;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Same contract as SendSlices.
+internal s32
+SendSlicesToLocalChannel(platform_socket Socket, local_channel* Channel, send_slice* Slices, u32 SliceCount)
+{
+	local_ring* Ring = Channel->Outbound;
+	s32 Result = (s32)WriteLocalRing(Ring, Slices, SliceCount);
+	if((Result > 0) && SDL_AtomicGet(&Ring->IsReaderWaiting) &&
+			SDL_AtomicCAS(&Ring->IsReaderWaiting, 1, 0))
+	{
+		SendWakeup(Socket);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : What the code that does not care about the transport calls.
+internal s32
+ReceiveFromPeer(platform_socket Socket, local_channel* Channel, void* Buffer, u32 Size)
+{
+	s32 Result = IsLocalChannel(Channel) ?
+		ReceiveFromLocalChannel(Socket, Channel, Buffer, Size) :
+		ReceiveFromSocket(Socket, Buffer, Size);
+	return(Result);
+}
+
+internal s32
+SendSlicesToPeer(platform_socket Socket, local_channel* Channel, send_slice* Slices, u32 SliceCount)
+{
+	s32 Result = IsLocalChannel(Channel) ?
+		SendSlicesToLocalChannel(Socket, Channel, Slices, SliceCount) :
+		SendSlices(Socket, Slices, SliceCount);
+	return(Result);
+}
+
+internal void
+CloseLocalChannel(local_channel* Channel)
+{
+#ifndef _WIN32
+	if(Channel->Segment)
+	{
+		munmap(Channel->Segment, sizeof(local_segment));
+	}
+#endif
+	*Channel = {};
+}
+
+internal void
+ClosePeer(platform_socket Socket, local_channel* Channel)
+{
+	CloseSocket(Socket);
+	CloseLocalChannel(Channel);
+}
+
+#ifndef _WIN32
+internal void
+MapLocalChannel(local_channel* Channel, local_segment* Segment, bool IsServer)
+{
+	Channel->Segment = Segment;
+	Channel->Inbound = IsServer ? &Segment->ToServer : &Segment->ToClient;
+	Channel->Outbound = IsServer ? &Segment->ToClient : &Segment->ToServer;
+}
+
+// NOTE(hugo) : Returns INVALID_PLATFORM_SOCKET if the path cannot be bound.
+internal platform_socket
+OpenLocalListenSocket(char* Path)
+{
+	platform_socket Result = INVALID_PLATFORM_SOCKET;
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	if(strlen(Path) < sizeof(Address.sun_path))
+	{
+		strcpy(Address.sun_path, Path);
+		// NOTE(hugo) : Left behind by a server that did not stop cleanly.
+		unlink(Path);
+
+		platform_socket Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+		if((Socket != INVALID_PLATFORM_SOCKET) &&
+				(bind(Socket, (sockaddr*)&Address, sizeof(Address)) == 0) &&
+				(listen(Socket, SOMAXCONN) == 0))
+		{
+			Result = Socket;
+		}
+		else if(Socket != INVALID_PLATFORM_SOCKET)
+		{
+			CloseSocket(Socket);
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Creates the segment of a new connexion and sends it to the
+// client. Returns INVALID_PLATFORM_SOCKET if any of it fails, then the
+// connexion is closed.
+internal platform_socket
+AcceptLocalConnection(platform_socket ListenSocket, local_channel* Channel)
+{
+	platform_socket Socket = accept(ListenSocket, 0, 0);
+	if(Socket == INVALID_PLATFORM_SOCKET)
+	{
+		return(Socket);
+	}
+
+#ifdef __linux__
+	s32 SegmentFile = memfd_create("synchess-local", MFD_CLOEXEC);
+#else
+	// NOTE(hugo) : A name only lives the time of the open.
+	char SegmentName[64];
+	snprintf(SegmentName, sizeof(SegmentName), "/synchess-%d-%d", (s32)getpid(), (s32)Socket);
+	s32 SegmentFile = shm_open(SegmentName, O_RDWR | O_CREAT | O_EXCL, 0600);
+	shm_unlink(SegmentName);
+#endif
+
+	local_segment* Segment = 0;
+	if((SegmentFile != -1) && (ftruncate(SegmentFile, sizeof(local_segment)) == 0))
+	{
+		void* Mapping = mmap(0, sizeof(local_segment), PROT_READ | PROT_WRITE, MAP_SHARED, SegmentFile, 0);
+		if(Mapping != MAP_FAILED)
+		{
+			// NOTE(hugo) : Fresh pages are zero, so are the rings.
+			Segment = (local_segment*)Mapping;
+			Segment->Magic = LOCAL_SEGMENT_MAGIC;
+			Segment->Version = LOCAL_SEGMENT_VERSION;
+			Segment->RingSize = LOCAL_RING_SIZE;
+		}
+	}
+
+	bool IsSent = false;
+	if(Segment)
+	{
+		u8 Byte = 0;
+		iovec Buffer = {&Byte, 1};
+		u8 Control[CMSG_SPACE(sizeof(s32))] = {};
+		msghdr Message = {};
+		Message.msg_iov = &Buffer;
+		Message.msg_iovlen = 1;
+		Message.msg_control = Control;
+		Message.msg_controllen = sizeof(Control);
+		cmsghdr* ControlMessage = CMSG_FIRSTHDR(&Message);
+		ControlMessage->cmsg_level = SOL_SOCKET;
+		ControlMessage->cmsg_type = SCM_RIGHTS;
+		ControlMessage->cmsg_len = CMSG_LEN(sizeof(s32));
+		memcpy(CMSG_DATA(ControlMessage), &SegmentFile, sizeof(s32));
+		IsSent = (sendmsg(Socket, &Message, 0) == 1);
+	}
+	if(SegmentFile != -1)
+	{
+		// NOTE(hugo) : The mappings keep the segment alive.
+		close(SegmentFile);
+	}
+
+	if(IsSent)
+	{
+		MapLocalChannel(Channel, Segment, true);
+	}
+	else
+	{
+		if(Segment)
+		{
+			munmap(Segment, sizeof(local_segment));
+		}
+		CloseSocket(Socket);
+		Socket = INVALID_PLATFORM_SOCKET;
+	}
+
+	return(Socket);
+}
+
+// NOTE(hugo) : Client side. Returns INVALID_PLATFORM_SOCKET if the server
+// does not listen locally at Path.
+internal platform_socket
+OpenLocalConnection(char* Path, local_channel* Channel)
+{
+	platform_socket Result = INVALID_PLATFORM_SOCKET;
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	if(strlen(Path) >= sizeof(Address.sun_path))
+	{
+		return(Result);
+	}
+	strcpy(Address.sun_path, Path);
+
+	platform_socket Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if((Socket != INVALID_PLATFORM_SOCKET) &&
+			(connect(Socket, (sockaddr*)&Address, sizeof(Address)) == 0))
+	{
+		u8 Byte = 0;
+		iovec Buffer = {&Byte, 1};
+		u8 Control[CMSG_SPACE(sizeof(s32))] = {};
+		msghdr Message = {};
+		Message.msg_iov = &Buffer;
+		Message.msg_iovlen = 1;
+		Message.msg_control = Control;
+		Message.msg_controllen = sizeof(Control);
+
+		cmsghdr* ControlMessage = 0;
+		if(recvmsg(Socket, &Message, 0) == 1)
+		{
+			ControlMessage = CMSG_FIRSTHDR(&Message);
+		}
+		if(ControlMessage && (ControlMessage->cmsg_level == SOL_SOCKET) &&
+				(ControlMessage->cmsg_type == SCM_RIGHTS))
+		{
+			s32 SegmentFile = -1;
+			memcpy(&SegmentFile, CMSG_DATA(ControlMessage), sizeof(s32));
+			void* Mapping = mmap(0, sizeof(local_segment), PROT_READ | PROT_WRITE, MAP_SHARED, SegmentFile, 0);
+			close(SegmentFile);
+
+			if(Mapping != MAP_FAILED)
+			{
+				local_segment* Segment = (local_segment*)Mapping;
+				if((Segment->Magic == LOCAL_SEGMENT_MAGIC) && (Segment->Version == LOCAL_SEGMENT_VERSION) &&
+						(Segment->RingSize == LOCAL_RING_SIZE))
+				{
+					MapLocalChannel(Channel, Segment, false);
+					Result = Socket;
+				}
+				else
+				{
+					munmap(Mapping, sizeof(local_segment));
+				}
+			}
+		}
+	}
+	if((Result == INVALID_PLATFORM_SOCKET) && (Socket != INVALID_PLATFORM_SOCKET))
+	{
+		CloseSocket(Socket);
+	}
+
+	return(Result);
+}
+#else
+internal platform_socket
+OpenLocalListenSocket(char* Path)
+{
+	return(INVALID_PLATFORM_SOCKET);
+}
+
+internal platform_socket
+AcceptLocalConnection(platform_socket ListenSocket, local_channel* Channel)
+{
+	return(INVALID_PLATFORM_SOCKET);
+}
+
+internal platform_socket
+OpenLocalConnection(char* Path, local_channel* Channel)
+{
+	return(INVALID_PLATFORM_SOCKET);
+}
+#endif
@@ -0,0 +1,305 @@
+#pragma once
+
+// NOTE(hugo) : Binary event log, to leave on in production in place of
+// printf. Every thread that logs owns a ring of fixed-size records
+// (timestamp, event type, a few integer arguments) that only it writes
+// and only the drain thread reads, so logging an event is a copy and a
+// release store : no lock, no formatting, no system call. The drain
+// thread writes the rings to the file as they are, a few times per
+// second, and synchess_logdump turns the file back into text.
+//
+// A thread that logs faster than the drain keeps up loses the newest
+// records, never waits. The drain writes how many were lost in the file.
+
+#define SYNCHESS_EVENT_LOG_PATH "synchess.events"
+#define EVENT_LOG_MAGIC 0x4C455953 // NOTE(hugo) : 'SYEL'
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_MAX_RING_COUNT 72
+// NOTE(hugo) : In records, must be a power of two.
+#define EVENT_LOG_RING_SIZE 4096
+#define EVENT_LOG_DRAIN_PERIOD_MS 50
+#define EVENT_LOG_ARGUMENT_COUNT 5
+#define EVENT_LOG_RING_NAME_SIZE 32
+
+enum log_event_type
+{
+	// NOTE(hugo) : Written by the drain, Arguments[0] records were lost.
+	LogEvent_RecordsDropped,
+
+	// NOTE(hugo) : Server
+	LogEvent_ClientConnected,
+	LogEvent_SlowConsumer,
+	LogEvent_GameStarted,
+	LogEvent_GameEnded,
+	LogEvent_FlagFell,
+	LogEvent_RoomReleased,
+	LogEvent_PlayersMatched,
+	LogEvent_PlayerLeft,
+	LogEvent_PlayerResumed,
+	LogEvent_GameAbandoned,
+	LogEvent_JournalTruncated,
+	LogEvent_JournalSnapshotFailed,
+
+	// NOTE(hugo) : Client
+	LogEvent_ConnectionEstablished,
+	LogEvent_Quit,
+	LogEvent_NoRoomForClient,
+	LogEvent_ClockUpdate,
+	LogEvent_JoinedGame,
+	LogEvent_LostOnTime,
+	LogEvent_ConnectionLost,
+	LogEvent_GameResumed,
+	LogEvent_MoveRolledBack,
+	LogEvent_GameOver,
+	LogEvent_TextureCacheStats,
+	LogEvent_TraceExported,
+
+	LogEvent_Count,
+};
+
+// NOTE(hugo) : What the decoder needs to print a record. The names of
+// the unused arguments are 0.
+struct log_event_info
+{
+	char* Name;
+	char* ArgumentNames[EVENT_LOG_ARGUMENT_COUNT];
+};
+
+global_variable log_event_info LogEventInfos[LogEvent_Count] =
+{
+	{"records_dropped", {"count"}},
+
+	{"client_connected", {"client"}},
+	{"slow_consumer", {"client", "pending"}},
+	{"game_started", {"game", "room"}},
+	{"game_ended", {"game", "result"}},
+	{"flag_fell", {"game", "color"}},
+	{"room_released", {"room", "arena_used", "active_rooms", "high_water_rooms", "high_water_arena"}},
+	{"players_matched", {"rating_a", "rating_b", "wait_ms_a", "wait_ms_b", "shard"}},
+	{"player_left", {"game", "color"}},
+	{"player_resumed", {"game", "color", "tail_moves", "snapshot"}},
+	{"game_abandoned", {"game", "missing_color"}},
+	{"journal_truncated", {"record", "type", "game"}},
+	{"journal_snapshot_failed", {"games"}},
+
+	{"connection_established", {"color"}},
+	{"quit", {}},
+	{"no_room_for_client", {"game"}},
+	{"clock_update", {"white_ms", "black_ms", "to_play"}},
+	{"joined_game", {"game"}},
+	{"lost_on_time", {"color"}},
+	{"connection_lost", {"game"}},
+	{"game_resumed", {"game", "sequence", "tail_moves", "snapshot"}},
+	{"move_rolled_back", {"sequence", "server_sequence"}},
+	{"game_over", {"game", "result"}},
+	{"texture_cache_stats", {"hits", "misses", "evictions", "used_bytes", "budget_bytes"}},
+	{"trace_exported", {"written", "frames", "slowest_frames"}},
+};
+
+// NOTE(hugo) : 32 bytes, two records per cache line.
+struct log_record
+{
+	u64 Counter;
+	u16 Type;
+	u16 RingIndex;
+	u32 Arguments[EVENT_LOG_ARGUMENT_COUNT];
+};
+
+// NOTE(hugo) : Then RingCount ring names of EVENT_LOG_RING_NAME_SIZE
+// bytes, then records until the end of the file.
+struct event_log_header
+{
+	u32 Magic;
+	u32 Version;
+	u64 CounterFrequency;
+	// NOTE(hugo) : Counter when the log started, the records are timed from it.
+	u64 StartCounter;
+	u32 RingCount;
+	u32 RecordSize;
+};
+
+struct log_ring
+{
+	u16 RingIndex;
+	char Name[EVENT_LOG_RING_NAME_SIZE];
+	log_record* Records;
+
+	// NOTE(hugo) : Only touched by the thread that logs. The read
+	// position is cached so that the drain's cache line is only
+	// looked at when the ring seems full.
+	u32 WritePosition;
+	u32 CachedReadPosition;
+
+	SDL_atomic_t PublishedWritePosition;
+	SDL_atomic_t ReadPosition;
+	SDL_atomic_t DroppedCount;
+};
+
+struct event_log
+{
+	FILE* File;
+	SDL_Thread* Thread;
+	SDL_atomic_t IsRunning;
+
+	u64 StartCounter;
+	u32 RingCount;
+	log_ring Rings[EVENT_LOG_MAX_RING_COUNT];
+	// NOTE(hugo) : Only touched by the drain.
+	u32 ReportedDroppedCounts[EVENT_LOG_MAX_RING_COUNT];
+};
+
+// NOTE(hugo) : Must be called before StartEventLog, from the thread that starts it.
+internal log_ring*
+AddLogRing(event_log* EventLog, char* Name, memory_arena* Arena)
+{
+	Assert(EventLog->RingCount < ArrayCount(EventLog->Rings));
+	log_ring* Ring = EventLog->Rings + EventLog->RingCount;
+	Ring->RingIndex = (u16)EventLog->RingCount;
+	strncpy(Ring->Name, Name, sizeof(Ring->Name) - 1);
+	Ring->Name[sizeof(Ring->Name) - 1] = 0;
+	Ring->Records = PushArray(Arena, EVENT_LOG_RING_SIZE, log_record);
+	Ring->WritePosition = 0;
+	Ring->CachedReadPosition = 0;
+	SDL_AtomicSet(&Ring->PublishedWritePosition, 0);
+	SDL_AtomicSet(&Ring->ReadPosition, 0);
+	SDL_AtomicSet(&Ring->DroppedCount, 0);
+	EventLog->ReportedDroppedCounts[EventLog->RingCount] = 0;
+	++EventLog->RingCount;
+
+	return(Ring);
+}
+
+// NOTE(hugo) : Owner thread of the ring only. A null ring logs nothing.
+internal void
+LogEvent(log_ring* Ring, log_event_type Type,
+		u32 Argument0 = 0, u32 Argument1 = 0, u32 Argument2 = 0, u32 Argument3 = 0, u32 Argument4 = 0)
+{
+	if(Ring)
+	{
+		u32 WritePosition = Ring->WritePosition;
+		if(WritePosition - Ring->CachedReadPosition >= EVENT_LOG_RING_SIZE)
+		{
+			Ring->CachedReadPosition = (u32)SDL_AtomicGet(&Ring->ReadPosition);
+		}
+
+		if(WritePosition - Ring->CachedReadPosition < EVENT_LOG_RING_SIZE)
+		{
+			log_record* Record = Ring->Records + (WritePosition & (EVENT_LOG_RING_SIZE - 1));
+			Record->Counter = SDL_GetPerformanceCounter();
+			Record->Type = (u16)Type;
+			Record->RingIndex = Ring->RingIndex;
+			Record->Arguments[0] = Argument0;
+			Record->Arguments[1] = Argument1;
+			Record->Arguments[2] = Argument2;
+			Record->Arguments[3] = Argument3;
+			Record->Arguments[4] = Argument4;
+
+			// NOTE(hugo) : The record must be visible before the drain may read it.
+			SDL_MemoryBarrierRelease();
+			Ring->WritePosition = WritePosition + 1;
+			SDL_AtomicSet(&Ring->PublishedWritePosition, (s32)Ring->WritePosition);
+		}
+		else
+		{
+			SDL_AtomicAdd(&Ring->DroppedCount, 1);
+		}
+	}
+}
+
+// NOTE(hugo) : Writes everything the rings hold. Drain thread only.
+internal void
+DrainEventLog(event_log* EventLog)
+{
+	for(u32 RingIndex = 0; RingIndex < EventLog->RingCount; ++RingIndex)
+	{
+		log_ring* Ring = EventLog->Rings + RingIndex;
+		u32 ReadPosition = (u32)SDL_AtomicGet(&Ring->ReadPosition);
+		u32 WritePosition = (u32)SDL_AtomicGet(&Ring->PublishedWritePosition);
+		SDL_MemoryBarrierAcquire();
+
+		// NOTE(hugo) : At most two writes, before and after the wrap.
+		while(ReadPosition != WritePosition)
+		{
+			u32 FirstIndex = ReadPosition & (EVENT_LOG_RING_SIZE - 1);
+			u32 Count = WritePosition - ReadPosition;
+			if(FirstIndex + Count > EVENT_LOG_RING_SIZE)
+			{
+				Count = EVENT_LOG_RING_SIZE - FirstIndex;
+			}
+			fwrite(Ring->Records + FirstIndex, sizeof(log_record), Count, EventLog->File);
+			ReadPosition += Count;
+		}
+		SDL_AtomicSet(&Ring->ReadPosition, (s32)ReadPosition);
+
+		u32 DroppedCount = (u32)SDL_AtomicGet(&Ring->DroppedCount);
+		if(DroppedCount != EventLog->ReportedDroppedCounts[RingIndex])
+		{
+			log_record Record = {};
+			Record.Counter = SDL_GetPerformanceCounter();
+			Record.Type = LogEvent_RecordsDropped;
+			Record.RingIndex = (u16)RingIndex;
+			Record.Arguments[0] = DroppedCount - EventLog->ReportedDroppedCounts[RingIndex];
+			fwrite(&Record, sizeof(Record), 1, EventLog->File);
+			EventLog->ReportedDroppedCounts[RingIndex] = DroppedCount;
+		}
+	}
+	fflush(EventLog->File);
+}
+
+internal s32
+EventLogDrainThread(void* Data)
+{
+	event_log* EventLog = (event_log*)Data;
+	while(SDL_AtomicGet(&EventLog->IsRunning))
+	{
+		SDL_Delay(EVENT_LOG_DRAIN_PERIOD_MS);
+		DrainEventLog(EventLog);
+	}
+	// NOTE(hugo) : What was logged before the stop.
+	DrainEventLog(EventLog);
+
+	return(0);
+}
+
+// NOTE(hugo) : Returns false if the file cannot be opened, then nothing is logged.
+internal bool
+StartEventLog(event_log* EventLog, char* Path)
+{
+	EventLog->File = fopen(Path, "wb");
+	bool Result = (EventLog->File != 0);
+	if(Result)
+	{
+		EventLog->StartCounter = SDL_GetPerformanceCounter();
+
+		event_log_header Header = {};
+		Header.Magic = EVENT_LOG_MAGIC;
+		Header.Version = EVENT_LOG_VERSION;
+		Header.CounterFrequency = SDL_GetPerformanceFrequency();
+		Header.StartCounter = EventLog->StartCounter;
+		Header.RingCount = EventLog->RingCount;
+		Header.RecordSize = sizeof(log_record);
+		fwrite(&Header, sizeof(Header), 1, EventLog->File);
+		for(u32 RingIndex = 0; RingIndex < EventLog->RingCount; ++RingIndex)
+		{
+			fwrite(EventLog->Rings[RingIndex].Name, EVENT_LOG_RING_NAME_SIZE, 1, EventLog->File);
+		}
+
+		SDL_AtomicSet(&EventLog->IsRunning, 1);
+		EventLog->Thread = SDL_CreateThread(EventLogDrainThread, "EventLogDrain", EventLog);
+		Assert(EventLog->Thread);
+	}
+
+	return(Result);
+}
+
+internal void
+StopEventLog(event_log* EventLog)
+{
+	if(EventLog->File)
+	{
+		SDL_AtomicSet(&EventLog->IsRunning, 0);
+		SDL_WaitThread(EventLog->Thread, 0);
+		fclose(EventLog->File);
+		EventLog->File = 0;
+	}
+}
@@ -0,0 +1,137 @@
+#ifdef _WIN32
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+// NOTE(hugo) : Offline decoder of the binary event logs written by the
+// server and the client (see synchess_log.h). Prints one line per
+// record, every ring merged in time order :
+//
+//   12.345678 shard-0 game_started game=4 room=1
+//
+// Usage : logdump [file] [-event name] [-ring name]
+
+#include <rivten.h>
+#include <rivten_math.h>
+
+#include "synchess_log.h"
+
+internal s32
+CompareLogRecords(const void* A, const void* B)
+{
+	log_record* RecordA = (log_record*)A;
+	log_record* RecordB = (log_record*)B;
+	s32 Result = 0;
+	if(RecordA->Counter != RecordB->Counter)
+	{
+		Result = (RecordA->Counter < RecordB->Counter) ? -1 : 1;
+	}
+	else if(RecordA->RingIndex != RecordB->RingIndex)
+	{
+		Result = (RecordA->RingIndex < RecordB->RingIndex) ? -1 : 1;
+	}
+
+	return(Result);
+}
+
+s32 main(s32 ArgumentCount, char** Arguments)
+{
+	char* Path = SYNCHESS_EVENT_LOG_PATH;
+	char* EventFilter = 0;
+	char* RingFilter = 0;
+	for(s32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+	{
+		char* Argument = Arguments[ArgumentIndex];
+		bool HasValue = (ArgumentIndex + 1 < ArgumentCount);
+		if((strcmp(Argument, "-event") == 0) && HasValue)
+		{
+			EventFilter = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Argument, "-ring") == 0) && HasValue)
+		{
+			RingFilter = Arguments[++ArgumentIndex];
+		}
+		else
+		{
+			Path = Argument;
+		}
+	}
+
+	FILE* File = fopen(Path, "rb");
+	if(!File)
+	{
+		fprintf(stderr, "Cannot open %s.\n", Path);
+		return(1);
+	}
+
+	event_log_header Header = {};
+	size_t HeaderRead = fread(&Header, sizeof(Header), 1, File);
+	if((HeaderRead != 1) || (Header.Magic != EVENT_LOG_MAGIC) ||
+			(Header.Version != EVENT_LOG_VERSION) || (Header.RecordSize != sizeof(log_record)) ||
+			(Header.RingCount > EVENT_LOG_MAX_RING_COUNT) || (Header.CounterFrequency == 0))
+	{
+		fprintf(stderr, "%s is not an event log of this version.\n", Path);
+		fclose(File);
+		return(1);
+	}
+
+	char RingNames[EVENT_LOG_MAX_RING_COUNT][EVENT_LOG_RING_NAME_SIZE] = {};
+	for(u32 RingIndex = 0; RingIndex < Header.RingCount; ++RingIndex)
+	{
+		size_t NameRead = fread(RingNames[RingIndex], EVENT_LOG_RING_NAME_SIZE, 1, File);
+		Assert(NameRead == 1);
+		RingNames[RingIndex][EVENT_LOG_RING_NAME_SIZE - 1] = 0;
+	}
+
+	// NOTE(hugo) : The rings are drained one after the other, so the
+	// records of the file are only sorted ring by ring.
+	long RecordStart = ftell(File);
+	fseek(File, 0, SEEK_END);
+	long FileSize = ftell(File);
+	fseek(File, RecordStart, SEEK_SET);
+	u32 RecordCount = (u32)((FileSize - RecordStart) / sizeof(log_record));
+	log_record* Records = (log_record*)Allocate_((u64)RecordCount * sizeof(log_record) + 1);
+	Assert(Records);
+	RecordCount = (u32)fread(Records, sizeof(log_record), RecordCount, File);
+	fclose(File);
+
+	qsort(Records, RecordCount, sizeof(log_record), CompareLogRecords);
+
+	u64 DroppedCount = 0;
+	for(u32 RecordIndex = 0; RecordIndex < RecordCount; ++RecordIndex)
+	{
+		log_record* Record = Records + RecordIndex;
+		if((Record->Type >= LogEvent_Count) || (Record->RingIndex >= Header.RingCount))
+		{
+			continue;
+		}
+		if(Record->Type == LogEvent_RecordsDropped)
+		{
+			DroppedCount += Record->Arguments[0];
+		}
+
+		log_event_info* Info = LogEventInfos + Record->Type;
+		char* RingName = RingNames[Record->RingIndex];
+		if((EventFilter && (strcmp(EventFilter, Info->Name) != 0)) ||
+				(RingFilter && (strcmp(RingFilter, RingName) != 0)))
+		{
+			continue;
+		}
+
+		double Seconds = (double)(s64)(Record->Counter - Header.StartCounter) / (double)Header.CounterFrequency;
+		printf("%.6f %s %s", Seconds, RingName, Info->Name);
+		for(u32 ArgumentIndex = 0; ArgumentIndex < EVENT_LOG_ARGUMENT_COUNT; ++ArgumentIndex)
+		{
+			if(Info->ArgumentNames[ArgumentIndex])
+			{
+				printf(" %s=%u", Info->ArgumentNames[ArgumentIndex], Record->Arguments[ArgumentIndex]);
+			}
+		}
+		printf("\n");
+	}
+
+	fprintf(stderr, "%u records, %llu dropped.\n", RecordCount, (unsigned long long)DroppedCount);
+
+	return(0);
+}
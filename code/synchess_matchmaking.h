@@ -0,0 +1,231 @@
+#pragma once
+
+// NOTE(hugo) : Pairing of the players waiting for a game. The waiting
+// players are split in pools, one per time control, and each pool is
+// kept sorted by rating so that the closest opponents are neighbours.
+// A pass over a pool pairs neighbours whose ratings are close enough,
+// which makes the matching O(n) whatever the number of players.
+//
+// The window of acceptable ratings widens with the time spent waiting,
+// and after MATCHMAKING_MAX_WAIT_MS anyone on the same time control will
+// do, so the wait is bounded as soon as there is a second player.
+
+#define MATCHMAKING_MAX_POOL_COUNT 16
+#define MATCHMAKING_BASE_RATING_WINDOW 50
+// NOTE(hugo) : Rating points added to the window per second of waiting.
+#define MATCHMAKING_RATING_WINDOW_GROWTH 100
+#define MATCHMAKING_MAX_WAIT_MS 10000
+
+struct matchmaking_entry
+{
+	u32 Rating;
+	u64 EnqueueMS;
+	// NOTE(hugo) : Whatever the caller uses to find the player back.
+	u32 TicketIndex;
+};
+
+struct matchmaking_pool
+{
+	time_control TimeControl;
+	u32 EntryCount;
+	// NOTE(hugo) : Sorted by rating, then by arrival.
+	matchmaking_entry* Entries;
+};
+
+struct matchmaking_pair
+{
+	time_control TimeControl;
+	matchmaking_entry Entries[2];
+};
+
+struct matchmaker
+{
+	u32 MaxEntryCount;
+	u32 EntryCount;
+	matchmaking_pool Pools[MATCHMAKING_MAX_POOL_COUNT];
+};
+
+internal void
+InitialiseMatchmaker(matchmaker* Matchmaker, u32 MaxEntryCount, memory_arena* Arena)
+{
+	Matchmaker->MaxEntryCount = MaxEntryCount;
+	Matchmaker->EntryCount = 0;
+	for(u32 PoolIndex = 0; PoolIndex < ArrayCount(Matchmaker->Pools); ++PoolIndex)
+	{
+		matchmaking_pool* Pool = Matchmaker->Pools + PoolIndex;
+		Pool->TimeControl = {};
+		Pool->EntryCount = 0;
+		Pool->Entries = PushArray(Arena, MaxEntryCount, matchmaking_entry);
+	}
+}
+
+internal bool
+IsSameTimeControl(time_control A, time_control B)
+{
+	bool Result = (A.BaseMS == B.BaseMS) &&
+		(A.IncrementMS == B.IncrementMS) &&
+		(A.DelayMS == B.DelayMS);
+	return(Result);
+}
+
+// NOTE(hugo) : The pool of the time control, or an empty one to hold it.
+internal matchmaking_pool*
+FindMatchmakingPool(matchmaker* Matchmaker, time_control TimeControl)
+{
+	matchmaking_pool* Result = 0;
+	matchmaking_pool* FreePool = 0;
+	for(u32 PoolIndex = 0; (!Result) && (PoolIndex < ArrayCount(Matchmaker->Pools)); ++PoolIndex)
+	{
+		matchmaking_pool* Pool = Matchmaker->Pools + PoolIndex;
+		if(Pool->EntryCount == 0)
+		{
+			if(!FreePool)
+			{
+				FreePool = Pool;
+			}
+		}
+		else if(IsSameTimeControl(Pool->TimeControl, TimeControl))
+		{
+			Result = Pool;
+		}
+	}
+	if(!Result && FreePool)
+	{
+		Result = FreePool;
+		Result->TimeControl = TimeControl;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Returns false if there is no room left for the player.
+internal bool
+AddMatchmakingEntry(matchmaker* Matchmaker, time_control TimeControl, u32 Rating, u64 NowMS, u32 TicketIndex)
+{
+	bool Result = false;
+	matchmaking_pool* Pool = FindMatchmakingPool(Matchmaker, TimeControl);
+	if(Pool && (Matchmaker->EntryCount < Matchmaker->MaxEntryCount))
+	{
+		// NOTE(hugo) : Binary search of the first entry with a higher
+		// rating, so that equal ratings stay first come, first served.
+		u32 Low = 0;
+		u32 High = Pool->EntryCount;
+		while(Low < High)
+		{
+			u32 Middle = (Low + High) / 2;
+			if(Pool->Entries[Middle].Rating <= Rating)
+			{
+				Low = Middle + 1;
+			}
+			else
+			{
+				High = Middle;
+			}
+		}
+
+		memmove(Pool->Entries + Low + 1, Pool->Entries + Low,
+				(Pool->EntryCount - Low) * sizeof(matchmaking_entry));
+		matchmaking_entry* Entry = Pool->Entries + Low;
+		Entry->Rating = Rating;
+		Entry->EnqueueMS = NowMS;
+		Entry->TicketIndex = TicketIndex;
+		++Pool->EntryCount;
+		++Matchmaker->EntryCount;
+		Result = true;
+	}
+
+	return(Result);
+}
+
+internal bool
+RemoveMatchmakingEntry(matchmaker* Matchmaker, u32 TicketIndex)
+{
+	bool Result = false;
+	for(u32 PoolIndex = 0; (!Result) && (PoolIndex < ArrayCount(Matchmaker->Pools)); ++PoolIndex)
+	{
+		matchmaking_pool* Pool = Matchmaker->Pools + PoolIndex;
+		for(u32 EntryIndex = 0; (!Result) && (EntryIndex < Pool->EntryCount); ++EntryIndex)
+		{
+			if(Pool->Entries[EntryIndex].TicketIndex == TicketIndex)
+			{
+				--Pool->EntryCount;
+				--Matchmaker->EntryCount;
+				memmove(Pool->Entries + EntryIndex, Pool->Entries + EntryIndex + 1,
+						(Pool->EntryCount - EntryIndex) * sizeof(matchmaking_entry));
+				Result = true;
+			}
+		}
+	}
+
+	return(Result);
+}
+
+internal u32
+GetRatingWindow(matchmaking_entry* Entry, u64 NowMS)
+{
+	u64 WaitMS = (NowMS > Entry->EnqueueMS) ? (NowMS - Entry->EnqueueMS) : 0;
+	u32 Result = 0xFFFFFFFF;
+	if(WaitMS < MATCHMAKING_MAX_WAIT_MS)
+	{
+		Result = MATCHMAKING_BASE_RATING_WINDOW + (u32)((WaitMS * MATCHMAKING_RATING_WINDOW_GROWTH) / 1000);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Takes out of the pools every pair it can make, at most
+// MaxPairCount of them. Returns the number of pairs.
+internal u32
+FindMatchmakingPairs(matchmaker* Matchmaker, u64 NowMS, matchmaking_pair* Pairs, u32 MaxPairCount)
+{
+	u32 PairCount = 0;
+	for(u32 PoolIndex = 0; PoolIndex < ArrayCount(Matchmaker->Pools); ++PoolIndex)
+	{
+		matchmaking_pool* Pool = Matchmaker->Pools + PoolIndex;
+
+		// NOTE(hugo) : The pool is compacted as it goes, the entries
+		// left alone are written back at KeptCount.
+		u32 KeptCount = 0;
+		u32 EntryIndex = 0;
+		while(EntryIndex < Pool->EntryCount)
+		{
+			matchmaking_entry* Entry = Pool->Entries + EntryIndex;
+			matchmaking_entry* Next = Entry + 1;
+			bool IsPaired = false;
+			if((PairCount < MaxPairCount) && (EntryIndex + 1 < Pool->EntryCount))
+			{
+				// NOTE(hugo) : The most patient of the two decides, so that
+				// a player past the maximum wait takes whoever comes.
+				u32 Window = GetRatingWindow(Entry, NowMS);
+				u32 NextWindow = GetRatingWindow(Next, NowMS);
+				if(NextWindow > Window)
+				{
+					Window = NextWindow;
+				}
+				if(Next->Rating - Entry->Rating <= Window)
+				{
+					matchmaking_pair* Pair = Pairs + PairCount++;
+					Pair->TimeControl = Pool->TimeControl;
+					Pair->Entries[0] = *Entry;
+					Pair->Entries[1] = *Next;
+					IsPaired = true;
+				}
+			}
+
+			if(IsPaired)
+			{
+				EntryIndex += 2;
+			}
+			else
+			{
+				Pool->Entries[KeptCount++] = *Entry;
+				++EntryIndex;
+			}
+		}
+
+		Matchmaker->EntryCount -= Pool->EntryCount - KeptCount;
+		Pool->EntryCount = KeptCount;
+	}
+
+	return(PairCount);
+}
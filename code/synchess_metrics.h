@@ -0,0 +1,242 @@
+#pragma once
+
+// NOTE(hugo) : Counters, gauges and latency histograms of one server
+// thread. A thread only ever writes its own metrics, with plain
+// increments, and copies them under a lock a few times per second
+// (PublishMetrics) for the admin socket to read. So the hot path never
+// touches a cache line that another thread writes.
+//
+// The snapshot is text in the Prometheus exposition format, so that it
+// can be scraped as is or read with nc.
+
+#define METRICS_PUBLISH_PERIOD_MS 250
+
+enum server_counter
+{
+	ServerCounter_MessagesReceived,
+	ServerCounter_BytesReceived,
+	ServerCounter_BytesSent,
+	// NOTE(hugo) : Gathered sends, a flush of many messages counts once.
+	ServerCounter_Sends,
+	ServerCounter_MovesApplied,
+	ServerCounter_PremovesPlayed,
+	ServerCounter_PremovesDropped,
+	ServerCounter_IllegalMoves,
+	// NOTE(hugo) : Messages a client should never send, and the clients cut off for it.
+	ServerCounter_MalformedMessages,
+	ServerCounter_RateLimitedMessages,
+	ServerCounter_FloodDisconnects,
+	ServerCounter_RateLimitedConnections,
+	ServerCounter_Broadcasts,
+	ServerCounter_ConnectionsAdopted,
+	ServerCounter_ConnectionsClosed,
+	ServerCounter_ConnectionsHandedOff,
+	ServerCounter_GamesStarted,
+	ServerCounter_GamesEnded,
+	ServerCounter_FlagFalls,
+	ServerCounter_SlowConsumerDisconnects,
+	ServerCounter_DroppedUpdates,
+	ServerCounter_MatchesMade,
+	ServerCounter_MatchmakingRejects,
+
+	ServerCounter_Count,
+};
+
+enum server_gauge
+{
+	ServerGauge_Clients,
+	ServerGauge_LocalClients,
+	ServerGauge_ActiveRooms,
+	ServerGauge_QueuedMessages,
+	ServerGauge_LiveSharedMessages,
+	ServerGauge_WaitingPlayers,
+
+	ServerGauge_Count,
+};
+
+// NOTE(hugo) : All in nanoseconds.
+enum server_histogram
+{
+	ServerHistogram_Parse,
+	ServerHistogram_Handle,
+	// NOTE(hugo) : ApplyMove and the adjudication that follows.
+	ServerHistogram_ApplyMove,
+	ServerHistogram_Broadcast,
+	ServerHistogram_Flush,
+	// NOTE(hugo) : One turn of an event loop, waiting in poll excluded.
+	ServerHistogram_Tick,
+	ServerHistogram_MatchWait,
+
+	ServerHistogram_Count,
+};
+
+global_variable char* ServerCounterNames[ServerCounter_Count] =
+{
+	"messages_received_total",
+	"bytes_received_total",
+	"bytes_sent_total",
+	"sends_total",
+	"moves_applied_total",
+	"premoves_played_total",
+	"premoves_dropped_total",
+	"illegal_moves_total",
+	"malformed_messages_total",
+	"rate_limited_messages_total",
+	"flood_disconnects_total",
+	"rate_limited_connections_total",
+	"broadcasts_total",
+	"connections_adopted_total",
+	"connections_closed_total",
+	"connections_handed_off_total",
+	"games_started_total",
+	"games_ended_total",
+	"flag_falls_total",
+	"slow_consumer_disconnects_total",
+	"dropped_updates_total",
+	"matches_made_total",
+	"matchmaking_rejects_total",
+};
+
+global_variable char* ServerGaugeNames[ServerGauge_Count] =
+{
+	"clients",
+	"local_clients",
+	"active_rooms",
+	"queued_messages",
+	"live_shared_messages",
+	"waiting_players",
+};
+
+global_variable char* ServerHistogramNames[ServerHistogram_Count] =
+{
+	"parse_ns",
+	"handle_ns",
+	"apply_move_ns",
+	"broadcast_ns",
+	"flush_ns",
+	"tick_ns",
+	"match_wait_ns",
+};
+
+struct server_metrics
+{
+	u64 Counters[ServerCounter_Count];
+	u64 Gauges[ServerGauge_Count];
+	latency_histogram Histograms[ServerHistogram_Count];
+};
+
+// NOTE(hugo) : The copy of the metrics of a thread that other threads may read.
+struct published_metrics
+{
+	SDL_mutex* Mutex;
+	server_metrics Snapshot;
+	u64 LastPublishMS;
+};
+
+internal void
+InitialisePublishedMetrics(published_metrics* Published)
+{
+	Published->Mutex = SDL_CreateMutex();
+	Assert(Published->Mutex);
+	Published->Snapshot = {};
+	Published->LastPublishMS = 0;
+}
+
+internal void
+RecordElapsedTime(server_metrics* Metrics, server_histogram Histogram, u64 StartCounter, u64 CounterFrequency)
+{
+	u64 ElapsedCounter = SDL_GetPerformanceCounter() - StartCounter;
+	RecordLatency(Metrics->Histograms + Histogram, (ElapsedCounter * 1000000000) / CounterFrequency);
+}
+
+// NOTE(hugo) : Owner thread only.
+internal void
+PublishMetrics(published_metrics* Published, server_metrics* Metrics, u64 NowMS)
+{
+	SDL_LockMutex(Published->Mutex);
+	Published->Snapshot = *Metrics;
+	SDL_UnlockMutex(Published->Mutex);
+	Published->LastPublishMS = NowMS;
+}
+
+internal void
+ReadPublishedMetrics(published_metrics* Published, server_metrics* Metrics)
+{
+	SDL_LockMutex(Published->Mutex);
+	*Metrics = Published->Snapshot;
+	SDL_UnlockMutex(Published->Mutex);
+}
+
+internal void
+MergeServerMetrics(server_metrics* Dest, server_metrics* Source)
+{
+	for(u32 CounterIndex = 0; CounterIndex < ServerCounter_Count; ++CounterIndex)
+	{
+		Dest->Counters[CounterIndex] += Source->Counters[CounterIndex];
+	}
+	for(u32 GaugeIndex = 0; GaugeIndex < ServerGauge_Count; ++GaugeIndex)
+	{
+		Dest->Gauges[GaugeIndex] += Source->Gauges[GaugeIndex];
+	}
+	for(u32 HistogramIndex = 0; HistogramIndex < ServerHistogram_Count; ++HistogramIndex)
+	{
+		MergeLatencyHistogram(Dest->Histograms + HistogramIndex, Source->Histograms + HistogramIndex);
+	}
+}
+
+// NOTE(hugo) : Appends the metrics, tagged with Labels (e.g. thread="shard-0"),
+// to the text. Returns the new size of the text, that stops growing
+// when the buffer is full.
+internal u32
+AppendMetricsText(char* Text, u32 TextSize, u32 TextCapacity, char* Labels, server_metrics* Metrics)
+{
+	for(u32 CounterIndex = 0; CounterIndex < ServerCounter_Count; ++CounterIndex)
+	{
+		if(TextSize < TextCapacity)
+		{
+			TextSize += snprintf(Text + TextSize, TextCapacity - TextSize, "synchess_%s{%s} %llu\n",
+					ServerCounterNames[CounterIndex], Labels, (unsigned long long)Metrics->Counters[CounterIndex]);
+		}
+	}
+	for(u32 GaugeIndex = 0; GaugeIndex < ServerGauge_Count; ++GaugeIndex)
+	{
+		if(TextSize < TextCapacity)
+		{
+			TextSize += snprintf(Text + TextSize, TextCapacity - TextSize, "synchess_%s{%s} %llu\n",
+					ServerGaugeNames[GaugeIndex], Labels, (unsigned long long)Metrics->Gauges[GaugeIndex]);
+		}
+	}
+
+	float Quantiles[] = {50.0f, 90.0f, 99.0f, 99.9f};
+	char* QuantileNames[] = {"0.5", "0.9", "0.99", "0.999"};
+	for(u32 HistogramIndex = 0; HistogramIndex < ServerHistogram_Count; ++HistogramIndex)
+	{
+		latency_histogram* Histogram = Metrics->Histograms + HistogramIndex;
+		char* Name = ServerHistogramNames[HistogramIndex];
+		for(u32 QuantileIndex = 0; QuantileIndex < ArrayCount(Quantiles); ++QuantileIndex)
+		{
+			if(TextSize < TextCapacity)
+			{
+				TextSize += snprintf(Text + TextSize, TextCapacity - TextSize, "synchess_%s{%s,quantile=\"%s\"} %llu\n",
+						Name, Labels, QuantileNames[QuantileIndex],
+						(unsigned long long)GetLatencyPercentile(Histogram, Quantiles[QuantileIndex]));
+			}
+		}
+		if(TextSize < TextCapacity)
+		{
+			TextSize += snprintf(Text + TextSize, TextCapacity - TextSize,
+					"synchess_%s_max{%s} %llu\nsynchess_%s_count{%s} %llu\n",
+					Name, Labels, (unsigned long long)Histogram->MaxValue,
+					Name, Labels, (unsigned long long)Histogram->SampleCount);
+		}
+	}
+
+	// NOTE(hugo) : snprintf counts what it could not write, and keeps
+	// the last byte for the terminator.
+	if(TextSize >= TextCapacity)
+	{
+		TextSize = TextCapacity - 1;
+	}
+
+	return(TextSize);
+}
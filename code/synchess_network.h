@@ -15,16 +15,101 @@ enum network_message_type
 	NetworkMessageType_NoRoomForClient,
 	NetworkMessageType_ChessContextUpdate,
 	NetworkMessageType_GameStarted,
+	NetworkMessageType_JoinGame,
+	NetworkMessageType_SpectateGame,
+	NetworkMessageType_FlagFall,
+	NetworkMessageType_ResumeGame,
+	NetworkMessageType_GameResumed,
+	NetworkMessageType_Premove,
+	NetworkMessageType_GameEnded,
 
 	NetworkMessageType_Count,
 };
 
 struct network_message_connection_establised
 {
+	// NOTE(hugo) : PieceColor_Count for a spectator.
 	piece_color GivenColor;
+	// NOTE(hugo) : What the player gives back in ResumeGame to take its
+	// seat again after losing the connexion. 0 for a spectator.
+	u32 ReconnectToken;
 };
 
-typedef move_params network_message_move_done;
+struct network_message_game_started
+{
+	// NOTE(hugo) : What spectators give to watch this game.
+	u32 GameID;
+};
+
+// NOTE(hugo) : What a client that does not know its rating asks for.
+#define SYNCHESS_DEFAULT_RATING 1500
+
+struct network_message_join_game
+{
+	u32 Rating;
+	// NOTE(hugo) : A zero base time lets the server pick.
+	time_control TimeControl;
+};
+
+struct network_message_spectate_game
+{
+	u32 GameID;
+};
+
+struct network_message_resume_game
+{
+	u32 GameID;
+	u32 ReconnectToken;
+	// NOTE(hugo) : MoveSequence of the last position the client has.
+	u32 LastMoveSequence;
+};
+
+// NOTE(hugo) : Enough for a player that lost the connexion for a move or
+// two to catch up with this message alone. A longer absence gets a
+// context update with the whole position right after it.
+#define RESUME_MAX_TAIL_MOVE_COUNT 4
+
+struct network_message_game_resumed
+{
+	piece_color GivenColor;
+	u32 GameID;
+	u32 MoveSequence;
+	u32 ClockMS[PieceColor_Count];
+
+	// NOTE(hugo) : The moves played after the LastMoveSequence of the
+	// client, to replay on its position.
+	u32 TailMoveCount;
+	move_params TailMoves[RESUME_MAX_TAIL_MOVE_COUNT];
+	bool IsSnapshotFollowing;
+};
+
+struct network_message_flag_fall
+{
+	piece_color FlaggedColor;
+	game_result Result;
+};
+
+// NOTE(hugo) : Checkmate, stalemate or draw, right after the update with
+// the last move. A game lost on time or abandoned ends with a FlagFall.
+struct network_message_game_ended
+{
+	game_result Result;
+};
+
+struct network_message_move_done
+{
+	move_params Move;
+	// NOTE(hugo) : MoveSequence of the position the move was played in.
+	// The client plays it on its board at once, the server only plays
+	// it in that same position.
+	u32 MoveSequence;
+};
+
+// NOTE(hugo) : A move sent during the opponent's turn, that the server
+// plays for us right after the opponent's move if it is legal then.
+// One per player, a new one replaces the previous. A move of type
+// MoveType_None cancels it.
+typedef move_params network_message_premove;
 
 // TODO(hugo) : Probably the big player here
 // Might take a lot of bytes, sent each turn.
@@ -43,6 +128,17 @@ struct network_message_chess_context_update
 	//player_select PlayerCheckmate;
 	u32 LastDoubleStepCol;
 	piece_color PlayerToPlay;
+
+	// NOTE(hugo) : Time left to each player when the message was sent.
+	// The clock of PlayerToPlay is running.
+	u32 ClockMS[PieceColor_Count];
+	time_control TimeControl;
+
+	// NOTE(hugo) : Number of moves played to reach this position.
+	u32 MoveSequence;
+	// NOTE(hugo) : GetPositionHash of the position, for the client to
+	// check the move it played ahead of the server against it.
+	u32 PositionHash;
 };
 
 struct network_synchess_message
@@ -54,14 +150,13 @@ struct network_synchess_message
 		network_message_connection_establised ConnectionEstablished;
 		network_message_move_done MoveDone;
 		network_message_chess_context_update ContextUpdate;
+		network_message_game_started GameStarted;
+		network_message_join_game JoinGame;
+		network_message_spectate_game SpectateGame;
+		network_message_flag_fall FlagFall;
+		network_message_resume_game ResumeGame;
+		network_message_game_resumed GameResumed;
+		network_message_premove Premove;
+		network_message_game_ended GameEnded;
 	};
 };
-
-internal void
-NetSendMessage(TCPsocket Socket, network_synchess_message* Message)
-{
-	s32 SizeOfMessageStruct = sizeof(network_synchess_message);
-	s32 BytesSent = SDLNet_TCP_Send(Socket, Message, SizeOfMessageStruct);
-	Assert(BytesSent >= s32(SizeOfMessageStruct));
-}
-
@@ -0,0 +1,219 @@
+#pragma once
+
+// NOTE(hugo) : Frame profiler of the client. Every frame gets the time
+// spent in each of a few named sections, read with the performance
+// counter, in a ring of the last PROFILER_FRAME_COUNT frames. The slowest
+// frames since the start are kept aside, so that a stutter is still there
+// to look at long after it scrolled out of the ring.
+//
+// The overlay draws the ring as a graph, and the export writes the ring
+// and the slowest frames as a Chrome trace (chrome://tracing, Perfetto).
+//
+// A section is recorded as in the server metrics : the caller takes the
+// counter, does the work, and gives the counter back to RecordProfileSection.
+// Only the game loop thread records.
+
+#define PROFILER_FRAME_COUNT 256
+#define PROFILER_SLOWEST_FRAME_COUNT 8
+#define SYNCHESS_CLIENT_TRACE_PATH "synchess_client.trace.json"
+
+enum profile_section
+{
+	// NOTE(hugo) : The events and the input state, but not the time
+	// asleep waiting for them.
+	ProfileSection_Input,
+	// NOTE(hugo) : What the network thread handed over.
+	ProfileSection_Network,
+	ProfileSection_Update,
+	ProfileSection_Commands,
+	ProfileSection_Render,
+	ProfileSection_Present,
+
+	ProfileSection_Count,
+};
+
+global_variable char* ProfileSectionNames[ProfileSection_Count] =
+{
+	"input",
+	"network",
+	"update",
+	"commands",
+	"render",
+	"present",
+};
+
+struct profile_frame
+{
+	u64 FrameIndex;
+	u64 BeginCounter;
+	u64 EndCounter;
+
+	// NOTE(hugo) : 0 for a section the frame did not go through. A section
+	// entered twice starts at the first time and adds up both.
+	u64 SectionBeginCounters[ProfileSection_Count];
+	u64 SectionElapsedCounters[ProfileSection_Count];
+};
+
+struct frame_profiler
+{
+	u64 CounterFrequency;
+	// NOTE(hugo) : The frame in progress is Frames[FrameCount % PROFILER_FRAME_COUNT].
+	u64 FrameCount;
+	profile_frame Frames[PROFILER_FRAME_COUNT];
+
+	// NOTE(hugo) : From the slowest on.
+	u32 SlowestFrameCount;
+	profile_frame SlowestFrames[PROFILER_SLOWEST_FRAME_COUNT];
+
+	bool IsOverlayVisible;
+};
+
+global_variable frame_profiler GlobalProfiler;
+
+internal profile_frame*
+GetCurrentProfileFrame(frame_profiler* Profiler)
+{
+	profile_frame* Result = Profiler->Frames + (Profiler->FrameCount % PROFILER_FRAME_COUNT);
+	return(Result);
+}
+
+// NOTE(hugo) : The oldest frame still in the ring. The slot of the frame
+// in progress is the one of the oldest, which it already overwrote.
+internal u64
+GetFirstProfileFrameIndex(frame_profiler* Profiler)
+{
+	u64 Result = 0;
+	if(Profiler->FrameCount >= PROFILER_FRAME_COUNT)
+	{
+		Result = Profiler->FrameCount - PROFILER_FRAME_COUNT + 1;
+	}
+	return(Result);
+}
+
+internal u64
+GetProfileFrameElapsed(profile_frame* Frame)
+{
+	u64 Result = Frame->EndCounter - Frame->BeginCounter;
+	return(Result);
+}
+
+internal float
+GetProfileMS(frame_profiler* Profiler, u64 Elapsed)
+{
+	float Result = (1000.0f * (float)Elapsed) / (float)Profiler->CounterFrequency;
+	return(Result);
+}
+
+internal void
+BeginProfileFrame(frame_profiler* Profiler)
+{
+	if(!Profiler->CounterFrequency)
+	{
+		Profiler->CounterFrequency = SDL_GetPerformanceFrequency();
+	}
+
+	profile_frame* Frame = GetCurrentProfileFrame(Profiler);
+	*Frame = {};
+	Frame->FrameIndex = Profiler->FrameCount;
+	Frame->BeginCounter = SDL_GetPerformanceCounter();
+}
+
+internal void
+RecordProfileSection(frame_profiler* Profiler, profile_section Section, u64 StartCounter)
+{
+	profile_frame* Frame = GetCurrentProfileFrame(Profiler);
+	if(!Frame->SectionBeginCounters[Section])
+	{
+		Frame->SectionBeginCounters[Section] = StartCounter;
+	}
+	Frame->SectionElapsedCounters[Section] += SDL_GetPerformanceCounter() - StartCounter;
+}
+
+internal void
+EndProfileFrame(frame_profiler* Profiler)
+{
+	profile_frame* Frame = GetCurrentProfileFrame(Profiler);
+	Frame->EndCounter = SDL_GetPerformanceCounter();
+
+	// NOTE(hugo) : Insertion in the slowest frames, the last one falls off.
+	u64 Elapsed = GetProfileFrameElapsed(Frame);
+	u32 InsertIndex = Profiler->SlowestFrameCount;
+	while((InsertIndex > 0) && (GetProfileFrameElapsed(Profiler->SlowestFrames + InsertIndex - 1) < Elapsed))
+	{
+		--InsertIndex;
+	}
+	if(InsertIndex < PROFILER_SLOWEST_FRAME_COUNT)
+	{
+		if(Profiler->SlowestFrameCount < PROFILER_SLOWEST_FRAME_COUNT)
+		{
+			++Profiler->SlowestFrameCount;
+		}
+		memmove(Profiler->SlowestFrames + InsertIndex + 1, Profiler->SlowestFrames + InsertIndex,
+				(Profiler->SlowestFrameCount - InsertIndex - 1) * sizeof(profile_frame));
+		Profiler->SlowestFrames[InsertIndex] = *Frame;
+	}
+
+	++Profiler->FrameCount;
+}
+
+internal void
+WriteProfileFrameTrace(frame_profiler* Profiler, FILE* File, profile_frame* Frame, u32 ThreadID, u64 BaseCounter)
+{
+	double MicroSecondsPerCounter = 1000000.0 / (double)Profiler->CounterFrequency;
+	fprintf(File, ",\n{\"name\":\"frame %llu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			(unsigned long long)Frame->FrameIndex, ThreadID,
+			(double)(Frame->BeginCounter - BaseCounter) * MicroSecondsPerCounter,
+			(double)GetProfileFrameElapsed(Frame) * MicroSecondsPerCounter);
+
+	for(u32 SectionIndex = 0; SectionIndex < ProfileSection_Count; ++SectionIndex)
+	{
+		if(Frame->SectionBeginCounters[SectionIndex])
+		{
+			fprintf(File, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					ProfileSectionNames[SectionIndex], ThreadID,
+					(double)(Frame->SectionBeginCounters[SectionIndex] - BaseCounter) * MicroSecondsPerCounter,
+					(double)Frame->SectionElapsedCounters[SectionIndex] * MicroSecondsPerCounter);
+		}
+	}
+}
+
+// NOTE(hugo) : The frames of the ring on a first track, the slowest frames
+// on a second one, at the time they happened. Returns false if the file
+// could not be written.
+internal bool
+ExportProfileTrace(frame_profiler* Profiler, char* Path)
+{
+	FILE* File = fopen(Path, "wb");
+	if(!File)
+	{
+		return(false);
+	}
+
+	u64 FirstFrameIndex = GetFirstProfileFrameIndex(Profiler);
+	u64 BaseCounter = Profiler->Frames[FirstFrameIndex % PROFILER_FRAME_COUNT].BeginCounter;
+	for(u32 SlowIndex = 0; SlowIndex < Profiler->SlowestFrameCount; ++SlowIndex)
+	{
+		if(Profiler->SlowestFrames[SlowIndex].BeginCounter < BaseCounter)
+		{
+			BaseCounter = Profiler->SlowestFrames[SlowIndex].BeginCounter;
+		}
+	}
+
+	fprintf(File, "{\"traceEvents\":[");
+	fprintf(File, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"frames\"}}");
+	fprintf(File, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"slowest frames\"}}");
+	// NOTE(hugo) : The frame in progress is not done, it is left out.
+	for(u64 FrameIndex = FirstFrameIndex; FrameIndex < Profiler->FrameCount; ++FrameIndex)
+	{
+		WriteProfileFrameTrace(Profiler, File, Profiler->Frames + (FrameIndex % PROFILER_FRAME_COUNT), 1, BaseCounter);
+	}
+	for(u32 SlowIndex = 0; SlowIndex < Profiler->SlowestFrameCount; ++SlowIndex)
+	{
+		WriteProfileFrameTrace(Profiler, File, Profiler->SlowestFrames + SlowIndex, 2, BaseCounter);
+	}
+	fprintf(File, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	bool Result = (ferror(File) == 0);
+	Result = (fclose(File) == 0) && Result;
+	return(Result);
+}
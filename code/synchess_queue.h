@@ -0,0 +1,166 @@
+#pragma once
+
+// NOTE(hugo) : Bounded lock-free queue of fixed-size items (Vyukov's
+// bounded MPMC queue, only used with one consumer here). Every cell has
+// a sequence number that tells producers and the consumer whose turn it
+// is, so a push or a pop is one CAS in the common case and never blocks.
+// Items are copied in and out, so the queue owns no pointer into the
+// producer's memory.
+
+struct mpsc_queue
+{
+	u32 Capacity;
+	u32 ItemSize;
+	u8* Items;
+	SDL_atomic_t* Sequences;
+
+	SDL_atomic_t EnqueuePosition;
+	// NOTE(hugo) : Only touched by the single consumer.
+	u32 DequeuePosition;
+};
+
+internal void
+InitialiseMPSCQueue(mpsc_queue* Queue, u32 Capacity, u32 ItemSize, memory_arena* Arena)
+{
+	// NOTE(hugo) : Must be a power of two.
+	Assert((Capacity & (Capacity - 1)) == 0);
+	Queue->Capacity = Capacity;
+	Queue->ItemSize = ItemSize;
+	Queue->Items = (u8*)PushSize(Arena, (u64)Capacity * ItemSize);
+	Queue->Sequences = PushArray(Arena, Capacity, SDL_atomic_t);
+	for(u32 CellIndex = 0; CellIndex < Capacity; ++CellIndex)
+	{
+		SDL_AtomicSet(Queue->Sequences + CellIndex, (s32)CellIndex);
+	}
+	SDL_AtomicSet(&Queue->EnqueuePosition, 0);
+	Queue->DequeuePosition = 0;
+}
+
+// NOTE(hugo) : Returns false if the queue is full. Any thread.
+internal bool
+PushMPSCQueue(mpsc_queue* Queue, void* Item)
+{
+	bool Result = false;
+	u32 Mask = Queue->Capacity - 1;
+	for(;;)
+	{
+		u32 Position = (u32)SDL_AtomicGet(&Queue->EnqueuePosition);
+		SDL_atomic_t* Sequence = Queue->Sequences + (Position & Mask);
+		s32 Difference = (s32)((u32)SDL_AtomicGet(Sequence) - Position);
+		if(Difference == 0)
+		{
+			if(SDL_AtomicCAS(&Queue->EnqueuePosition, (s32)Position, (s32)(Position + 1)))
+			{
+				memcpy(Queue->Items + (u64)(Position & Mask) * Queue->ItemSize, Item, Queue->ItemSize);
+				// NOTE(hugo) : The item must be visible before the cell is handed over.
+				SDL_MemoryBarrierRelease();
+				SDL_AtomicSet(Sequence, (s32)(Position + 1));
+				Result = true;
+				break;
+			}
+		}
+		else if(Difference < 0)
+		{
+			// NOTE(hugo) : The consumer did not free this cell yet, we are full.
+			break;
+		}
+		// NOTE(hugo) : Otherwise another producer took this position, try the next one.
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Returns false if the queue is empty. Consumer thread only.
+internal bool
+PopMPSCQueue(mpsc_queue* Queue, void* Item)
+{
+	bool Result = false;
+	u32 Mask = Queue->Capacity - 1;
+	u32 Position = Queue->DequeuePosition;
+	SDL_atomic_t* Sequence = Queue->Sequences + (Position & Mask);
+	s32 Difference = (s32)((u32)SDL_AtomicGet(Sequence) - (Position + 1));
+	if(Difference == 0)
+	{
+		SDL_MemoryBarrierAcquire();
+		memcpy(Item, Queue->Items + (u64)(Position & Mask) * Queue->ItemSize, Queue->ItemSize);
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(Sequence, (s32)(Position + Queue->Capacity));
+		Queue->DequeuePosition = Position + 1;
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Bounded lock-free queue between exactly one producer
+// thread and one consumer thread. Each side only ever writes its own
+// position and reads the other one, so there is no CAS at all. The two
+// positions sit on their own cache lines so that the sides do not fight
+// over one.
+struct spsc_queue
+{
+	u32 Capacity;
+	u32 ItemSize;
+	u8* Items;
+
+	u8 PaddingBeforeWrite[64];
+	// NOTE(hugo) : Only written by the producer.
+	SDL_atomic_t WritePosition;
+	u8 PaddingBeforeRead[64];
+	// NOTE(hugo) : Only written by the consumer.
+	SDL_atomic_t ReadPosition;
+	u8 PaddingAfterRead[64];
+};
+
+internal void
+InitialiseSPSCQueue(spsc_queue* Queue, u32 Capacity, u32 ItemSize, memory_arena* Arena)
+{
+	// NOTE(hugo) : Must be a power of two.
+	Assert((Capacity & (Capacity - 1)) == 0);
+	Queue->Capacity = Capacity;
+	Queue->ItemSize = ItemSize;
+	Queue->Items = (u8*)PushSize(Arena, (u64)Capacity * ItemSize);
+	SDL_AtomicSet(&Queue->WritePosition, 0);
+	SDL_AtomicSet(&Queue->ReadPosition, 0);
+}
+
+// NOTE(hugo) : Returns false if the queue is full. Producer thread only.
+internal bool
+PushSPSCQueue(spsc_queue* Queue, void* Item)
+{
+	bool Result = false;
+	u32 WritePosition = (u32)SDL_AtomicGet(&Queue->WritePosition);
+	u32 ReadPosition = (u32)SDL_AtomicGet(&Queue->ReadPosition);
+	if(WritePosition - ReadPosition < Queue->Capacity)
+	{
+		u32 Mask = Queue->Capacity - 1;
+		memcpy(Queue->Items + (u64)(WritePosition & Mask) * Queue->ItemSize, Item, Queue->ItemSize);
+		// NOTE(hugo) : The item must be visible before the consumer can see it.
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&Queue->WritePosition, (s32)(WritePosition + 1));
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Returns false if the queue is empty. Consumer thread only.
+internal bool
+PopSPSCQueue(spsc_queue* Queue, void* Item)
+{
+	bool Result = false;
+	u32 ReadPosition = (u32)SDL_AtomicGet(&Queue->ReadPosition);
+	u32 WritePosition = (u32)SDL_AtomicGet(&Queue->WritePosition);
+	if(ReadPosition != WritePosition)
+	{
+		SDL_MemoryBarrierAcquire();
+		u32 Mask = Queue->Capacity - 1;
+		memcpy(Item, Queue->Items + (u64)(ReadPosition & Mask) * Queue->ItemSize, Queue->ItemSize);
+		// NOTE(hugo) : Done with the cell before the producer may reuse it.
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&Queue->ReadPosition, (s32)(ReadPosition + 1));
+		Result = true;
+	}
+
+	return(Result);
+}
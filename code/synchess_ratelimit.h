@@ -0,0 +1,129 @@
+#pragma once
+
+// NOTE(hugo) : Token buckets, to keep a flooding peer from eating the
+// time of the other games of its shard. A bucket holds up to Burst
+// tokens and gets RatePerSecond of them back every second. The tokens
+// are counted in thousandths so that a refill is exact in milliseconds.
+//
+// Taking from an empty bucket fails but still takes, down to a debt of
+// a whole burst. A peer that slows down is back in credit soon enough,
+// one that keeps going ends up with a bankrupt bucket and is cut off.
+
+struct rate_limit
+{
+	// NOTE(hugo) : 0 for no limit.
+	u32 RatePerSecond;
+	u32 Burst;
+};
+
+struct token_bucket
+{
+	s64 MilliTokens;
+	u64 LastRefillMS;
+};
+
+internal bool
+IsRateLimited(rate_limit* Limit)
+{
+	bool Result = (Limit->RatePerSecond > 0);
+	return(Result);
+}
+
+internal void
+InitialiseTokenBucket(token_bucket* Bucket, rate_limit* Limit, u64 NowMS)
+{
+	Bucket->MilliTokens = 1000 * (s64)Limit->Burst;
+	Bucket->LastRefillMS = NowMS;
+}
+
+internal void
+RefillTokenBucket(token_bucket* Bucket, rate_limit* Limit, u64 NowMS)
+{
+	if(NowMS > Bucket->LastRefillMS)
+	{
+		s64 MaxMilliTokens = 1000 * (s64)Limit->Burst;
+		// NOTE(hugo) : Milliseconds times tokens per second.
+		s64 ElapsedMS = (s64)(NowMS - Bucket->LastRefillMS);
+		s64 MilliTokens = Bucket->MilliTokens + ElapsedMS * (s64)Limit->RatePerSecond;
+		Bucket->MilliTokens = (MilliTokens < MaxMilliTokens) ? MilliTokens : MaxMilliTokens;
+		Bucket->LastRefillMS = NowMS;
+	}
+}
+
+// NOTE(hugo) : Returns false if the peer is over its limit.
+internal bool
+TakeToken(token_bucket* Bucket, rate_limit* Limit, u64 NowMS)
+{
+	bool Result = true;
+	if(IsRateLimited(Limit))
+	{
+		RefillTokenBucket(Bucket, Limit, NowMS);
+		Result = (Bucket->MilliTokens >= 1000);
+
+		// NOTE(hugo) : Debt stops at the burst, past that it is bankrupt anyway.
+		s64 MinMilliTokens = -1000 * (s64)Limit->Burst;
+		s64 MilliTokens = Bucket->MilliTokens - 1000;
+		Bucket->MilliTokens = (MilliTokens > MinMilliTokens) ? MilliTokens : MinMilliTokens;
+	}
+
+	return(Result);
+}
+
+internal bool
+IsTokenBucketBankrupt(token_bucket* Bucket, rate_limit* Limit)
+{
+	bool Result = IsRateLimited(Limit) &&
+		(Bucket->MilliTokens <= -1000 * (s64)Limit->Burst);
+	return(Result);
+}
+
+// NOTE(hugo) : The buckets of the peers that connected recently, by IP.
+// Only touched by the acceptor. A bucket that sat idle long enough to
+// refill is as good as a new one, so when the probe finds no room the
+// entry idle for the longest is simply taken over.
+#define PEER_BUCKET_TABLE_SIZE 1024
+#define PEER_BUCKET_PROBE_COUNT 8
+
+struct peer_bucket
+{
+	// NOTE(hugo) : 0 for an empty entry, nobody connects from 0.0.0.0.
+	u32 PeerIP;
+	token_bucket Bucket;
+};
+
+struct peer_bucket_table
+{
+	peer_bucket Entries[PEER_BUCKET_TABLE_SIZE];
+};
+
+internal token_bucket*
+FindPeerBucket(peer_bucket_table* Table, rate_limit* Limit, u32 PeerIP, u64 NowMS)
+{
+	Assert(PeerIP != 0);
+	// NOTE(hugo) : Fibonacci hashing, the top 10 bits for the 1024 entries.
+	u32 HashIndex = (PeerIP * 2654435761u) >> 22;
+	peer_bucket* Oldest = 0;
+	peer_bucket* Result = 0;
+	for(u32 ProbeIndex = 0; !Result && (ProbeIndex < PEER_BUCKET_PROBE_COUNT); ++ProbeIndex)
+	{
+		peer_bucket* Entry = Table->Entries + ((HashIndex + ProbeIndex) & (PEER_BUCKET_TABLE_SIZE - 1));
+		if(Entry->PeerIP == PeerIP)
+		{
+			Result = Entry;
+		}
+		else if(!Oldest || (Entry->PeerIP == 0) ||
+				((Oldest->PeerIP != 0) && (Entry->Bucket.LastRefillMS < Oldest->Bucket.LastRefillMS)))
+		{
+			Oldest = Entry;
+		}
+	}
+
+	if(!Result)
+	{
+		Result = Oldest;
+		Result->PeerIP = PeerIP;
+		InitialiseTokenBucket(&Result->Bucket, Limit, NowMS);
+	}
+
+	return(&Result->Bucket);
+}
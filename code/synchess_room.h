@@ -0,0 +1,311 @@
+#pragma once
+
+// NOTE(hugo) : Each game owns a fixed-size slab carved once out of the
+// server arena at startup. Everything a game allocates (its pieces,
+// its config history, the scratch lists of the move generation) lives
+// in that slab, and the slab is simply reset when the room goes back
+// to the free list. This way the server memory stays flat no matter
+// how many games it has hosted.
+//
+// A config node is ~72 bytes, a history entry ~20 bytes and the scratch
+// needed by the adjudication stays well under GAME_ARENA_RESERVE,
+// so 128KB holds the MAX_GAME_PLY_COUNT plies of a game.
+#define GAME_ARENA_SIZE Kilobytes(128)
+#define GAME_ARENA_RESERVE Kilobytes(16)
+#define MAX_GAME_PLY_COUNT 1024
+
+struct client_connection;
+
+struct game_clock
+{
+	time_control TimeControl;
+	u32 RemainingMS[PieceColor_Count];
+	bool IsRunning;
+	// NOTE(hugo) : When the player to play started its turn.
+	u64 TurnStartMS;
+
+	// NOTE(hugo) : Fires when the player to play runs out of time.
+	timer_entry FlagTimer;
+};
+
+struct game_room
+{
+	u32 RoomIndex;
+	u32 GameID;
+	bool IsActive;
+
+	memory_arena Arena;
+	void* ArenaBase;
+
+	chess_game_context ChessContext;
+	move_params* MoveHistory;
+	u32 MoveCount;
+
+	client_connection* Players[PieceColor_Count];
+	u32 PlayerCount;
+	bool HasStarted;
+
+	// NOTE(hugo) : A seat whose player lost the connexion stays free for
+	// its owner, who proves it is him with the token of the seat. The
+	// timer runs while a seat is free and ends the game when it fires.
+	u32 ReconnectTokens[PieceColor_Count];
+	timer_entry AbandonTimer;
+
+	// NOTE(hugo) : Of type MoveType_None when the player has none.
+	move_params Premoves[PieceColor_Count];
+
+	// NOTE(hugo) : Intrusive list through the connections themselves,
+	// a room can have any number of spectators.
+	client_connection* FirstSpectator;
+	u32 SpectatorCount;
+
+	game_clock Clock;
+
+	game_room* NextFree;
+};
+
+struct game_room_pool_stats
+{
+	u32 ActiveRoomCount;
+	u32 HighWaterRoomCount;
+	u64 HighWaterArenaUsed;
+
+	u64 AcquireCount;
+	u64 ReleaseCount;
+	u64 ExhaustedCount;
+};
+
+struct game_room_pool
+{
+	u32 RoomCount;
+	game_room* Rooms;
+	game_room* FirstFree;
+
+	game_room_pool_stats Stats;
+};
+
+internal void
+InitialiseRoomPool(game_room_pool* Pool, u32 RoomCount, memory_arena* Arena)
+{
+	Pool->RoomCount = RoomCount;
+	Pool->Rooms = PushArray(Arena, RoomCount, game_room);
+	Pool->FirstFree = 0;
+	Pool->Stats = {};
+
+	// NOTE(hugo) : Push the rooms in reverse order so that the free list
+	// hands out the low indices first.
+	for(s32 RoomIndex = RoomCount - 1; RoomIndex >= 0; --RoomIndex)
+	{
+		game_room* Room = Pool->Rooms + RoomIndex;
+		*Room = {};
+		Room->RoomIndex = RoomIndex;
+		Room->ArenaBase = PushSize(Arena, GAME_ARENA_SIZE);
+		Room->NextFree = Pool->FirstFree;
+		Pool->FirstFree = Room;
+	}
+}
+
+internal game_room*
+AcquireRoom(game_room_pool* Pool)
+{
+	game_room* Room = Pool->FirstFree;
+	if(Room)
+	{
+		Pool->FirstFree = Room->NextFree;
+		Room->NextFree = 0;
+
+		InitialiseArena(&Room->Arena, GAME_ARENA_SIZE, Room->ArenaBase);
+		InitialiseChessContext(&Room->ChessContext, &Room->Arena);
+		Room->MoveHistory = PushArray(&Room->Arena, MAX_GAME_PLY_COUNT, move_params);
+		Room->MoveCount = 0;
+		Room->GameID = 0;
+		Room->IsActive = true;
+		for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Players); ++PlayerIndex)
+		{
+			Room->Players[PlayerIndex] = 0;
+		}
+		Room->PlayerCount = 0;
+		Room->HasStarted = false;
+		for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->ReconnectTokens); ++PlayerIndex)
+		{
+			Room->ReconnectTokens[PlayerIndex] = 0;
+		}
+		Room->AbandonTimer = {};
+		for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Premoves); ++PlayerIndex)
+		{
+			Room->Premoves[PlayerIndex] = {};
+			Room->Premoves[PlayerIndex].Type = MoveType_None;
+		}
+		Room->FirstSpectator = 0;
+		Room->SpectatorCount = 0;
+		Room->Clock = {};
+
+		++Pool->Stats.AcquireCount;
+		++Pool->Stats.ActiveRoomCount;
+		if(Pool->Stats.ActiveRoomCount > Pool->Stats.HighWaterRoomCount)
+		{
+			Pool->Stats.HighWaterRoomCount = Pool->Stats.ActiveRoomCount;
+		}
+	}
+	else
+	{
+		++Pool->Stats.ExhaustedCount;
+	}
+
+	return(Room);
+}
+
+internal void
+ReleaseRoom(game_room_pool* Pool, game_room* Room)
+{
+	Assert(Room);
+	Assert(Pool->Stats.ActiveRoomCount > 0);
+	Assert(!Room->Clock.FlagTimer.IsScheduled);
+	Assert(!Room->AbandonTimer.IsScheduled);
+
+	if(Room->Arena.Used > Pool->Stats.HighWaterArenaUsed)
+	{
+		Pool->Stats.HighWaterArenaUsed = Room->Arena.Used;
+	}
+
+	Room->Arena.Used = 0;
+	Room->IsActive = false;
+	Room->NextFree = Pool->FirstFree;
+	Pool->FirstFree = Room;
+
+	++Pool->Stats.ReleaseCount;
+	--Pool->Stats.ActiveRoomCount;
+}
+
+internal void
+PushMoveHistory(game_room* Room, move_params Move)
+{
+	Assert(Room->MoveCount < MAX_GAME_PLY_COUNT);
+	Room->MoveHistory[Room->MoveCount] = Move;
+	++Room->MoveCount;
+}
+
+internal bool
+IsRoomExhausted(game_room* Room)
+{
+	bool Result = (Room->Arena.Used + GAME_ARENA_RESERVE > Room->Arena.Size) ||
+		(Room->MoveCount >= MAX_GAME_PLY_COUNT);
+	return(Result);
+}
+
+// NOTE(hugo) : A time control without base time is an untimed game : its
+// clock never runs and never flags.
+internal bool
+IsClockTimed(game_clock* Clock)
+{
+	bool Result = (Clock->TimeControl.BaseMS > 0);
+	return(Result);
+}
+
+// NOTE(hugo) : Time the player to play has used so far this turn.
+internal u32
+GetClockUsedMS(game_clock* Clock, u64 NowMS)
+{
+	u32 Result = 0;
+	if(Clock->IsRunning && (NowMS > Clock->TurnStartMS + Clock->TimeControl.DelayMS))
+	{
+		Result = (u32)(NowMS - Clock->TurnStartMS - Clock->TimeControl.DelayMS);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Always 0 for an untimed game, the time control tells the
+// clients there is no clock to show.
+internal u32
+GetClockRemainingMS(game_room* Room, piece_color Color, u64 NowMS)
+{
+	game_clock* Clock = &Room->Clock;
+	u32 Result = Clock->RemainingMS[Color];
+	if(!IsClockTimed(Clock))
+	{
+		Result = 0;
+	}
+	else if(Color == Room->ChessContext.PlayerToPlay)
+	{
+		u32 UsedMS = GetClockUsedMS(Clock, NowMS);
+		Result = (UsedMS < Result) ? (Result - UsedMS) : 0;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : The flag timer always watches the clock of the player
+// whose turn started at TurnStartMS.
+internal void
+ScheduleFlagTimer(game_room* Room, timer_wheel* Wheel, piece_color Color)
+{
+	game_clock* Clock = &Room->Clock;
+	u64 FlagMS = Clock->TurnStartMS + Clock->TimeControl.DelayMS + Clock->RemainingMS[Color];
+	ScheduleTimer(Wheel, &Clock->FlagTimer, GetTimerDeadlineTick(FlagMS), Room);
+}
+
+internal void
+StartRoomClock(game_room* Room, timer_wheel* Wheel, time_control TimeControl, u64 NowMS)
+{
+	game_clock* Clock = &Room->Clock;
+	Clock->TimeControl = TimeControl;
+	Clock->RemainingMS[PieceColor_White] = TimeControl.BaseMS;
+	Clock->RemainingMS[PieceColor_Black] = TimeControl.BaseMS;
+	if(IsClockTimed(Clock))
+	{
+		Clock->TurnStartMS = NowMS;
+		Clock->IsRunning = true;
+		ScheduleFlagTimer(Room, Wheel, Room->ChessContext.PlayerToPlay);
+	}
+}
+
+// NOTE(hugo) : Starts the clock of a game recovered from the journal,
+// where it stopped with the server. An untimed game stays untimed.
+internal void
+ResumeRoomClock(game_room* Room, timer_wheel* Wheel, u64 NowMS)
+{
+	game_clock* Clock = &Room->Clock;
+	if(!Clock->IsRunning && IsClockTimed(Clock))
+	{
+		Clock->TurnStartMS = NowMS;
+		Clock->IsRunning = true;
+		ScheduleFlagTimer(Room, Wheel, Room->ChessContext.PlayerToPlay);
+	}
+}
+
+internal void
+StopRoomClock(game_room* Room, timer_wheel* Wheel)
+{
+	CancelTimer(Wheel, &Room->Clock.FlagTimer);
+	Room->Clock.IsRunning = false;
+}
+
+// NOTE(hugo) : Called when the player to play made a move, before the move
+// is applied. Returns false if that player was already out of time (the
+// move raced the flag timer), in which case the clock is left untouched.
+// An untimed game, or a stopped clock, takes any move.
+internal bool
+PunchRoomClock(game_room* Room, timer_wheel* Wheel, u64 NowMS)
+{
+	bool Result = true;
+	game_clock* Clock = &Room->Clock;
+	if(Clock->IsRunning && IsClockTimed(Clock))
+	{
+		piece_color Color = Room->ChessContext.PlayerToPlay;
+		u32 UsedMS = GetClockUsedMS(Clock, NowMS);
+		if(UsedMS >= Clock->RemainingMS[Color])
+		{
+			Result = false;
+		}
+		else
+		{
+			Clock->RemainingMS[Color] -= UsedMS;
+			Clock->RemainingMS[Color] += Clock->TimeControl.IncrementMS;
+			Clock->TurnStartMS = NowMS;
+			ScheduleFlagTimer(Room, Wheel, OtherColor(Color));
+		}
+	}
+
+	return(Result);
+}
@@ -1,54 +1,1916 @@
 #ifdef _WIN32
 #include <SDL.h>
-#include <SDL_net.h>
 #else
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_net.h>
 #endif
 
 // NOTE(hugo) : The server for handling Synchess request.
+//
+// The main thread only accepts connexions. The games are spread over
+// worker threads (shards), each one with its own event loop, clients,
+// rooms, clocks and message pool, so that a shard never takes a lock to
+// run a game. A game lives on the shard of index GameID % ShardCount,
+// and its players and spectators are connexions of that shard.
+//
+// Bots and engines running on the game host can connect through shared
+// memory instead of TCP (-local, see synchess_local.h). Past the
+// acceptor, only the reads and writes know the difference.
+//
+// The players asking for a game are handed to the matchmaking thread,
+// which pairs them by time control and rating and hands both players of
+// a pair to the same shard, where their game starts.
+//
+// What happens to the games is not printed but logged in binary, see
+// synchess_log.h, and read back with synchess_logdump.
 
 #include <rivten.h>
 #include <rivten_math.h>
 
-// NOTE(hugo) : Basing most of this on : https://r3dux.org/2011/01/a-simple-sdl_net-chat-server-client/
+#include "synchess.h"
+#include "synchess_network.h"
+#include "chess.cpp"
+#include "synchess_socket.h"
+#include "synchess_local.h"
+#include "synchess_ratelimit.h"
+#include "synchess_broadcast.h"
+#include "synchess_queue.h"
+#include "synchess_timer.h"
+#include "synchess_room.h"
+#include "synchess_log.h"
+#include "synchess_journal.h"
+#include "synchess_matchmaking.h"
+#include "synchess_histogram.h"
+#include "synchess_metrics.h"
+
+// NOTE(hugo) : Both limits are for the whole server, split between the shards.
+#define MAX_CLIENT_COUNT 4096
+#define MAX_ROOM_COUNT 1024
+#define MAX_SHARD_COUNT 64
+// NOTE(hugo) : Must be a power of two.
+#define SHARD_HANDOFF_QUEUE_SIZE 256
+#define MATCHMAKING_QUEUE_SIZE 4096
+// NOTE(hugo) : How often the rating windows are looked at again when nobody joins.
+#define MATCHMAKING_TICK_MS 100
+#define SERVER_POLL_TIMEOUT_MS 1000
+#define INBOUND_BUFFER_SIZE (4 * sizeof(network_synchess_message))
+// NOTE(hugo) : Bounds the connexions accepted per tick so that a burst of
+// new clients cannot starve the ones already playing.
+#define MAX_ACCEPT_PER_TICK 64
+#define DEFAULT_OUTBOUND_HIGH_WATER (OUTBOUND_QUEUE_SIZE / 2)
+#define DEFAULT_CLOCK_BASE_MS (10 * 60 * 1000)
+// NOTE(hugo) : How long a seat waits for its player to reconnect.
+#define DEFAULT_RESUME_GRACE_MS (60 * 1000)
+// NOTE(hugo) : Only bound to the loopback. Every connexion gets a snapshot of the metrics.
+#define SYNCHESS_ADMIN_PORT 1235
+#define ADMIN_TEXT_SIZE Megabytes(1)
+// NOTE(hugo) : A player sends a move or two per turn, so a client going
+// over that is a broken or hostile one.
+#define DEFAULT_MESSAGE_RATE 50
+#define DEFAULT_MESSAGE_BURST 100
+// NOTE(hugo) : New connexions per second from one IP.
+#define DEFAULT_CONNECT_RATE 20
+#define DEFAULT_CONNECT_BURST 200
+#define MAX_CONNECT_LIMIT_EXEMPT_COUNT 16
+// NOTE(hugo) : Anything longer than a day is not a time control we offer.
+#define MAX_TIME_CONTROL_MS (24 * 60 * 60 * 1000)
+
+// NOTE(hugo) : What to do with a spectator whose outbound queue reached
+// the high-water mark. A player that slow is always disconnected since
+// it would hold its opponent hostage.
+enum slow_consumer_policy
+{
+	SlowConsumerPolicy_Disconnect,
+	// NOTE(hugo) : A context update carries the whole board, so a late
+	// spectator can skip the intermediate ones and only get the latest.
+	SlowConsumerPolicy_DropUpdates,
+
+	SlowConsumerPolicy_Count,
+};
+
+struct server_config
+{
+	char* JournalPath;
+	char* EventLogPath;
+	u32 OutboundHighWater;
+	slow_consumer_policy SpectatorPolicy;
+	time_control TimeControl;
+	u32 ShardCount;
+	// NOTE(hugo) : 0 to end the game as soon as a player leaves.
+	u32 ResumeGraceMS;
+	// NOTE(hugo) : 0 to go without the admin socket.
+	u16 AdminPort;
+	// NOTE(hugo) : Where to listen for local connexions, 0 for TCP only.
+	char* LocalPath;
+	// NOTE(hugo) : Per connexion, and per IP for the new connexions.
+	rate_limit MessageLimit;
+	rate_limit ConnectLimit;
+	// NOTE(hugo) : Peers that skip the connect limit, none unless given,
+	// e.g. the game host for a load test with many bots.
+	u32 ConnectLimitExemptIPs[MAX_CONNECT_LIMIT_EXEMPT_COUNT];
+	u32 ConnectLimitExemptCount;
+	// NOTE(hugo) : Only there to measure what TCP_NODELAY buys us.
+	bool IsNagleEnabled;
+};
+
+struct client_connection
+{
+	bool IsConnected;
+	platform_socket Socket;
+	u32 PeerIP;
+	// NOTE(hugo) : For a local connexion the socket is only the doorbell.
+	local_channel Local;
+
+	// NOTE(hugo) : A client is in the lobby (no room) until it asks
+	// to play or to watch a game.
+	game_room* Room;
+	// NOTE(hugo) : PieceColor_Count for a spectator.
+	piece_color Color;
+	client_connection* NextSpectator;
+	client_connection* PrevSpectator;
+
+	u32 InboundSize;
+	u8 InboundBuffer[INBOUND_BUFFER_SIZE];
+	outbound_queue Outbound;
+	token_bucket MessageBucket;
+
+	// NOTE(hugo) : Set when the kernel send buffer is full. The queue is
+	// not flushed again until poll reports the socket writable.
+	bool IsWriteBlocked;
+	// NOTE(hugo) : A connexion cannot be torn down in the middle of a
+	// broadcast, so it is only marked and closed at the end of the tick.
+	bool ShouldDisconnect;
+};
+
+// NOTE(hugo) : A connexion between two owners (shards or the matchmaker).
+// Copied by value through the queues.
+struct handed_connection
+{
+	platform_socket Socket;
+	u32 PeerIP;
+	local_channel Local;
+	// NOTE(hugo) : Follows the connexion, so that going from shard to
+	// shard does not refill it.
+	token_bucket MessageBucket;
+
+	// NOTE(hugo) : What the previous owner already read past the
+	// message that made it hand the connexion over.
+	u32 InboundSize;
+	u8 InboundBuffer[INBOUND_BUFFER_SIZE];
+};
+
+enum connection_handoff_type
+{
+	// NOTE(hugo) : Fresh from the acceptor.
+	ConnectionHandoff_New,
+	// NOTE(hugo) : Asked to watch or to resume a game of the receiving
+	// shard, which handles the message as if it had received it.
+	ConnectionHandoff_Forward,
+	// NOTE(hugo) : Two players paired by the matchmaker, their game
+	// starts on the receiving shard.
+	ConnectionHandoff_Match,
+
+	ConnectionHandoff_Count,
+};
+
+// NOTE(hugo) : Everything a shard needs to adopt connexions.
+struct connection_handoff
+{
+	connection_handoff_type Type;
+	network_synchess_message Message;
+	time_control TimeControl;
+
+	u32 ConnectionCount;
+	handed_connection Connections[2];
+};
+
+// NOTE(hugo) : A player waiting for an opponent.
+struct matchmaking_ticket
+{
+	u32 Rating;
+	time_control TimeControl;
+	handed_connection Connection;
+};
+
+struct server_state;
+
+struct server_shard
+{
+	u32 ShardIndex;
+	server_state* ServerState;
+	SDL_Thread* Thread;
+
+	game_room_pool RoomPool;
+	// NOTE(hugo) : Only hands out the IDs of this shard,
+	// the ones where GameID % ShardCount == ShardIndex.
+	u32 NextGameID;
+
+	// NOTE(hugo) : Drives the clocks of every running game of the shard,
+	// and the seats waiting for their player.
+	timer_wheel TimerWheel;
+	u64 TokenRandomState;
+
+	shared_message_pool MessagePool;
+
+	// NOTE(hugo) : Filled by any thread, emptied by the shard. A byte on
+	// the wakeup pair gets the shard out of poll to look at it.
+	mpsc_queue HandoffQueue;
+	platform_socket WakeupReceiver;
+	platform_socket WakeupSender;
+
+	client_connection* Clients;
+	u32 ClientCapacity;
+	u32 CurrentClientCount;
+	// NOTE(hugo) : Mirrors CurrentClientCount for the acceptor.
+	SDL_atomic_t LoadCount;
+
+	socket_poll* Polls;
+	client_connection** PolledClients;
+
+	u64 CounterFrequency;
+	server_metrics Metrics;
+	published_metrics PublishedMetrics;
+	log_ring* LogRing;
+};
+
+// NOTE(hugo) : Owns the waiting players, on its own thread so that
+// bursts of joins are never serialised behind the games.
+struct matchmaking_state
+{
+	SDL_Thread* Thread;
+
+	// NOTE(hugo) : Filled by the shards, emptied by the matchmaker.
+	mpsc_queue TicketQueue;
+	platform_socket WakeupReceiver;
+	platform_socket WakeupSender;
+
+	matchmaker Matchmaker;
+	matchmaking_ticket* Tickets;
+	bool* IsTicketUsed;
+	u32 TicketCapacity;
+	matchmaking_pair* Pairs;
+	u32 NextShardIndex;
+
+	// NOTE(hugo) : The waiting sockets are still watched, to drop the
+	// players that leave before being paired.
+	socket_poll* Polls;
+	u32* PolledTickets;
+
+	u64 CounterFrequency;
+	server_metrics Metrics;
+	published_metrics PublishedMetrics;
+	log_ring* LogRing;
+};
+
+struct server_state
+{
+	server_config Config;
+	memory_arena ServerArena;
+
+	// NOTE(hugo) : Shared by all the shards, appending takes its lock.
+	game_journal Journal;
+	event_log EventLog;
+
+	// NOTE(hugo) : Network stuff
+	platform_socket ServerSocket;
+	platform_socket AdminSocket;
+	platform_socket LocalSocket;
+	u32 NextShardIndex;
+	char* AdminText;
+	// NOTE(hugo) : The acceptor runs the admin socket too, so its metrics
+	// are never read by another thread and need no publishing.
+	server_metrics AcceptorMetrics;
+	peer_bucket_table PeerBuckets;
+
+	u32 ShardCount;
+	server_shard* Shards;
+
+	matchmaking_state Matchmaking;
+
+	bool IsInitialised;
+};
+
+struct game_memory
+{
+	u64 StorageSize;
+	void* Storage;
+};
+
+internal u64
+GetServerTimeMS(void)
+{
+	// NOTE(hugo) : Counter * 1000 overflows after a few months with a
+	// nanosecond counter, so the frequency is divided first.
+	u64 Result = SDL_GetPerformanceCounter() / (SDL_GetPerformanceFrequency() / 1000);
+	return(Result);
+}
+
+internal client_connection*
+FindFreeClientSlot(server_shard* Shard)
+{
+	client_connection* Result = 0;
+	for(u32 ClientIndex = 0; (!Result) && (ClientIndex < Shard->ClientCapacity); ++ClientIndex)
+	{
+		if(!Shard->Clients[ClientIndex].IsConnected)
+		{
+			Result = Shard->Clients + ClientIndex;
+		}
+	}
+
+	return(Result);
+}
+
+internal void
+QueueToClient(server_shard* Shard, client_connection* Client, shared_message* Shared)
+{
+	if(Client->ShouldDisconnect)
+	{
+		return;
+	}
+
+	server_config* Config = &Shard->ServerState->Config;
+	outbound_queue* Outbound = &Client->Outbound;
+	if(GetOutboundQueueCount(Outbound) < Config->OutboundHighWater)
+	{
+		bool Queued = QueueSharedMessage(Outbound, Shared);
+		Assert(Queued);
+	}
+	else
+	{
+		bool IsSpectator = (Client->Color == PieceColor_Count);
+		if(IsSpectator &&
+				(Config->SpectatorPolicy == SlowConsumerPolicy_DropUpdates) &&
+				(Shared->Message.Type == NetworkMessageType_ChessContextUpdate) &&
+				ReplaceNewestQueuedMessage(Outbound, Shared, &Shard->MessagePool))
+		{
+			++Shard->Metrics.Counters[ServerCounter_DroppedUpdates];
+		}
+		else
+		{
+			Client->ShouldDisconnect = true;
+			++Shard->Metrics.Counters[ServerCounter_SlowConsumerDisconnects];
+			LogEvent(Shard->LogRing, LogEvent_SlowConsumer,
+					(u32)(Client - Shard->Clients), GetOutboundQueueCount(Outbound));
+		}
+	}
+}
+
+internal void
+SendToClient(server_shard* Shard, client_connection* Client, network_synchess_message* Message)
+{
+	shared_message* Shared = EncodeSharedMessage(&Shard->MessagePool, Message);
+	QueueToClient(Shard, Client, Shared);
+	ReleaseSharedMessage(&Shard->MessagePool, Shared);
+}
+
+internal void
+BroadcastToRoom(server_shard* Shard, game_room* Room, network_synchess_message* Message)
+{
+	u64 StartCounter = SDL_GetPerformanceCounter();
+	shared_message* Shared = EncodeSharedMessage(&Shard->MessagePool, Message);
+	for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Players); ++PlayerIndex)
+	{
+		client_connection* Player = Room->Players[PlayerIndex];
+		if(Player)
+		{
+			QueueToClient(Shard, Player, Shared);
+		}
+	}
+	for(client_connection* Spectator = Room->FirstSpectator;
+			Spectator;
+			Spectator = Spectator->NextSpectator)
+	{
+		QueueToClient(Shard, Spectator, Shared);
+	}
+	ReleaseSharedMessage(&Shard->MessagePool, Shared);
+
+	++Shard->Metrics.Counters[ServerCounter_Broadcasts];
+	RecordElapsedTime(&Shard->Metrics, ServerHistogram_Broadcast, StartCounter, Shard->CounterFrequency);
+}
+
+internal void
+BuildContextUpdate(game_room* Room, u64 NowMS, network_synchess_message* Message)
+{
+	chess_game_context* ChessContext = &Room->ChessContext;
+	Message->Type = NetworkMessageType_ChessContextUpdate;
+	Message->ContextUpdate.NewBoardConfig = WriteConfig(ChessContext->Chessboard);
+	Message->ContextUpdate.CastlingPieceTracker[0] = ChessContext->CastlingPieceTracker[0];
+	Message->ContextUpdate.CastlingPieceTracker[1] = ChessContext->CastlingPieceTracker[1];
+	Message->ContextUpdate.PlayerCheck = ChessContext->PlayerCheck;
+
+	Message->ContextUpdate.LastDoubleStepCol = ChessContext->LastDoubleStepCol;
+	Message->ContextUpdate.PlayerToPlay = ChessContext->PlayerToPlay;
+
+	Message->ContextUpdate.ClockMS[PieceColor_White] = GetClockRemainingMS(Room, PieceColor_White, NowMS);
+	Message->ContextUpdate.ClockMS[PieceColor_Black] = GetClockRemainingMS(Room, PieceColor_Black, NowMS);
+	Message->ContextUpdate.TimeControl = Room->Clock.TimeControl;
+	Message->ContextUpdate.MoveSequence = Room->MoveCount;
+	Message->ContextUpdate.PositionHash = GetPositionHash(ChessContext);
+}
+
+internal void
+AddSpectator(game_room* Room, client_connection* Client)
+{
+	Client->Room = Room;
+	Client->Color = PieceColor_Count;
+	Client->PrevSpectator = 0;
+	Client->NextSpectator = Room->FirstSpectator;
+	if(Room->FirstSpectator)
+	{
+		Room->FirstSpectator->PrevSpectator = Client;
+	}
+	Room->FirstSpectator = Client;
+	++Room->SpectatorCount;
+}
+
+internal void
+RemoveSpectator(game_room* Room, client_connection* Client)
+{
+	if(Client->PrevSpectator)
+	{
+		Client->PrevSpectator->NextSpectator = Client->NextSpectator;
+	}
+	else
+	{
+		Room->FirstSpectator = Client->NextSpectator;
+	}
+	if(Client->NextSpectator)
+	{
+		Client->NextSpectator->PrevSpectator = Client->PrevSpectator;
+	}
+	Client->NextSpectator = Client->PrevSpectator = 0;
+	Client->Room = 0;
+	--Room->SpectatorCount;
+}
+
+internal void
+CloseRoom(server_shard* Shard, game_room* Room)
+{
+	StopRoomClock(Room, &Shard->TimerWheel);
+	CancelTimer(&Shard->TimerWheel, &Room->AbandonTimer);
+
+	// NOTE(hugo) : The players and spectators keep their connection,
+	// they are just not seated anywhere anymore.
+	for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Players); ++PlayerIndex)
+	{
+		client_connection* Player = Room->Players[PlayerIndex];
+		if(Player)
+		{
+			Player->Room = 0;
+		}
+	}
+	while(Room->FirstSpectator)
+	{
+		RemoveSpectator(Room, Room->FirstSpectator);
+	}
+	if(Room->HasStarted)
+	{
+		++Shard->Metrics.Counters[ServerCounter_GamesEnded];
+		JournalGameEnded(&Shard->ServerState->Journal, Room->GameID, Room->ChessContext.Result);
+		LogEvent(Shard->LogRing, LogEvent_GameEnded, Room->GameID, Room->ChessContext.Result);
+	}
+
+	u64 ArenaUsed = Room->Arena.Used;
+	ReleaseRoom(&Shard->RoomPool, Room);
+
+	game_room_pool_stats* Stats = &Shard->RoomPool.Stats;
+	LogEvent(Shard->LogRing, LogEvent_RoomReleased, Room->RoomIndex, (u32)ArenaUsed,
+			Stats->ActiveRoomCount, Stats->HighWaterRoomCount, (u32)Stats->HighWaterArenaUsed);
+}
+
+// NOTE(hugo) : The player lost its connexion. The game goes on, clock
+// included, and the seat is kept for the player until the grace delay
+// runs out.
+internal void
+LeaveSeat(server_shard* Shard, game_room* Room, client_connection* Client)
+{
+	u32 ResumeGraceMS = Shard->ServerState->Config.ResumeGraceMS;
+	if(!Room->HasStarted)
+	{
+		CloseRoom(Shard, Room);
+	}
+	else
+	{
+		Room->Players[Client->Color] = 0;
+		--Room->PlayerCount;
+		Client->Room = 0;
+		// NOTE(hugo) : The player does not know about it once back.
+		Room->Premoves[Client->Color].Type = MoveType_None;
+		// NOTE(hugo) : Without any grace the timer fires at the next tick,
+		// and the opponent is told the game is over as for any abandon.
+		if(!Room->AbandonTimer.IsScheduled)
+		{
+			ScheduleTimer(&Shard->TimerWheel, &Room->AbandonTimer,
+					GetTimerDeadlineTick(GetServerTimeMS() + ResumeGraceMS), Room);
+		}
+		LogEvent(Shard->LogRing, LogEvent_PlayerLeft, Room->GameID, Client->Color);
+	}
+}
+
+// NOTE(hugo) : Frees the slot of the client. The socket is kept open
+// when the connexion goes on living on another shard.
+internal void
+DetachClient(server_shard* Shard, client_connection* Client, bool ShouldCloseSocket)
+{
+	game_room* Room = Client->Room;
+	if(Room)
+	{
+		if(Client->Color == PieceColor_Count)
+		{
+			RemoveSpectator(Room, Client);
+		}
+		else
+		{
+			LeaveSeat(Shard, Room, Client);
+		}
+	}
+
+	ClearOutboundQueue(&Client->Outbound, &Shard->MessagePool);
+	if(ShouldCloseSocket)
+	{
+		ClosePeer(Client->Socket, &Client->Local);
+		++Shard->Metrics.Counters[ServerCounter_ConnectionsClosed];
+	}
+	else
+	{
+		++Shard->Metrics.Counters[ServerCounter_ConnectionsHandedOff];
+	}
+	*Client = {};
+	--Shard->CurrentClientCount;
+	SDL_AtomicAdd(&Shard->LoadCount, -1);
+}
+
+internal void
+DisconnectClient(server_shard* Shard, client_connection* Client)
+{
+	DetachClient(Shard, Client, true);
+}
+
+internal void
+FlagRoom(server_shard* Shard, game_room* Room)
+{
+	piece_color FlaggedColor = Room->ChessContext.PlayerToPlay;
+	Room->Clock.RemainingMS[FlaggedColor] = 0;
+	if(!CanStillMate(&Room->ChessContext, OtherColor(FlaggedColor)))
+	{
+		Room->ChessContext.Result = GameResult_Draw;
+	}
+	else
+	{
+		Room->ChessContext.Result = (FlaggedColor == PieceColor_White) ?
+			GameResult_BlackWins : GameResult_WhiteWins;
+	}
+
+	network_synchess_message Message = {};
+	Message.Type = NetworkMessageType_FlagFall;
+	Message.FlagFall.FlaggedColor = FlaggedColor;
+	Message.FlagFall.Result = Room->ChessContext.Result;
+	BroadcastToRoom(Shard, Room, &Message);
+	++Shard->Metrics.Counters[ServerCounter_FlagFalls];
+
+	LogEvent(Shard->LogRing, LogEvent_FlagFell, Room->GameID, FlaggedColor);
+	CloseRoom(Shard, Room);
+}
+
+// NOTE(hugo) : Nobody came back in time. The one who is missing loses
+// as if its flag fell, and a game both players left has no result.
+internal void
+AbandonRoom(server_shard* Shard, game_room* Room)
+{
+	piece_color MissingColor = PieceColor_Count;
+	for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Players); ++PlayerIndex)
+	{
+		if(!Room->Players[PlayerIndex])
+		{
+			MissingColor = (MissingColor == PieceColor_Count) ? (piece_color)PlayerIndex : PieceColor_Count;
+		}
+	}
+
+	if(MissingColor != PieceColor_Count)
+	{
+		Room->ChessContext.Result = (MissingColor == PieceColor_White) ?
+			GameResult_BlackWins : GameResult_WhiteWins;
+
+		network_synchess_message Message = {};
+		Message.Type = NetworkMessageType_FlagFall;
+		Message.FlagFall.FlaggedColor = MissingColor;
+		Message.FlagFall.Result = Room->ChessContext.Result;
+		BroadcastToRoom(Shard, Room, &Message);
+	}
+
+	LogEvent(Shard->LogRing, LogEvent_GameAbandoned, Room->GameID, MissingColor);
+	CloseRoom(Shard, Room);
+}
+
+internal game_room*
+FindRoomByGameID(server_shard* Shard, u32 GameID)
+{
+	game_room* Result = 0;
+	game_room_pool* Pool = &Shard->RoomPool;
+	for(u32 RoomIndex = 0; (!Result) && (RoomIndex < Pool->RoomCount); ++RoomIndex)
+	{
+		game_room* Room = Pool->Rooms + RoomIndex;
+		if(Room->IsActive && Room->HasStarted && (Room->GameID == GameID))
+		{
+			Result = Room;
+		}
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Best effort, the socket buffer is empty at this point.
+internal void
+RejectConnection(handed_connection* Connection)
+{
+	network_synchess_message Message = {};
+	Message.Type = NetworkMessageType_NoRoomForClient;
+	send_slice Slice = {&Message, sizeof(Message)};
+	SendSlicesToPeer(Connection->Socket, &Connection->Local, &Slice, 1);
+	ClosePeer(Connection->Socket, &Connection->Local);
+}
+
+// NOTE(hugo) : Any thread. Returns false if the shard is swamped.
+internal bool
+PushHandoff(server_shard* Shard, connection_handoff* Handoff)
+{
+	bool Result = PushMPSCQueue(&Shard->HandoffQueue, Handoff);
+	if(Result)
+	{
+		SendWakeup(Shard->WakeupSender);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Round-robin over the shards that have room for SlotCount
+// more clients. Each thread that hands connexions out has its own cursor.
+internal server_shard*
+PickShard(server_state* ServerState, u32* NextShardIndex, u32 SlotCount)
+{
+	server_shard* Result = 0;
+	for(u32 TryIndex = 0; (!Result) && (TryIndex < ServerState->ShardCount); ++TryIndex)
+	{
+		server_shard* Shard = ServerState->Shards + *NextShardIndex;
+		*NextShardIndex = (*NextShardIndex + 1) % ServerState->ShardCount;
+		if((u32)SDL_AtomicGet(&Shard->LoadCount) + SlotCount <= Shard->ClientCapacity)
+		{
+			Result = Shard;
+		}
+	}
+	if(!Result)
+	{
+		// NOTE(hugo) : Everyone is full, the shard will turn them down.
+		Result = ServerState->Shards + *NextShardIndex;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Gets the connexion ready to leave the shard. It cannot
+// while messages are still queued for it, since those belong to this
+// shard's pool, so the queue is flushed first.
+internal bool
+PrepareConnectionHandoff(server_shard* Shard, client_connection* Client, handed_connection* Connection)
+{
+	if(!Client->IsWriteBlocked && (GetOutboundQueueCount(&Client->Outbound) > 0))
+	{
+		FlushOutboundQueue(Client->Socket, &Client->Local, &Client->Outbound, &Shard->MessagePool);
+		++Shard->Metrics.Counters[ServerCounter_Sends];
+	}
+
+	bool Result = false;
+	if(!Client->ShouldDisconnect && (GetOutboundQueueCount(&Client->Outbound) == 0))
+	{
+		Connection->Socket = Client->Socket;
+		Connection->PeerIP = Client->PeerIP;
+		Connection->Local = Client->Local;
+		Connection->MessageBucket = Client->MessageBucket;
+		Connection->InboundSize = Client->InboundSize;
+		memcpy(Connection->InboundBuffer, Client->InboundBuffer, Client->InboundSize);
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Moves the connexion to the shard that owns the game, which
+// handles the message from there. Returns false if it has to stay here.
+internal bool
+ForwardToGameShard(server_shard* Shard, client_connection* Client, u32 GameID, network_synchess_message* Message)
+{
+	server_state* ServerState = Shard->ServerState;
+	server_shard* TargetShard = ServerState->Shards + GetGamePoolIndex(GameID, ServerState->ShardCount);
+
+	bool Result = false;
+	connection_handoff Handoff = {};
+	Handoff.Type = ConnectionHandoff_Forward;
+	Handoff.Message = *Message;
+	Handoff.ConnectionCount = 1;
+	if(PrepareConnectionHandoff(Shard, Client, Handoff.Connections) &&
+			PushHandoff(TargetShard, &Handoff))
+	{
+		DetachClient(Shard, Client, false);
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Hands the player to the matchmaker. Returns false if it has to stay here.
+internal bool
+HandOffToMatchmaking(server_shard* Shard, client_connection* Client, network_message_join_game* JoinGame)
+{
+	server_state* ServerState = Shard->ServerState;
+	matchmaking_state* Matchmaking = &ServerState->Matchmaking;
+
+	matchmaking_ticket Ticket = {};
+	Ticket.Rating = JoinGame->Rating;
+	Ticket.TimeControl = JoinGame->TimeControl;
+	if(Ticket.TimeControl.BaseMS == 0)
+	{
+		Ticket.TimeControl = ServerState->Config.TimeControl;
+	}
+
+	bool Result = false;
+	if(PrepareConnectionHandoff(Shard, Client, &Ticket.Connection) &&
+			PushMPSCQueue(&Matchmaking->TicketQueue, &Ticket))
+	{
+		SendWakeup(Matchmaking->WakeupSender);
+		DetachClient(Shard, Client, false);
+		Result = true;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Never 0, which is the token of an empty seat.
+internal u32
+GenerateReconnectToken(server_shard* Shard)
+{
+	// NOTE(hugo) : splitmix64 of a sequence that starts at the counter
+	// of when the shard started.
+	u32 Result = 0;
+	while(Result == 0)
+	{
+		Shard->TokenRandomState += 0x9E3779B97F4A7C15ULL;
+		u64 X = Shard->TokenRandomState;
+		X = (X ^ (X >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		X = (X ^ (X >> 27)) * 0x94D049BB133111EBULL;
+		X = X ^ (X >> 31);
+		Result = (u32)(X >> 32);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Seats the player again in the game it lost the connexion
+// to, and sends it what it missed : the last moves if there are few
+// enough of them, the whole position otherwise.
+internal void
+ResumeSeat(server_shard* Shard, game_room* Room, client_connection* Client, piece_color Color, u32 LastMoveSequence)
+{
+	client_connection* Stale = Room->Players[Color];
+	if(Stale)
+	{
+		// NOTE(hugo) : The old connexion is most likely half-open (the
+		// player changed networks) and we did not notice yet.
+		Stale->Room = 0;
+		Stale->ShouldDisconnect = true;
+		--Room->PlayerCount;
+	}
+	Client->Room = Room;
+	Client->Color = Color;
+	Room->Players[Color] = Client;
+	++Room->PlayerCount;
+
+	u64 NowMS = GetServerTimeMS();
+	if(Room->PlayerCount == ArrayCount(Room->Players))
+	{
+		CancelTimer(&Shard->TimerWheel, &Room->AbandonTimer);
+		ResumeRoomClock(Room, &Shard->TimerWheel, NowMS);
+	}
+
+	network_synchess_message Answer = {};
+	Answer.Type = NetworkMessageType_GameResumed;
+	network_message_game_resumed* Resumed = &Answer.GameResumed;
+	Resumed->GivenColor = Color;
+	Resumed->GameID = Room->GameID;
+	Resumed->MoveSequence = Room->MoveCount;
+	Resumed->ClockMS[PieceColor_White] = GetClockRemainingMS(Room, PieceColor_White, NowMS);
+	Resumed->ClockMS[PieceColor_Black] = GetClockRemainingMS(Room, PieceColor_Black, NowMS);
+	if((LastMoveSequence <= Room->MoveCount) &&
+			(Room->MoveCount - LastMoveSequence <= RESUME_MAX_TAIL_MOVE_COUNT))
+	{
+		Resumed->TailMoveCount = Room->MoveCount - LastMoveSequence;
+		memcpy(Resumed->TailMoves, Room->MoveHistory + LastMoveSequence,
+				Resumed->TailMoveCount * sizeof(move_params));
+	}
+	else
+	{
+		Resumed->IsSnapshotFollowing = true;
+	}
+	SendToClient(Shard, Client, &Answer);
+
+	if(Resumed->IsSnapshotFollowing)
+	{
+		network_synchess_message Snapshot = {};
+		BuildContextUpdate(Room, NowMS, &Snapshot);
+		SendToClient(Shard, Client, &Snapshot);
+	}
+
+	LogEvent(Shard->LogRing, LogEvent_PlayerResumed, Room->GameID, Color,
+			Resumed->TailMoveCount, Resumed->IsSnapshotFollowing);
+}
+
+// NOTE(hugo) : Seats the two players of a pair and starts their game.
+internal void
+StartMatchedGame(server_shard* Shard, game_room* Room, client_connection** Players, time_control TimeControl)
+{
+	server_state* ServerState = Shard->ServerState;
+	Room->HasStarted = true;
+	Room->GameID = Shard->NextGameID;
+	Shard->NextGameID += ServerState->ShardCount;
+	for(u32 PlayerIndex = 0; PlayerIndex < ArrayCount(Room->Players); ++PlayerIndex)
+	{
+		client_connection* Client = Players[PlayerIndex];
+		Client->Room = Room;
+		Client->Color = (piece_color)PlayerIndex;
+		Room->Players[PlayerIndex] = Client;
+		Room->ReconnectTokens[PlayerIndex] = GenerateReconnectToken(Shard);
+		++Room->PlayerCount;
+
+		network_synchess_message Answer = {};
+		Answer.Type = NetworkMessageType_ConnectionEstablished;
+		Answer.ConnectionEstablished.GivenColor = Client->Color;
+		Answer.ConnectionEstablished.ReconnectToken = Room->ReconnectTokens[PlayerIndex];
+		SendToClient(Shard, Client, &Answer);
+	}
+
+	StartRoomClock(Room, &Shard->TimerWheel, TimeControl, GetServerTimeMS());
+	JournalGameCreated(&ServerState->Journal, Room);
+	++Shard->Metrics.Counters[ServerCounter_GamesStarted];
+
+	// NOTE(hugo) : Broadcast to all that the game has started.
+	network_synchess_message Started = {};
+	Started.Type = NetworkMessageType_GameStarted;
+	Started.GameStarted.GameID = Room->GameID;
+	BroadcastToRoom(Shard, Room, &Started);
+
+	LogEvent(Shard->LogRing, LogEvent_GameStarted, Room->GameID, Room->RoomIndex);
+}
+
+// NOTE(hugo) : Everything that goes with a move of the player to play,
+// but the broadcast.
+internal void
+PlayRoomMove(server_shard* Shard, game_room* Room, move_params Move)
+{
+	u64 StartCounter = SDL_GetPerformanceCounter();
+	chess_game_context* ChessContext = &Room->ChessContext;
+	piece_color Mover = ChessContext->PlayerToPlay;
+	ApplyMove(ChessContext, Move, &Room->Arena);
+	PushMoveHistory(Room, Move);
+
+	// NOTE(hugo) : A game that outgrows its slab is adjudicated
+	// a draw rather than taking the whole server down.
+	if((ChessContext->Result == GameResult_None) && IsRoomExhausted(Room))
+	{
+		ChessContext->Result = GameResult_Draw;
+	}
+	++Shard->Metrics.Counters[ServerCounter_MovesApplied];
+	RecordElapsedTime(&Shard->Metrics, ServerHistogram_ApplyMove, StartCounter, Shard->CounterFrequency);
+
+	JournalMove(&Shard->ServerState->Journal, Room->GameID, Move, Room->Clock.RemainingMS[Mover]);
+}
+
+// NOTE(hugo) : Plays the move of the player to play, then the premove
+// of the other player if it is still legal, and tells the room about
+// both at once. The premove player used no time on its turn.
+internal void
+PlayTurn(server_shard* Shard, game_room* Room, move_params Move)
+{
+	u64 NowMS = GetServerTimeMS();
+	if(!PunchRoomClock(Room, &Shard->TimerWheel, NowMS))
+	{
+		// NOTE(hugo) : The move came in after the flag fell,
+		// the timer just did not get to it yet.
+		FlagRoom(Shard, Room);
+		return;
+	}
+
+	chess_game_context* ChessContext = &Room->ChessContext;
+	PlayRoomMove(Shard, Room, Move);
+
+	move_params* Premove = Room->Premoves + ChessContext->PlayerToPlay;
+	if(Premove->Type != MoveType_None)
+	{
+		if((ChessContext->Result == GameResult_None) &&
+				IsMoveLegal(ChessContext, *Premove, &Room->Arena) &&
+				PunchRoomClock(Room, &Shard->TimerWheel, NowMS))
+		{
+			++Shard->Metrics.Counters[ServerCounter_PremovesPlayed];
+			PlayRoomMove(Shard, Room, *Premove);
+		}
+		else
+		{
+			++Shard->Metrics.Counters[ServerCounter_PremovesDropped];
+		}
+		Premove->Type = MoveType_None;
+	}
+
+	network_synchess_message Update = {};
+	BuildContextUpdate(Room, NowMS, &Update);
+	BroadcastToRoom(Shard, Room, &Update);
+
+	if(ChessContext->Result != GameResult_None)
+	{
+		network_synchess_message Ended = {};
+		Ended.Type = NetworkMessageType_GameEnded;
+		Ended.GameEnded.Result = ChessContext->Result;
+		BroadcastToRoom(Shard, Room, &Ended);
+		CloseRoom(Shard, Room);
+	}
+}
+
+internal void
+HandleClientMessage(server_shard* Shard, client_connection* Client, network_synchess_message* Message)
+{
+	server_state* ServerState = Shard->ServerState;
+	switch(Message->Type)
+	{
+		case NetworkMessageType_ConnectionEstablished:
+		case NetworkMessageType_Quit:
+		case NetworkMessageType_NoRoomForClient:
+		case NetworkMessageType_ChessContextUpdate:
+		case NetworkMessageType_GameStarted:
+		case NetworkMessageType_FlagFall:
+		case NetworkMessageType_GameResumed:
+		case NetworkMessageType_GameEnded:
+			{
+				// NOTE(hugo) : Client should not send this, IsClientMessageValid
+				// cuts off the clients that do.
+				InvalidCodePath;
+			} break;
+		case NetworkMessageType_JoinGame:
+			{
+				if(Client->Room)
+				{
+					// NOTE(hugo) : Already seated or watching.
+					break;
+				}
+
+				if(!HandOffToMatchmaking(Shard, Client, &Message->JoinGame))
+				{
+					network_synchess_message Answer = {};
+					Answer.Type = NetworkMessageType_NoRoomForClient;
+					SendToClient(Shard, Client, &Answer);
+				}
+			} break;
+		case NetworkMessageType_SpectateGame:
+			{
+				if(Client->Room)
+				{
+					break;
+				}
+
+				u32 GameID = Message->SpectateGame.GameID;
+				if((GetGamePoolIndex(GameID, ServerState->ShardCount) != Shard->ShardIndex) &&
+						ForwardToGameShard(Shard, Client, GameID, Message))
+				{
+					// NOTE(hugo) : The owning shard answers from now on.
+					break;
+				}
+
+				game_room* Room = FindRoomByGameID(Shard, GameID);
+				if(!Room)
+				{
+					network_synchess_message Answer = {};
+					Answer.Type = NetworkMessageType_NoRoomForClient;
+					SendToClient(Shard, Client, &Answer);
+					break;
+				}
+
+				AddSpectator(Room, Client);
+
+				network_synchess_message Answer = {};
+				Answer.Type = NetworkMessageType_ConnectionEstablished;
+				Answer.ConnectionEstablished.GivenColor = PieceColor_Count;
+				SendToClient(Shard, Client, &Answer);
+
+				Answer = {};
+				Answer.Type = NetworkMessageType_GameStarted;
+				Answer.GameStarted.GameID = Room->GameID;
+				SendToClient(Shard, Client, &Answer);
+
+				// NOTE(hugo) : The spectator might join in the middle of the game.
+				Answer = {};
+				BuildContextUpdate(Room, GetServerTimeMS(), &Answer);
+				SendToClient(Shard, Client, &Answer);
+			} break;
+		case NetworkMessageType_ResumeGame:
+			{
+				if(Client->Room)
+				{
+					break;
+				}
+
+				network_message_resume_game* Resume = &Message->ResumeGame;
+				if((GetGamePoolIndex(Resume->GameID, ServerState->ShardCount) != Shard->ShardIndex) &&
+						ForwardToGameShard(Shard, Client, Resume->GameID, Message))
+				{
+					break;
+				}
+
+				game_room* Room = FindRoomByGameID(Shard, Resume->GameID);
+				piece_color Color = PieceColor_Count;
+				for(u32 PlayerIndex = 0; Room && (PlayerIndex < ArrayCount(Room->ReconnectTokens)); ++PlayerIndex)
+				{
+					if(Resume->ReconnectToken && (Room->ReconnectTokens[PlayerIndex] == Resume->ReconnectToken))
+					{
+						Color = (piece_color)PlayerIndex;
+					}
+				}
+				if(Color == PieceColor_Count)
+				{
+					// NOTE(hugo) : The game is over, or this is not its player.
+					network_synchess_message Answer = {};
+					Answer.Type = NetworkMessageType_NoRoomForClient;
+					SendToClient(Shard, Client, &Answer);
+					break;
+				}
+
+				ResumeSeat(Shard, Room, Client, Color, Resume->LastMoveSequence);
+			} break;
+		case NetworkMessageType_MoveDone:
+			{
+				game_room* Room = Client->Room;
+				if(!Room || !Room->HasStarted || (Client->Color == PieceColor_Count))
+				{
+					// NOTE(hugo) : Game over or spectator.
+					break;
+				}
+
+				// NOTE(hugo) : Since premoves, a move can also cross on the network
+				// the premove of the same player that the server already played.
+				bool IsAccepted = (Client->Color == Room->ChessContext.PlayerToPlay) &&
+					(Message->MoveDone.MoveSequence == Room->MoveCount);
+				if(IsAccepted && !IsMoveLegal(&Room->ChessContext, Message->MoveDone.Move, &Room->Arena))
+				{
+					++Shard->Metrics.Counters[ServerCounter_IllegalMoves];
+					IsAccepted = false;
+				}
+				if(!IsAccepted)
+				{
+					// NOTE(hugo) : The client already played the move on its board,
+					// the position it gets back makes it take the move back.
+					network_synchess_message Snapshot = {};
+					BuildContextUpdate(Room, GetServerTimeMS(), &Snapshot);
+					SendToClient(Shard, Client, &Snapshot);
+					break;
+				}
+
+				PlayTurn(Shard, Room, Message->MoveDone.Move);
+			} break;
+		case NetworkMessageType_Premove:
+			{
+				game_room* Room = Client->Room;
+				if(!Room || !Room->HasStarted || (Client->Color == PieceColor_Count))
+				{
+					break;
+				}
+
+				move_params Premove = Message->Premove;
+				if(Client->Color != Room->ChessContext.PlayerToPlay)
+				{
+					Room->Premoves[Client->Color] = Premove;
+				}
+				else if((Premove.Type != MoveType_None) &&
+						IsMoveLegal(&Room->ChessContext, Premove, &Room->Arena))
+				{
+					// NOTE(hugo) : The opponent's move crossed the premove on the
+					// network. It is this player's turn already, so the premove
+					// is played as it would have been on arrival of that move.
+					++Shard->Metrics.Counters[ServerCounter_PremovesPlayed];
+					PlayTurn(Shard, Room, Premove);
+				}
+			} break;
+
+		InvalidDefaultCase;
+	}
+}
+
+internal bool
+IsMoveValid(move_params* Move)
+{
+	bool Result = (Move->Type > MoveType_None) && (Move->Type < MoveType_Count) &&
+		(Move->InitialP.x >= 0) && (Move->InitialP.x < 8) &&
+		(Move->InitialP.y >= 0) && (Move->InitialP.y < 8) &&
+		(Move->DestP.x >= 0) && (Move->DestP.x < 8) &&
+		(Move->DestP.y >= 0) && (Move->DestP.y < 8);
+	return(Result);
+}
+
+// NOTE(hugo) : Only looks at the message itself, whether it makes sense
+// in the game is for HandleClientMessage to say. A well-behaved client
+// never sends something that fails here.
+internal bool
+IsClientMessageValid(network_synchess_message* Message)
+{
+	bool Result = false;
+	switch(Message->Type)
+	{
+		case NetworkMessageType_JoinGame:
+			{
+				time_control* TimeControl = &Message->JoinGame.TimeControl;
+				Result = (TimeControl->BaseMS <= MAX_TIME_CONTROL_MS) &&
+					(TimeControl->IncrementMS <= MAX_TIME_CONTROL_MS) &&
+					(TimeControl->DelayMS <= MAX_TIME_CONTROL_MS);
+			} break;
+		case NetworkMessageType_SpectateGame:
+		case NetworkMessageType_ResumeGame:
+			{
+				Result = true;
+			} break;
+		case NetworkMessageType_MoveDone:
+			{
+				Result = IsMoveValid(&Message->MoveDone.Move);
+			} break;
+		case NetworkMessageType_Premove:
+			{
+				Result = (Message->Premove.Type == MoveType_None) || IsMoveValid(&Message->Premove);
+			} break;
+
+		default:
+			{
+				// NOTE(hugo) : A message of the server, or garbage.
+				Result = false;
+			} break;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : TCP is a stream, a message may arrive in several pieces
+// or several messages in one piece. Each message is taken out of the
+// buffer before being handled, so that a connexion handed over to
+// another shard only carries what comes after it.
+//
+// A client that sends garbage is cut off at once. One that sends too
+// much only has the messages over its limit dropped, until it goes on
+// long enough to bankrupt its bucket.
+internal void
+ProcessInboundMessages(server_shard* Shard, client_connection* Client)
+{
+	rate_limit* MessageLimit = &Shard->ServerState->Config.MessageLimit;
+	u64 NowMS = GetServerTimeMS();
+	u32 MessageSize = sizeof(network_synchess_message);
+	while(Client->IsConnected && !Client->ShouldDisconnect && (Client->InboundSize >= MessageSize))
+	{
+		u64 StartCounter = SDL_GetPerformanceCounter();
+		network_synchess_message Message = {};
+		memcpy(&Message, Client->InboundBuffer, MessageSize);
+		Client->InboundSize -= MessageSize;
+		memmove(Client->InboundBuffer, Client->InboundBuffer + MessageSize, Client->InboundSize);
+		RecordElapsedTime(&Shard->Metrics, ServerHistogram_Parse, StartCounter, Shard->CounterFrequency);
+
+		// NOTE(hugo) : A message was received
+		++Shard->Metrics.Counters[ServerCounter_MessagesReceived];
+		if(!IsClientMessageValid(&Message))
+		{
+			++Shard->Metrics.Counters[ServerCounter_MalformedMessages];
+			Client->ShouldDisconnect = true;
+			break;
+		}
+		if(!TakeToken(&Client->MessageBucket, MessageLimit, NowMS))
+		{
+			++Shard->Metrics.Counters[ServerCounter_RateLimitedMessages];
+			if(IsTokenBucketBankrupt(&Client->MessageBucket, MessageLimit))
+			{
+				++Shard->Metrics.Counters[ServerCounter_FloodDisconnects];
+				Client->ShouldDisconnect = true;
+			}
+			continue;
+		}
+
+		StartCounter = SDL_GetPerformanceCounter();
+		HandleClientMessage(Shard, Client, &Message);
+		RecordElapsedTime(&Shard->Metrics, ServerHistogram_Handle, StartCounter, Shard->CounterFrequency);
+	}
+}
+
+// NOTE(hugo) : Returns 0 if the shard is full.
+internal client_connection*
+AdoptConnection(server_shard* Shard, handed_connection* Connection)
+{
+	client_connection* Client = FindFreeClientSlot(Shard);
+	if(Client)
+	{
+		*Client = {};
+		Client->IsConnected = true;
+		Client->Socket = Connection->Socket;
+		Client->PeerIP = Connection->PeerIP;
+		Client->Local = Connection->Local;
+		Client->MessageBucket = Connection->MessageBucket;
+		Client->InboundSize = Connection->InboundSize;
+		memcpy(Client->InboundBuffer, Connection->InboundBuffer, Connection->InboundSize);
+		++Shard->CurrentClientCount;
+		SDL_AtomicAdd(&Shard->LoadCount, 1);
+		++Shard->Metrics.Counters[ServerCounter_ConnectionsAdopted];
+	}
+
+	return(Client);
+}
+
+internal void
+AdoptHandoff(server_shard* Shard, connection_handoff* Handoff)
+{
+	client_connection* Clients[ArrayCount(Handoff->Connections)] = {};
+	bool IsAdopted = true;
+	for(u32 ConnectionIndex = 0; ConnectionIndex < Handoff->ConnectionCount; ++ConnectionIndex)
+	{
+		Clients[ConnectionIndex] = AdoptConnection(Shard, Handoff->Connections + ConnectionIndex);
+		if(!Clients[ConnectionIndex])
+		{
+			// NOTE(hugo) : No room for the incoming connexion. Tell him we are full.
+			RejectConnection(Handoff->Connections + ConnectionIndex);
+			IsAdopted = false;
+		}
+	}
+
+	game_room* Room = 0;
+	if(IsAdopted && (Handoff->Type == ConnectionHandoff_Match))
+	{
+		Room = AcquireRoom(&Shard->RoomPool);
+		IsAdopted = (Room != 0);
+	}
+
+	if(IsAdopted)
+	{
+		switch(Handoff->Type)
+		{
+			case ConnectionHandoff_New:
+				{
+					LogEvent(Shard->LogRing, LogEvent_ClientConnected, (u32)(Clients[0] - Shard->Clients));
+				} break;
+			case ConnectionHandoff_Forward:
+				{
+					HandleClientMessage(Shard, Clients[0], &Handoff->Message);
+				} break;
+			case ConnectionHandoff_Match:
+				{
+					StartMatchedGame(Shard, Room, Clients, Handoff->TimeControl);
+				} break;
+
+			InvalidDefaultCase;
+		}
+	}
+	else
+	{
+		// NOTE(hugo) : Whoever made it in stays in the lobby.
+		for(u32 ConnectionIndex = 0; ConnectionIndex < Handoff->ConnectionCount; ++ConnectionIndex)
+		{
+			if(Clients[ConnectionIndex])
+			{
+				network_synchess_message Answer = {};
+				Answer.Type = NetworkMessageType_NoRoomForClient;
+				SendToClient(Shard, Clients[ConnectionIndex], &Answer);
+			}
+		}
+	}
+
+	// NOTE(hugo) : What came along with the handoff would otherwise
+	// wait for the next bytes on the socket.
+	for(u32 ConnectionIndex = 0; ConnectionIndex < Handoff->ConnectionCount; ++ConnectionIndex)
+	{
+		if(Clients[ConnectionIndex])
+		{
+			ProcessInboundMessages(Shard, Clients[ConnectionIndex]);
+		}
+	}
+}
+
+internal s32
+ShardThread(void* Data)
+{
+	server_shard* Shard = (server_shard*)Data;
+	// NOTE(hugo) : A full local ring does not make its doorbell writable,
+	// so the flush is simply tried again every timer tick.
+	bool HasLocalBacklog = false;
+	for(;;)
+	{
+		bool HasLocalInput = false;
+		u32 LocalClientCount = 0;
+		u32 PollCount = 0;
+		Shard->Polls[PollCount].fd = Shard->WakeupReceiver;
+		Shard->Polls[PollCount].events = POLLIN;
+		Shard->Polls[PollCount].revents = 0;
+		Shard->PolledClients[PollCount] = 0;
+		++PollCount;
+		for(u32 ClientIndex = 0; ClientIndex < Shard->ClientCapacity; ++ClientIndex)
+		{
+			client_connection* Client = Shard->Clients + ClientIndex;
+			if(Client->IsConnected)
+			{
+				if(IsLocalChannel(&Client->Local))
+				{
+					++LocalClientCount;
+					if(!PrepareLocalWait(&Client->Local))
+					{
+						HasLocalInput = true;
+					}
+				}
+
+				// NOTE(hugo) : Only ask for write-readiness when there is
+				// something waiting, otherwise poll would return right away.
+				Shard->Polls[PollCount].fd = Client->Socket;
+				Shard->Polls[PollCount].events = POLLIN | (Client->IsWriteBlocked ? POLLOUT : 0);
+				Shard->Polls[PollCount].revents = 0;
+				Shard->PolledClients[PollCount] = Client;
+				++PollCount;
+			}
+		}
+
+		// NOTE(hugo) : Wake up every tick while clocks are running.
+		s32 PollTimeoutMS = ((Shard->TimerWheel.ScheduledCount > 0) || HasLocalBacklog) ?
+			TIMER_WHEEL_TICK_MS : SERVER_POLL_TIMEOUT_MS;
+		if(HasLocalInput)
+		{
+			PollTimeoutMS = 0;
+		}
+		s32 ActiveSocketCount = PollSockets(Shard->Polls, PollCount, PollTimeoutMS);
+		Assert(ActiveSocketCount != -1);
+		u64 TickStartCounter = SDL_GetPerformanceCounter();
+
+		if(Shard->Polls[0].revents & POLLIN)
+		{
+			DrainWakeups(Shard->WakeupReceiver);
+		}
+
+		for(u32 PollIndex = 1; PollIndex < PollCount; ++PollIndex)
+		{
+			client_connection* Client = Shard->PolledClients[PollIndex];
+			s16 Events = Shard->Polls[PollIndex].revents;
+			if(!Client->IsConnected || Client->ShouldDisconnect)
+			{
+				continue;
+			}
+			if(Events & POLLOUT)
+			{
+				Client->IsWriteBlocked = false;
+			}
+			bool IsLocal = IsLocalChannel(&Client->Local);
+			if(IsLocal)
+			{
+				// NOTE(hugo) : Awake, the peer does not have to ring anymore.
+				EndLocalWait(&Client->Local);
+			}
+			if(!(Events & (POLLIN | POLLHUP | POLLERR)) &&
+					!(IsLocal && HasLocalInbound(&Client->Local)))
+			{
+				continue;
+			}
+
+			s32 ReceivedBytes = ReceiveFromPeer(Client->Socket, &Client->Local,
+					Client->InboundBuffer + Client->InboundSize,
+					INBOUND_BUFFER_SIZE - Client->InboundSize);
+			if(ReceivedBytes == SOCKET_WOULD_BLOCK)
+			{
+				continue;
+			}
+			if(ReceivedBytes <= 0)
+			{
+				// NOTE(hugo) : Connexion closed.
+				DisconnectClient(Shard, Client);
+				continue;
+			}
+
+			Client->InboundSize += ReceivedBytes;
+			Shard->Metrics.Counters[ServerCounter_BytesReceived] += ReceivedBytes;
+			ProcessInboundMessages(Shard, Client);
+		}
+
+		// NOTE(hugo) : Connexions handed over by the acceptor or by other shards.
+		connection_handoff Handoff;
+		while(PopMPSCQueue(&Shard->HandoffQueue, &Handoff))
+		{
+			AdoptHandoff(Shard, &Handoff);
+		}
+
+		u64 NowMS = GetServerTimeMS();
+		u64 NowTick = GetTimerTick(NowMS);
+		for(timer_entry* Timer = PopExpiredTimer(&Shard->TimerWheel, NowTick);
+				Timer;
+				Timer = PopExpiredTimer(&Shard->TimerWheel, NowTick))
+		{
+			game_room* Room = (game_room*)Timer->Data;
+			if(Timer == &Room->AbandonTimer)
+			{
+				AbandonRoom(Shard, Room);
+			}
+			else
+			{
+				FlagRoom(Shard, Room);
+			}
+		}
+
+		// NOTE(hugo) : Flush phase. Everything queued during this tick
+		// leaves in one gathered send per connexion. Whatever the kernel
+		// does not take stays queued until the socket is writable again.
+		u64 QueuedMessageCount = 0;
+		HasLocalBacklog = false;
+		for(u32 ClientIndex = 0; ClientIndex < Shard->ClientCapacity; ++ClientIndex)
+		{
+			client_connection* Client = Shard->Clients + ClientIndex;
+			if(!Client->IsConnected)
+			{
+				continue;
+			}
 
-#include "synchess.h"
-#include "synchess_network.h"
-#include "chess.cpp"
+			if(Client->ShouldDisconnect)
+			{
+				DisconnectClient(Shard, Client);
+			}
+			else if(!Client->IsWriteBlocked && (GetOutboundQueueCount(&Client->Outbound) > 0))
+			{
+				u64 StartCounter = SDL_GetPerformanceCounter();
+				s32 SentBytes = FlushOutboundQueue(Client->Socket, &Client->Local, &Client->Outbound, &Shard->MessagePool);
+				RecordElapsedTime(&Shard->Metrics, ServerHistogram_Flush, StartCounter, Shard->CounterFrequency);
+				++Shard->Metrics.Counters[ServerCounter_Sends];
+				if(SentBytes < 0)
+				{
+					DisconnectClient(Shard, Client);
+				}
+				else
+				{
+					Shard->Metrics.Counters[ServerCounter_BytesSent] += SentBytes;
+					if(GetOutboundQueueCount(&Client->Outbound) > 0)
+					{
+						if(IsLocalChannel(&Client->Local))
+						{
+							HasLocalBacklog = true;
+						}
+						else
+						{
+							Client->IsWriteBlocked = true;
+						}
+					}
+				}
+			}
 
-struct server_state
+			if(Client->IsConnected)
+			{
+				QueuedMessageCount += GetOutboundQueueCount(&Client->Outbound);
+			}
+		}
+		RecordElapsedTime(&Shard->Metrics, ServerHistogram_Tick, TickStartCounter, Shard->CounterFrequency);
+
+		if(NowMS - Shard->PublishedMetrics.LastPublishMS >= METRICS_PUBLISH_PERIOD_MS)
+		{
+			server_metrics* Metrics = &Shard->Metrics;
+			Metrics->Gauges[ServerGauge_Clients] = Shard->CurrentClientCount;
+			Metrics->Gauges[ServerGauge_LocalClients] = LocalClientCount;
+			Metrics->Gauges[ServerGauge_ActiveRooms] = Shard->RoomPool.Stats.ActiveRoomCount;
+			Metrics->Gauges[ServerGauge_QueuedMessages] = QueuedMessageCount;
+			Metrics->Gauges[ServerGauge_LiveSharedMessages] = Shard->MessagePool.LiveCount;
+			PublishMetrics(&Shard->PublishedMetrics, Metrics, NowMS);
+		}
+	}
+
+	return(0);
+}
+
+internal void
+InitialiseShard(server_state* ServerState, server_shard* Shard, u32 ShardIndex)
 {
-	memory_arena ServerArena;
+	memory_arena* Arena = &ServerState->ServerArena;
+	u32 ShardCount = ServerState->ShardCount;
 
-	chess_game_context ChessContext;
+	Shard->ShardIndex = ShardIndex;
+	Shard->ServerState = ServerState;
 
-	// NOTE(hugo) : Network stuff
-	SDLNet_SocketSet SocketSet;
-	TCPsocket ClientSockets[PieceColor_Count];
-	TCPsocket ServerSocket;
-	u32 CurrentClientCount;
+	InitialiseRoomPool(&Shard->RoomPool, (MAX_ROOM_COUNT + ShardCount - 1) / ShardCount, Arena);
+	InitialiseTimerWheel(&Shard->TimerWheel, GetTimerTick(GetServerTimeMS()));
+	Shard->TokenRandomState = SDL_GetPerformanceCounter() ^ ((u64)(ShardIndex + 1) << 48);
+	InitialiseSharedMessagePool(&Shard->MessagePool, Arena);
 
-	bool IsInitialised;
-};
+	InitialiseMPSCQueue(&Shard->HandoffQueue, SHARD_HANDOFF_QUEUE_SIZE, sizeof(connection_handoff), Arena);
+	OpenWakeupPair(&Shard->WakeupReceiver, &Shard->WakeupSender);
 
-struct game_memory
+	Shard->ClientCapacity = (MAX_CLIENT_COUNT + ShardCount - 1) / ShardCount;
+	Shard->Clients = PushArray(Arena, Shard->ClientCapacity, client_connection);
+	for(u32 ClientIndex = 0; ClientIndex < Shard->ClientCapacity; ++ClientIndex)
+	{
+		Shard->Clients[ClientIndex] = {};
+	}
+	Shard->CurrentClientCount = 0;
+	SDL_AtomicSet(&Shard->LoadCount, 0);
+
+	// NOTE(hugo) : One more for the wakeup socket.
+	Shard->Polls = PushArray(Arena, Shard->ClientCapacity + 1, socket_poll);
+	Shard->PolledClients = PushArray(Arena, Shard->ClientCapacity + 1, client_connection*);
+
+	Shard->CounterFrequency = SDL_GetPerformanceFrequency();
+	Shard->Metrics = {};
+	InitialisePublishedMetrics(&Shard->PublishedMetrics);
+}
+
+internal u32
+AllocateTicket(matchmaking_state* Matchmaking)
 {
-	u64 StorageSize;
-	void* Storage;
-};
+	u32 Result = Matchmaking->TicketCapacity;
+	for(u32 TicketIndex = 0; (Result == Matchmaking->TicketCapacity) && (TicketIndex < Matchmaking->TicketCapacity); ++TicketIndex)
+	{
+		if(!Matchmaking->IsTicketUsed[TicketIndex])
+		{
+			Matchmaking->IsTicketUsed[TicketIndex] = true;
+			Result = TicketIndex;
+		}
+	}
+
+	return(Result);
+}
+
+internal s32
+MatchmakingThread(void* Data)
+{
+	server_state* ServerState = (server_state*)Data;
+	matchmaking_state* Matchmaking = &ServerState->Matchmaking;
+	for(;;)
+	{
+		u32 PollCount = 0;
+		Matchmaking->Polls[PollCount].fd = Matchmaking->WakeupReceiver;
+		Matchmaking->Polls[PollCount].events = POLLIN;
+		Matchmaking->Polls[PollCount].revents = 0;
+		++PollCount;
+		for(u32 TicketIndex = 0; TicketIndex < Matchmaking->TicketCapacity; ++TicketIndex)
+		{
+			if(Matchmaking->IsTicketUsed[TicketIndex])
+			{
+				// NOTE(hugo) : Whatever the player sends while waiting is kept
+				// for its shard. A full buffer is only watched for hangups.
+				handed_connection* Connection = &Matchmaking->Tickets[TicketIndex].Connection;
+				Matchmaking->Polls[PollCount].fd = Connection->Socket;
+				Matchmaking->Polls[PollCount].events = (Connection->InboundSize < INBOUND_BUFFER_SIZE) ? POLLIN : 0;
+				Matchmaking->Polls[PollCount].revents = 0;
+				Matchmaking->PolledTickets[PollCount] = TicketIndex;
+				++PollCount;
+			}
+		}
+
+		s32 ActiveSocketCount = PollSockets(Matchmaking->Polls, PollCount, MATCHMAKING_TICK_MS);
+		Assert(ActiveSocketCount != -1);
+		u64 TickStartCounter = SDL_GetPerformanceCounter();
+
+		if(Matchmaking->Polls[0].revents & POLLIN)
+		{
+			DrainWakeups(Matchmaking->WakeupReceiver);
+		}
+
+		for(u32 PollIndex = 1; PollIndex < PollCount; ++PollIndex)
+		{
+			if(!(Matchmaking->Polls[PollIndex].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				continue;
+			}
+
+			u32 TicketIndex = Matchmaking->PolledTickets[PollIndex];
+			handed_connection* Connection = &Matchmaking->Tickets[TicketIndex].Connection;
+			s32 ReceivedBytes = ReceiveFromPeer(Connection->Socket, &Connection->Local,
+					Connection->InboundBuffer + Connection->InboundSize,
+					INBOUND_BUFFER_SIZE - Connection->InboundSize);
+			if(ReceivedBytes == SOCKET_WOULD_BLOCK)
+			{
+				continue;
+			}
+			if(ReceivedBytes <= 0)
+			{
+				// NOTE(hugo) : Left before finding an opponent.
+				RemoveMatchmakingEntry(&Matchmaking->Matchmaker, TicketIndex);
+				ClosePeer(Connection->Socket, &Connection->Local);
+				Matchmaking->IsTicketUsed[TicketIndex] = false;
+				continue;
+			}
+			Connection->InboundSize += ReceivedBytes;
+		}
+
+		u64 NowMS = GetServerTimeMS();
+		matchmaking_ticket Ticket;
+		while(PopMPSCQueue(&Matchmaking->TicketQueue, &Ticket))
+		{
+			u32 TicketIndex = AllocateTicket(Matchmaking);
+			if((TicketIndex < Matchmaking->TicketCapacity) &&
+					AddMatchmakingEntry(&Matchmaking->Matchmaker, Ticket.TimeControl, Ticket.Rating, NowMS, TicketIndex))
+			{
+				Matchmaking->Tickets[TicketIndex] = Ticket;
+			}
+			else
+			{
+				++Matchmaking->Metrics.Counters[ServerCounter_MatchmakingRejects];
+				// NOTE(hugo) : Too many players waiting, or too many time controls.
+				if(TicketIndex < Matchmaking->TicketCapacity)
+				{
+					Matchmaking->IsTicketUsed[TicketIndex] = false;
+				}
+				RejectConnection(&Ticket.Connection);
+			}
+		}
+
+		u32 PairCount = FindMatchmakingPairs(&Matchmaking->Matchmaker, NowMS,
+				Matchmaking->Pairs, Matchmaking->TicketCapacity / 2);
+		for(u32 PairIndex = 0; PairIndex < PairCount; ++PairIndex)
+		{
+			matchmaking_pair* Pair = Matchmaking->Pairs + PairIndex;
+
+			connection_handoff Handoff = {};
+			Handoff.Type = ConnectionHandoff_Match;
+			Handoff.TimeControl = Pair->TimeControl;
+			Handoff.ConnectionCount = ArrayCount(Pair->Entries);
+			for(u32 EntryIndex = 0; EntryIndex < ArrayCount(Pair->Entries); ++EntryIndex)
+			{
+				u32 TicketIndex = Pair->Entries[EntryIndex].TicketIndex;
+				Handoff.Connections[EntryIndex] = Matchmaking->Tickets[TicketIndex].Connection;
+				Matchmaking->IsTicketUsed[TicketIndex] = false;
+			}
+
+			server_shard* Shard = PickShard(ServerState, &Matchmaking->NextShardIndex, Handoff.ConnectionCount);
+			if(PushHandoff(Shard, &Handoff))
+			{
+				++Matchmaking->Metrics.Counters[ServerCounter_MatchesMade];
+				u64 WaitMS[ArrayCount(Pair->Entries)];
+				for(u32 EntryIndex = 0; EntryIndex < ArrayCount(Pair->Entries); ++EntryIndex)
+				{
+					WaitMS[EntryIndex] = NowMS - Pair->Entries[EntryIndex].EnqueueMS;
+					RecordLatency(Matchmaking->Metrics.Histograms + ServerHistogram_MatchWait, WaitMS[EntryIndex] * 1000000);
+				}
+				LogEvent(Matchmaking->LogRing, LogEvent_PlayersMatched,
+						Pair->Entries[0].Rating, Pair->Entries[1].Rating,
+						(u32)WaitMS[0], (u32)WaitMS[1], Shard->ShardIndex);
+			}
+			else
+			{
+				Matchmaking->Metrics.Counters[ServerCounter_MatchmakingRejects] += 2;
+				RejectConnection(Handoff.Connections + 0);
+				RejectConnection(Handoff.Connections + 1);
+			}
+		}
+		RecordElapsedTime(&Matchmaking->Metrics, ServerHistogram_Tick, TickStartCounter, Matchmaking->CounterFrequency);
+
+		if(NowMS - Matchmaking->PublishedMetrics.LastPublishMS >= METRICS_PUBLISH_PERIOD_MS)
+		{
+			Matchmaking->Metrics.Gauges[ServerGauge_WaitingPlayers] = Matchmaking->Matchmaker.EntryCount;
+			PublishMetrics(&Matchmaking->PublishedMetrics, &Matchmaking->Metrics, NowMS);
+		}
+	}
+
+	return(0);
+}
+
+internal void
+InitialiseMatchmaking(server_state* ServerState, matchmaking_state* Matchmaking)
+{
+	memory_arena* Arena = &ServerState->ServerArena;
+
+	InitialiseMPSCQueue(&Matchmaking->TicketQueue, MATCHMAKING_QUEUE_SIZE, sizeof(matchmaking_ticket), Arena);
+	OpenWakeupPair(&Matchmaking->WakeupReceiver, &Matchmaking->WakeupSender);
+
+	Matchmaking->TicketCapacity = MAX_CLIENT_COUNT;
+	InitialiseMatchmaker(&Matchmaking->Matchmaker, Matchmaking->TicketCapacity, Arena);
+	Matchmaking->Tickets = PushArray(Arena, Matchmaking->TicketCapacity, matchmaking_ticket);
+	Matchmaking->IsTicketUsed = PushArray(Arena, Matchmaking->TicketCapacity, bool);
+	for(u32 TicketIndex = 0; TicketIndex < Matchmaking->TicketCapacity; ++TicketIndex)
+	{
+		Matchmaking->IsTicketUsed[TicketIndex] = false;
+	}
+	Matchmaking->Pairs = PushArray(Arena, Matchmaking->TicketCapacity / 2, matchmaking_pair);
+	Matchmaking->NextShardIndex = 0;
+
+	// NOTE(hugo) : One more for the wakeup socket.
+	Matchmaking->Polls = PushArray(Arena, Matchmaking->TicketCapacity + 1, socket_poll);
+	Matchmaking->PolledTickets = PushArray(Arena, Matchmaking->TicketCapacity + 1, u32);
+	Matchmaking->CounterFrequency = SDL_GetPerformanceFrequency();
+	Matchmaking->Metrics = {};
+	InitialisePublishedMetrics(&Matchmaking->PublishedMetrics);
+}
+
+// NOTE(hugo) : Returns the size of the snapshot written in AdminText.
+internal u32
+WriteAdminSnapshot(server_state* ServerState)
+{
+	char* Text = ServerState->AdminText;
+	u32 TextSize = 0;
+	char Labels[64];
+
+	// NOTE(hugo) : Every thread on its own, then the whole server.
+	server_metrics Total = {};
+	server_metrics Metrics;
+	for(u32 ShardIndex = 0; ShardIndex < ServerState->ShardCount; ++ShardIndex)
+	{
+		ReadPublishedMetrics(&ServerState->Shards[ShardIndex].PublishedMetrics, &Metrics);
+		snprintf(Labels, sizeof(Labels), "thread=\"shard-%u\"", ShardIndex);
+		TextSize = AppendMetricsText(Text, TextSize, ADMIN_TEXT_SIZE, Labels, &Metrics);
+		MergeServerMetrics(&Total, &Metrics);
+	}
+	ReadPublishedMetrics(&ServerState->Matchmaking.PublishedMetrics, &Metrics);
+	TextSize = AppendMetricsText(Text, TextSize, ADMIN_TEXT_SIZE, "thread=\"matchmaking\"", &Metrics);
+	MergeServerMetrics(&Total, &Metrics);
+	TextSize = AppendMetricsText(Text, TextSize, ADMIN_TEXT_SIZE, "thread=\"acceptor\"", &ServerState->AcceptorMetrics);
+	MergeServerMetrics(&Total, &ServerState->AcceptorMetrics);
+
+	TextSize = AppendMetricsText(Text, TextSize, ADMIN_TEXT_SIZE, "thread=\"all\"", &Total);
+
+	return(TextSize);
+}
+
+internal void
+ServeAdminConnection(server_state* ServerState, platform_socket Socket)
+{
+	// NOTE(hugo) : Once in a while and local, so simply written out
+	// before closing, as far as the socket takes it.
+	u32 TextSize = WriteAdminSnapshot(ServerState);
+	u32 SentSize = 0;
+	while(SentSize < TextSize)
+	{
+		send_slice Slice = {ServerState->AdminText + SentSize, TextSize - SentSize};
+		s32 SentBytes = SendSlices(Socket, &Slice, 1);
+		if(SentBytes <= 0)
+		{
+			break;
+		}
+		SentSize += SentBytes;
+	}
+	CloseSocket(Socket);
+}
+
+// NOTE(hugo) : "50/100" is 50 per second with bursts of 100, a single
+// rate gets twice as much for its burst. 0 for no limit.
+internal rate_limit
+ParseRateLimit(char* Text)
+{
+	rate_limit Result = {};
+	Result.RatePerSecond = (u32)atoi(Text);
+	char* Slash = strchr(Text, '/');
+	Result.Burst = Slash ? (u32)atoi(Slash + 1) : 2 * Result.RatePerSecond;
+	if(Result.Burst < 1)
+	{
+		Result.Burst = 1;
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : "a.b.c.d" in host order, as AcceptConnection gives the
+// peer. 0 if the text is not an address.
+internal u32
+ParseIPv4(char* Text)
+{
+	u32 Result = 0;
+	u32 Bytes[4] = {};
+	char Trailing = 0;
+	if((sscanf(Text, "%u.%u.%u.%u%c", Bytes + 0, Bytes + 1, Bytes + 2, Bytes + 3, &Trailing) == 4) &&
+			(Bytes[0] < 256) && (Bytes[1] < 256) && (Bytes[2] < 256) && (Bytes[3] < 256))
+	{
+		Result = (Bytes[0] << 24) | (Bytes[1] << 16) | (Bytes[2] << 8) | Bytes[3];
+	}
+
+	return(Result);
+}
+
+internal bool
+IsConnectLimitExempt(server_config* Config, u32 PeerIP)
+{
+	bool Result = false;
+	for(u32 ExemptIndex = 0; ExemptIndex < Config->ConnectLimitExemptCount; ++ExemptIndex)
+	{
+		if(Config->ConnectLimitExemptIPs[ExemptIndex] == PeerIP)
+		{
+			Result = true;
+			break;
+		}
+	}
+
+	return(Result);
+}
 
 s32 main(s32 ArgumentCount, char** Arguments)
 {
-	// NOTE(hugo) : Init SDL_Net
-	s32 SDLNetInitResult = SDLNet_Init();
-	Assert(SDLNetInitResult != -1);
+	server_config Config = {};
+	Config.JournalPath = SYNCHESS_JOURNAL_PATH;
+	Config.EventLogPath = SYNCHESS_EVENT_LOG_PATH;
+	Config.OutboundHighWater = DEFAULT_OUTBOUND_HIGH_WATER;
+	Config.SpectatorPolicy = SlowConsumerPolicy_DropUpdates;
+	Config.TimeControl.BaseMS = DEFAULT_CLOCK_BASE_MS;
+	// NOTE(hugo) : One shard per core unless told otherwise.
+	Config.ShardCount = 0;
+	Config.AdminPort = SYNCHESS_ADMIN_PORT;
+	Config.ResumeGraceMS = DEFAULT_RESUME_GRACE_MS;
+	Config.MessageLimit.RatePerSecond = DEFAULT_MESSAGE_RATE;
+	Config.MessageLimit.Burst = DEFAULT_MESSAGE_BURST;
+	Config.ConnectLimit.RatePerSecond = DEFAULT_CONNECT_RATE;
+	Config.ConnectLimit.Burst = DEFAULT_CONNECT_BURST;
+	for(s32 ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+	{
+		char* Argument = Arguments[ArgumentIndex];
+		bool HasValue = (ArgumentIndex + 1 < ArgumentCount);
+		if((strcmp(Argument, "-journal") == 0) && HasValue)
+		{
+			Config.JournalPath = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Argument, "-events") == 0) && HasValue)
+		{
+			Config.EventLogPath = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Argument, "-highwater") == 0) && HasValue)
+		{
+			s32 HighWater = atoi(Arguments[++ArgumentIndex]);
+			if(HighWater < 1)
+			{
+				HighWater = 1;
+			}
+			if(HighWater > OUTBOUND_QUEUE_SIZE)
+			{
+				HighWater = OUTBOUND_QUEUE_SIZE;
+			}
+			Config.OutboundHighWater = (u32)HighWater;
+		}
+		else if((strcmp(Argument, "-slow-spectators") == 0) && HasValue)
+		{
+			char* Policy = Arguments[++ArgumentIndex];
+			Config.SpectatorPolicy = (strcmp(Policy, "disconnect") == 0) ?
+				SlowConsumerPolicy_Disconnect : SlowConsumerPolicy_DropUpdates;
+		}
+		else if((strcmp(Argument, "-clock") == 0) && HasValue)
+		{
+			// NOTE(hugo) : Usual notation, "5+3" is 5 minutes and 3 seconds of increment.
+			char* Clock = Arguments[++ArgumentIndex];
+			Config.TimeControl.BaseMS = (u32)(atof(Clock) * 60.0 * 1000.0);
+			char* Increment = strchr(Clock, '+');
+			Config.TimeControl.IncrementMS = Increment ? (u32)(atof(Increment + 1) * 1000.0) : 0;
+		}
+		else if((strcmp(Argument, "-delay") == 0) && HasValue)
+		{
+			Config.TimeControl.DelayMS = (u32)(atof(Arguments[++ArgumentIndex]) * 1000.0);
+		}
+		else if((strcmp(Argument, "-threads") == 0) && HasValue)
+		{
+			Config.ShardCount = (u32)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-grace") == 0) && HasValue)
+		{
+			Config.ResumeGraceMS = (u32)(atof(Arguments[++ArgumentIndex]) * 1000.0);
+		}
+		else if((strcmp(Argument, "-admin-port") == 0) && HasValue)
+		{
+			Config.AdminPort = (u16)atoi(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-local") == 0) && HasValue)
+		{
+			Config.LocalPath = Arguments[++ArgumentIndex];
+		}
+		else if((strcmp(Argument, "-message-limit") == 0) && HasValue)
+		{
+			Config.MessageLimit = ParseRateLimit(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-connect-limit") == 0) && HasValue)
+		{
+			Config.ConnectLimit = ParseRateLimit(Arguments[++ArgumentIndex]);
+		}
+		else if((strcmp(Argument, "-connect-limit-exempt") == 0) && HasValue)
+		{
+			char* Address = Arguments[++ArgumentIndex];
+			u32 ExemptIP = ParseIPv4(Address);
+			if(!ExemptIP || (Config.ConnectLimitExemptCount == MAX_CONNECT_LIMIT_EXEMPT_COUNT))
+			{
+				printf("Ignoring the connect limit exemption for %s.\n", Address);
+			}
+			else
+			{
+				Config.ConnectLimitExemptIPs[Config.ConnectLimitExemptCount++] = ExemptIP;
+			}
+		}
+		else if(strcmp(Argument, "-nagle") == 0)
+		{
+			Config.IsNagleEnabled = true;
+		}
+	}
+	if(Config.ShardCount == 0)
+	{
+		Config.ShardCount = (u32)SDL_GetCPUCount();
+	}
+	if(Config.ShardCount < 1)
+	{
+		Config.ShardCount = 1;
+	}
+	if(Config.ShardCount > MAX_SHARD_COUNT)
+	{
+		Config.ShardCount = MAX_SHARD_COUNT;
+	}
+
+	InitialiseSockets();
 
 	game_memory ServerMemory = {};
 	ServerMemory.StorageSize = Megabytes(512);
 	ServerMemory.Storage = Allocate_(ServerMemory.StorageSize);
 	Assert(ServerMemory.Storage);
-	
+
 	bool Running = true;
 	while(Running)
 	{
@@ -56,166 +1918,207 @@ s32 main(s32 ArgumentCount, char** Arguments)
 		server_state* ServerState = (server_state*) ServerMemory.Storage;
 		if(!ServerState->IsInitialised)
 		{
-			// NOTE(hugo) : Network init
-			// {
-			u32 MaxSocketCount = 3;
-			ServerState->SocketSet = SDLNet_AllocSocketSet(MaxSocketCount);
-			Assert(ServerState->SocketSet);
+			ServerState->Config = Config;
+
+			u64 ServerArenaSize = ServerMemory.StorageSize - sizeof(server_state);
+			void* ServerArenaBase = (u8*)ServerMemory.Storage + sizeof(server_state);
+			InitialiseArena(&ServerState->ServerArena, ServerArenaSize, ServerArenaBase);
 
-			//u32 MaxClientCount = MaxSocketCount - 1; // NOTE(hugo) : The server needs a socket.
-			ServerState->CurrentClientCount = 0;
+			ServerState->ShardCount = ServerState->Config.ShardCount;
+			ServerState->Shards = PushArray(&ServerState->ServerArena, ServerState->ShardCount, server_shard);
+			game_room_pool* RoomPools[MAX_SHARD_COUNT];
+			for(u32 ShardIndex = 0; ShardIndex < ServerState->ShardCount; ++ShardIndex)
+			{
+				server_shard* Shard = ServerState->Shards + ShardIndex;
+				*Shard = {};
+				InitialiseShard(ServerState, Shard, ShardIndex);
+				RoomPools[ShardIndex] = &Shard->RoomPool;
+			}
 
-			for(u32 ClientIndex = 0; ClientIndex < ArrayCount(ServerState->ClientSockets); ++ClientIndex)
+			// NOTE(hugo) : One ring per thread that logs, all known before the log starts.
+			matchmaking_state* Matchmaking = &ServerState->Matchmaking;
+			event_log* EventLog = &ServerState->EventLog;
+			for(u32 ShardIndex = 0; ShardIndex < ServerState->ShardCount; ++ShardIndex)
 			{
-				ServerState->ClientSockets[ClientIndex] = 0;
+				char RingName[EVENT_LOG_RING_NAME_SIZE];
+				snprintf(RingName, sizeof(RingName), "shard-%u", ShardIndex);
+				ServerState->Shards[ShardIndex].LogRing = AddLogRing(EventLog, RingName, &ServerState->ServerArena);
+			}
+			Matchmaking->LogRing = AddLogRing(EventLog, "matchmaking", &ServerState->ServerArena);
+			log_ring* MainLogRing = AddLogRing(EventLog, "main", &ServerState->ServerArena);
+			if(!StartEventLog(EventLog, ServerState->Config.EventLogPath))
+			{
+				printf("Cannot open %s, the events will not be logged.\n", ServerState->Config.EventLogPath);
+				for(u32 ShardIndex = 0; ShardIndex < ServerState->ShardCount; ++ShardIndex)
+				{
+					ServerState->Shards[ShardIndex].LogRing = 0;
+				}
+				Matchmaking->LogRing = 0;
+				MainLogRing = 0;
 			}
 
-			u32 ServerPort = SYNCHESS_PORT;
+			char* JournalPath = ServerState->Config.JournalPath;
+			u32 NextGameID = RecoverFromJournal(JournalPath, RoomPools, ServerState->ShardCount,
+					&ServerState->ServerArena, MainLogRing);
+			StartJournal(&ServerState->Journal, JournalPath, &ServerState->ServerArena);
+
+			for(u32 ShardIndex = 0; ShardIndex < ServerState->ShardCount; ++ShardIndex)
+			{
+				server_shard* Shard = ServerState->Shards + ShardIndex;
+				// NOTE(hugo) : First ID of this shard that was never handed out.
+				u32 NextGameShardIndex = GetGamePoolIndex(NextGameID, ServerState->ShardCount);
+				Shard->NextGameID = NextGameID +
+					(ShardIndex + ServerState->ShardCount - NextGameShardIndex) % ServerState->ShardCount;
+
+				// NOTE(hugo) : The recovered games wait for their players
+				// to resume like any game whose players left.
+				game_room_pool* Pool = &Shard->RoomPool;
+				for(u32 RoomIndex = 0; RoomIndex < Pool->RoomCount; ++RoomIndex)
+				{
+					game_room* Room = Pool->Rooms + RoomIndex;
+					if(Room->IsActive)
+					{
+						ScheduleTimer(&Shard->TimerWheel, &Room->AbandonTimer,
+								GetTimerDeadlineTick(GetServerTimeMS() + ServerState->Config.ResumeGraceMS), Room);
+					}
+				}
+				Shard->Thread = SDL_CreateThread(ShardThread, "SynchessShard", Shard);
+				Assert(Shard->Thread);
+			}
 
-			IPaddress ServerAddress;
-			s32 HostResolved = SDLNet_ResolveHost(&ServerAddress, 0, ServerPort);
-			Assert(HostResolved != -1);
+			InitialiseMatchmaking(ServerState, Matchmaking);
+			Matchmaking->Thread = SDL_CreateThread(MatchmakingThread, "SynchessMatchmaking", ServerState);
+			Assert(Matchmaking->Thread);
 
-			printf("Successfully resolved host server to IP 0x%08x, port 0x%04x.\n", ServerAddress.host, ServerAddress.port);
+			// NOTE(hugo) : Network init
+			// {
+			ServerState->NextShardIndex = 0;
 
-			ServerState->ServerSocket = SDLNet_TCP_Open(&ServerAddress);
-			Assert(ServerState->ServerSocket);
+			u16 ServerPort = SYNCHESS_PORT;
+			ServerState->ServerSocket = OpenListenSocket(ServerPort, false);
+			SetSocketNonBlocking(ServerState->ServerSocket);
+			printf("Listening on port %u with %u shards (outbound high-water : %u messages).\n",
+					ServerPort, ServerState->ShardCount, ServerState->Config.OutboundHighWater);
 
-			s32 AddSocketResult = SDLNet_TCP_AddSocket(ServerState->SocketSet, ServerState->ServerSocket);
-			Assert(AddSocketResult != -1);
-			// }
+			ServerState->AdminSocket = INVALID_PLATFORM_SOCKET;
+			if(ServerState->Config.AdminPort)
+			{
+				ServerState->AdminText = PushArray(&ServerState->ServerArena, ADMIN_TEXT_SIZE, char);
+				ServerState->AdminSocket = OpenListenSocket(ServerState->Config.AdminPort, true);
+				SetSocketNonBlocking(ServerState->AdminSocket);
+				printf("Metrics on 127.0.0.1:%u.\n", ServerState->Config.AdminPort);
+			}
 
-			u64 ServerArenaSize = Megabytes(128);
-			void* ServerArenaBase = (u8*)ServerMemory.Storage + sizeof(server_state);
-			InitialiseArena(&ServerState->ServerArena, ServerArenaSize, ServerArenaBase);
-			InitialiseChessContext(&ServerState->ChessContext, &ServerState->ServerArena);
+			ServerState->LocalSocket = INVALID_PLATFORM_SOCKET;
+			if(ServerState->Config.LocalPath)
+			{
+				ServerState->LocalSocket = OpenLocalListenSocket(ServerState->Config.LocalPath);
+				if(ServerState->LocalSocket != INVALID_PLATFORM_SOCKET)
+				{
+					SetSocketNonBlocking(ServerState->LocalSocket);
+					printf("Local connexions on %s.\n", ServerState->Config.LocalPath);
+				}
+				else
+				{
+					printf("Cannot listen on %s, TCP only.\n", ServerState->Config.LocalPath);
+				}
+			}
+			// }
 
 			ServerState->IsInitialised = true;
 		}
 
-		// NOTE(hugo) : Server loop
-
-		s32 ActiveSocketCount = SDLNet_CheckSockets(ServerState->SocketSet, 0);
+		// NOTE(hugo) : Acceptor loop, the games themselves run on the shards.
+		socket_poll ListenPolls[3] = {};
+		u32 ListenPollCount = 0;
+		ListenPolls[ListenPollCount].fd = ServerState->ServerSocket;
+		ListenPolls[ListenPollCount].events = POLLIN;
+		++ListenPollCount;
+		socket_poll* AdminPoll = 0;
+		if(ServerState->AdminSocket != INVALID_PLATFORM_SOCKET)
+		{
+			AdminPoll = ListenPolls + ListenPollCount;
+			AdminPoll->fd = ServerState->AdminSocket;
+			AdminPoll->events = POLLIN;
+			++ListenPollCount;
+		}
+		socket_poll* LocalPoll = 0;
+		if(ServerState->LocalSocket != INVALID_PLATFORM_SOCKET)
+		{
+			LocalPoll = ListenPolls + ListenPollCount;
+			LocalPoll->fd = ServerState->LocalSocket;
+			LocalPoll->events = POLLIN;
+			++ListenPollCount;
+		}
+		s32 ActiveSocketCount = PollSockets(ListenPolls, ListenPollCount, SERVER_POLL_TIMEOUT_MS);
 		Assert(ActiveSocketCount != -1);
 
-		s32 ServerSocketActivity = SDLNet_SocketReady(ServerState->ServerSocket);
-		Assert(ServerSocketActivity != -1);
-		if(ServerSocketActivity > 0)
+		if(AdminPoll && (AdminPoll->revents & POLLIN))
 		{
-			// NOTE(hugo) : An incoming connexion is pending
-			if(ServerState->CurrentClientCount < ArrayCount(ServerState->ClientSockets))
+			platform_socket AdminConnection = AcceptConnection(ServerState->AdminSocket, 0);
+			if(AdminConnection != INVALID_PLATFORM_SOCKET)
 			{
-				ServerState->ClientSockets[ServerState->CurrentClientCount] = SDLNet_TCP_Accept(ServerState->ServerSocket);
-				Assert(ServerState->ClientSockets[ServerState->CurrentClientCount]);
-
-				s32 AddSocketResult = SDLNet_TCP_AddSocket(ServerState->SocketSet, ServerState->ClientSockets[ServerState->CurrentClientCount]);
-				Assert(AddSocketResult != -1);
-
-				network_synchess_message Message = {};
-				Message.Type = NetworkMessageType_ConnectionEstablished;
-				Message.ConnectionEstablished.GivenColor = (piece_color)(ServerState->CurrentClientCount);
-				NetSendMessage(ServerState->ClientSockets[ServerState->CurrentClientCount], &Message);
-				++ServerState->CurrentClientCount;
+				ServeAdminConnection(ServerState, AdminConnection);
+			}
+		}
 
-				printf("A new client connected !\n");
+		// NOTE(hugo) : Incoming connexions are pending, take them
+		// until the listen sockets would block.
+		for(u32 AcceptIndex = 0; (ListenPolls[0].revents & POLLIN) && (AcceptIndex < MAX_ACCEPT_PER_TICK); ++AcceptIndex)
+		{
+			connection_handoff Handoff = {};
+			handed_connection* Connection = Handoff.Connections;
+			Connection->Socket = AcceptConnection(ServerState->ServerSocket, &Connection->PeerIP);
+			if(Connection->Socket == INVALID_PLATFORM_SOCKET)
+			{
+				break;
+			}
 
-				if(ServerState->CurrentClientCount == ArrayCount(ServerState->ClientSockets))
-				{
-					// NOTE(hugo) : Broadcast to all that the game has started.
-					network_synchess_message Message = {};
-					Message.Type = NetworkMessageType_GameStarted;
-					for(u32 SocketIndex = 0; 
-							SocketIndex < ArrayCount(ServerState->ClientSockets); 
-							++SocketIndex)
-					{
-						NetSendMessage(ServerState->ClientSockets[SocketIndex], &Message);
-					}
-				}
+			u64 NowMS = GetServerTimeMS();
+			if(!IsConnectLimitExempt(&ServerState->Config, Connection->PeerIP) &&
+					!TakeToken(FindPeerBucket(&ServerState->PeerBuckets, &ServerState->Config.ConnectLimit, Connection->PeerIP, NowMS),
+						&ServerState->Config.ConnectLimit, NowMS))
+			{
+				// NOTE(hugo) : Not even a word, answering is what a flood wants.
+				++ServerState->AcceptorMetrics.Counters[ServerCounter_RateLimitedConnections];
+				CloseSocket(Connection->Socket);
+				continue;
 			}
-			else
+
+			SetSocketNonBlocking(Connection->Socket);
+			SetSocketNoDelay(Connection->Socket, !ServerState->Config.IsNagleEnabled);
+			InitialiseTokenBucket(&Connection->MessageBucket, &ServerState->Config.MessageLimit, NowMS);
+			Handoff.Type = ConnectionHandoff_New;
+			Handoff.ConnectionCount = 1;
+			if(!PushHandoff(PickShard(ServerState, &ServerState->NextShardIndex, 1), &Handoff))
 			{
-				// NOTE(hugo) : No room for the incoming connexion. Tell him we are full
-				TCPsocket TempSocket = SDLNet_TCP_Accept(ServerState->ServerSocket);
-				Assert(TempSocket);
-				network_synchess_message Message = {};
-				Message.Type = NetworkMessageType_NoRoomForClient;
-				NetSendMessage(TempSocket, &Message);
-				SDLNet_TCP_Close(TempSocket);
+				// NOTE(hugo) : The shard did not keep up with its queue. Tell him we are full.
+				RejectConnection(Connection);
 			}
 		}
-
-		for(u32 ClientIndex = 0; ClientIndex < ArrayCount(ServerState->ClientSockets); ++ClientIndex)
+		for(u32 AcceptIndex = 0; LocalPoll && (LocalPoll->revents & POLLIN) && (AcceptIndex < MAX_ACCEPT_PER_TICK); ++AcceptIndex)
 		{
-			TCPsocket ClientSocket = ServerState->ClientSockets[ClientIndex];
-			if(!ClientSocket)
+			connection_handoff Handoff = {};
+			handed_connection* Connection = Handoff.Connections;
+			Connection->Socket = AcceptLocalConnection(ServerState->LocalSocket, &Connection->Local);
+			if(Connection->Socket == INVALID_PLATFORM_SOCKET)
 			{
-				continue;
+				break;
 			}
 
-			s32 ClientSocketActivity = SDLNet_SocketReady(ClientSocket);
-			Assert(ClientSocketActivity != -1);
-			if(ClientSocketActivity > 0)
+			SetSocketNonBlocking(Connection->Socket);
+			InitialiseTokenBucket(&Connection->MessageBucket, &ServerState->Config.MessageLimit, GetServerTimeMS());
+			Handoff.Type = ConnectionHandoff_New;
+			Handoff.ConnectionCount = 1;
+			if(!PushHandoff(PickShard(ServerState, &ServerState->NextShardIndex, 1), &Handoff))
 			{
-				network_synchess_message Message = {};
-				s32 ReceivedBytes = SDLNet_TCP_Recv(ClientSocket, &Message, sizeof(Message));
-				Assert(ReceivedBytes != -1);
-				Assert(ReceivedBytes <= (s32)sizeof(Message));
-				if(ReceivedBytes == 0)
-				{
-					// NOTE(hugo) : Connexion closed.
-					SDLNet_TCP_DelSocket(ServerState->SocketSet, ClientSocket);
-					ServerState->ClientSockets[ClientIndex] = 0;
-				}
-				else
-				{
-					// NOTE(hugo) : A message was received
-					printf("Received from client #%i : %08x\n", ClientIndex, Message.Type);
-					//piece_color ClientColor = (piece_color)(ClientIndex);
-					switch(Message.Type)
-					{
-						case NetworkMessageType_ConnectionEstablished:
-						case NetworkMessageType_Quit:
-						case NetworkMessageType_NoRoomForClient:
-							{
-								// NOTE(hugo) : Client should not send this.
-								InvalidCodePath;
-							} break;
-						case NetworkMessageType_MoveDone:
-							{
-								// TODO(hugo) : Check that the move the client 
-								// want to do is legal. (also check that
-								// this is indeed the right client who
-								// sent the move)
-								ApplyMove(&ServerState->ChessContext, Message.MoveDone, &ServerState->ServerArena);
-								network_synchess_message Message = {};
-								Message.Type = NetworkMessageType_ChessContextUpdate;
-								Message.ContextUpdate.NewBoardConfig = WriteConfig(ServerState->ChessContext.Chessboard);
-								Message.ContextUpdate.CastlingPieceTracker[0] = ServerState->ChessContext.CastlingPieceTracker[0];
-								Message.ContextUpdate.CastlingPieceTracker[1] = ServerState->ChessContext.CastlingPieceTracker[1];
-								Message.ContextUpdate.PlayerCheck = ServerState->ChessContext.PlayerCheck;
-
-								Message.ContextUpdate.LastDoubleStepCol = ServerState->ChessContext.LastDoubleStepCol;
-								Message.ContextUpdate.PlayerToPlay = ServerState->ChessContext.PlayerToPlay;
-								for(u32 ClientIndex = 0;
-										ClientIndex < ArrayCount(ServerState->ClientSockets);
-										++ClientIndex)
-								{
-									TCPsocket ClientSocket = ServerState->ClientSockets[ClientIndex];
-									NetSendMessage(ClientSocket, &Message);
-
-								}
-								// TODO(hugo): Check for checkmate, draw, notify players 
-								// for this and change internal game state.
-							} break;
-
-						InvalidDefaultCase;
-					}
-				}
+				RejectConnection(Connection);
 			}
 		}
 	}
 
-	SDLNet_Quit();
+	StopJournal(&((server_state*)ServerMemory.Storage)->Journal);
+	StopEventLog(&((server_state*)ServerMemory.Storage)->EventLog);
 
 	return(0);
 }
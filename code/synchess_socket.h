@@ -0,0 +1,350 @@
+#pragma once
+
+// NOTE(hugo) : Thin layer over the BSD sockets / Winsock.
+// SDL_net hides the socket handle, which rules out gathered
+// writes, so the server talks to the OS directly through this.
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef SOCKET platform_socket;
+typedef WSAPOLLFD socket_poll;
+#define INVALID_PLATFORM_SOCKET INVALID_SOCKET
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+typedef int platform_socket;
+typedef pollfd socket_poll;
+#define INVALID_PLATFORM_SOCKET (-1)
+#endif
+
+// NOTE(hugo) : Never more than this many slices in a single gathered send.
+#define MAX_SEND_SLICE_COUNT 64
+
+// NOTE(hugo) : Returned by ReceiveFromSocket when a non-blocking
+// socket has nothing to give.
+#define SOCKET_WOULD_BLOCK (-2)
+
+struct send_slice
+{
+	void* Data;
+	u32 Size;
+};
+
+internal void
+InitialiseSockets(void)
+{
+#ifdef _WIN32
+	WSADATA WSAData;
+	s32 StartupResult = WSAStartup(MAKEWORD(2, 2), &WSAData);
+	Assert(StartupResult == 0);
+#else
+	// NOTE(hugo) : A peer closing its socket must not kill the server.
+	signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+internal void
+CloseSocket(platform_socket Socket)
+{
+#ifdef _WIN32
+	closesocket(Socket);
+#else
+	close(Socket);
+#endif
+}
+
+internal bool
+LastSocketErrorIsWouldBlock(void)
+{
+#ifdef _WIN32
+	bool Result = (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+	bool Result = (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+#endif
+	return(Result);
+}
+
+internal void
+SetSocketNonBlocking(platform_socket Socket)
+{
+#ifdef _WIN32
+	u_long NonBlocking = 1;
+	s32 Result = ioctlsocket(Socket, FIONBIO, &NonBlocking);
+#else
+	s32 Flags = fcntl(Socket, F_GETFL, 0);
+	s32 Result = fcntl(Socket, F_SETFL, Flags | O_NONBLOCK);
+#endif
+	Assert(Result != -1);
+}
+
+// NOTE(hugo) : Nagle would hold a message back until the previous one is
+// acknowledged, and the peer delays its acknowledgements, so a move
+// could wait tens of milliseconds for nothing. The messages are already
+// gathered into one send per tick, there is nothing left for Nagle to do.
+internal void
+SetSocketNoDelay(platform_socket Socket, bool IsNoDelay)
+{
+	s32 NoDelay = IsNoDelay ? 1 : 0;
+	setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, (char*)&NoDelay, sizeof(NoDelay));
+}
+
+internal platform_socket
+OpenListenSocket(u16 Port, bool IsLoopbackOnly)
+{
+	platform_socket Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	Assert(Socket != INVALID_PLATFORM_SOCKET);
+
+	s32 ReuseAddress = 1;
+	setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, (char*)&ReuseAddress, sizeof(ReuseAddress));
+
+	sockaddr_in Address = {};
+	Address.sin_family = AF_INET;
+	Address.sin_addr.s_addr = htonl(IsLoopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	Address.sin_port = htons(Port);
+
+	s32 BindResult = bind(Socket, (sockaddr*)&Address, sizeof(Address));
+	Assert(BindResult == 0);
+	s32 ListenResult = listen(Socket, SOMAXCONN);
+	Assert(ListenResult == 0);
+
+	return(Socket);
+}
+
+internal platform_socket
+AcceptConnection(platform_socket ListenSocket, u32* PeerIP)
+{
+	sockaddr_in Address = {};
+	socklen_t AddressSize = sizeof(Address);
+	platform_socket Socket = accept(ListenSocket, (sockaddr*)&Address, &AddressSize);
+	if(PeerIP)
+	{
+		*PeerIP = ntohl(Address.sin_addr.s_addr);
+	}
+
+	return(Socket);
+}
+
+internal platform_socket
+OpenConnection(char* HostName, u16 Port)
+{
+	platform_socket Result = INVALID_PLATFORM_SOCKET;
+
+	char PortName[16];
+	snprintf(PortName, sizeof(PortName), "%u", Port);
+
+	addrinfo Hints = {};
+	Hints.ai_family = AF_INET;
+	Hints.ai_socktype = SOCK_STREAM;
+	addrinfo* AddressList = 0;
+	if(getaddrinfo(HostName, PortName, &Hints, &AddressList) == 0)
+	{
+		for(addrinfo* Address = AddressList;
+				(Result == INVALID_PLATFORM_SOCKET) && Address;
+				Address = Address->ai_next)
+		{
+			platform_socket Socket = socket(Address->ai_family, Address->ai_socktype, Address->ai_protocol);
+			if(Socket != INVALID_PLATFORM_SOCKET)
+			{
+				if(connect(Socket, Address->ai_addr, (s32)Address->ai_addrlen) == 0)
+				{
+					Result = Socket;
+				}
+				else
+				{
+					CloseSocket(Socket);
+				}
+			}
+		}
+		freeaddrinfo(AddressList);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Starts connecting a non-blocking socket, the connexion is
+// made when the socket polls writable (see FinishConnection). Returns
+// INVALID_PLATFORM_SOCKET if it failed right away. The name lookup
+// itself still blocks.
+internal platform_socket
+StartConnection(char* HostName, u16 Port)
+{
+	platform_socket Result = INVALID_PLATFORM_SOCKET;
+
+	char PortName[16];
+	snprintf(PortName, sizeof(PortName), "%u", Port);
+
+	addrinfo Hints = {};
+	Hints.ai_family = AF_INET;
+	Hints.ai_socktype = SOCK_STREAM;
+	addrinfo* AddressList = 0;
+	if(getaddrinfo(HostName, PortName, &Hints, &AddressList) == 0)
+	{
+		platform_socket Socket = socket(AddressList->ai_family, AddressList->ai_socktype, AddressList->ai_protocol);
+		if(Socket != INVALID_PLATFORM_SOCKET)
+		{
+			SetSocketNonBlocking(Socket);
+			s32 ConnectResult = connect(Socket, AddressList->ai_addr, (s32)AddressList->ai_addrlen);
+#ifdef _WIN32
+			bool IsInProgress = (ConnectResult != 0) && (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+			bool IsInProgress = (ConnectResult != 0) && (errno == EINPROGRESS);
+#endif
+			if((ConnectResult == 0) || IsInProgress)
+			{
+				Result = Socket;
+			}
+			else
+			{
+				CloseSocket(Socket);
+			}
+		}
+		freeaddrinfo(AddressList);
+	}
+
+	return(Result);
+}
+
+// NOTE(hugo) : Once a socket of StartConnection polls writable or in error,
+// tells whether it is connected.
+internal bool
+FinishConnection(platform_socket Socket)
+{
+	s32 Error = 0;
+	socklen_t ErrorSize = sizeof(Error);
+	bool Result = (getsockopt(Socket, SOL_SOCKET, SO_ERROR, (char*)&Error, &ErrorSize) == 0) && (Error == 0);
+	return(Result);
+}
+
+// NOTE(hugo) : A connected pair of sockets, so that a thread sleeping in
+// poll can be woken up by another one writing a byte to Sender.
+internal void
+OpenWakeupPair(platform_socket* Receiver, platform_socket* Sender)
+{
+#ifdef _WIN32
+	// NOTE(hugo) : No socketpair on Windows, a loopback connexion does the same.
+	platform_socket Listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	Assert(Listen != INVALID_PLATFORM_SOCKET);
+	sockaddr_in Address = {};
+	Address.sin_family = AF_INET;
+	Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	Address.sin_port = 0;
+	socklen_t AddressSize = sizeof(Address);
+	s32 BindResult = bind(Listen, (sockaddr*)&Address, sizeof(Address));
+	Assert(BindResult == 0);
+	listen(Listen, 1);
+	getsockname(Listen, (sockaddr*)&Address, &AddressSize);
+
+	*Sender = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	s32 ConnectResult = connect(*Sender, (sockaddr*)&Address, sizeof(Address));
+	Assert(ConnectResult == 0);
+	*Receiver = accept(Listen, 0, 0);
+	CloseSocket(Listen);
+#else
+	platform_socket Pair[2];
+	s32 PairResult = socketpair(AF_UNIX, SOCK_STREAM, 0, Pair);
+	Assert(PairResult == 0);
+	*Receiver = Pair[0];
+	*Sender = Pair[1];
+#endif
+	Assert((*Receiver != INVALID_PLATFORM_SOCKET) && (*Sender != INVALID_PLATFORM_SOCKET));
+	SetSocketNonBlocking(*Receiver);
+	SetSocketNonBlocking(*Sender);
+}
+
+internal void
+SendWakeup(platform_socket Sender)
+{
+	// NOTE(hugo) : If the pair is full the receiver is awake anyway.
+	u8 Byte = 1;
+	send(Sender, (char*)&Byte, 1, 0);
+}
+
+internal void
+DrainWakeups(platform_socket Receiver)
+{
+	u8 Bytes[256];
+	s32 ReceivedBytes = 0;
+	do
+	{
+		ReceivedBytes = (s32)recv(Receiver, (char*)Bytes, sizeof(Bytes), 0);
+	} while(ReceivedBytes > 0);
+}
+
+// NOTE(hugo) : Returns the number of bytes received, 0 if the peer
+// closed the connexion, SOCKET_WOULD_BLOCK if there is nothing to read
+// yet, -1 on error.
+internal s32
+ReceiveFromSocket(platform_socket Socket, void* Buffer, u32 Size)
+{
+	s32 Result = (s32)recv(Socket, (char*)Buffer, Size, 0);
+	if((Result < 0) && LastSocketErrorIsWouldBlock())
+	{
+		Result = SOCKET_WOULD_BLOCK;
+	}
+	return(Result);
+}
+
+// NOTE(hugo) : Gathered send of all the slices in one system call.
+// Returns the number of bytes sent (0 if a non-blocking socket is full),
+// -1 on error.
+internal s32
+SendSlices(platform_socket Socket, send_slice* Slices, u32 SliceCount)
+{
+	Assert(SliceCount <= MAX_SEND_SLICE_COUNT);
+	s32 Result = -1;
+#ifdef _WIN32
+	WSABUF Buffers[MAX_SEND_SLICE_COUNT];
+	for(u32 SliceIndex = 0; SliceIndex < SliceCount; ++SliceIndex)
+	{
+		Buffers[SliceIndex].buf = (char*)Slices[SliceIndex].Data;
+		Buffers[SliceIndex].len = Slices[SliceIndex].Size;
+	}
+	DWORD SentBytes = 0;
+	if(WSASend(Socket, Buffers, SliceCount, &SentBytes, 0, 0, 0) == 0)
+	{
+		Result = (s32)SentBytes;
+	}
+	else if(LastSocketErrorIsWouldBlock())
+	{
+		Result = 0;
+	}
+#else
+	iovec Buffers[MAX_SEND_SLICE_COUNT];
+	for(u32 SliceIndex = 0; SliceIndex < SliceCount; ++SliceIndex)
+	{
+		Buffers[SliceIndex].iov_base = Slices[SliceIndex].Data;
+		Buffers[SliceIndex].iov_len = Slices[SliceIndex].Size;
+	}
+	Result = (s32)writev(Socket, Buffers, SliceCount);
+	if((Result < 0) && LastSocketErrorIsWouldBlock())
+	{
+		Result = 0;
+	}
+#endif
+
+	return(Result);
+}
+
+internal s32
+PollSockets(socket_poll* Polls, u32 PollCount, s32 TimeoutMS)
+{
+#ifdef _WIN32
+	s32 Result = WSAPoll(Polls, PollCount, TimeoutMS);
+#else
+	s32 Result = poll(Polls, PollCount, TimeoutMS);
+#endif
+	return(Result);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+// NOTE(hugo) : Hierarchical timing wheel (Varghese & Lauck, the same
+// layout as the old Linux kernel timers). Level 0 has one slot per tick,
+// each next level one slot per full turn of the level below. Scheduling
+// and cancelling are O(1), and a tick only touches one slot, plus a
+// cascade of one slot of the upper level every TIMER_WHEEL_SLOT_COUNT
+// ticks. So the cost does not depend on the number of running timers.
+
+#define TIMER_WHEEL_TICK_MS 10
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOT_COUNT (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOT_COUNT - 1)
+// NOTE(hugo) : 4 levels of 8 bits covers 2^32 ticks, more than a year
+// at 10ms a tick. Farther deadlines wait in the last slot and are
+// rescheduled when it cascades.
+#define TIMER_WHEEL_LEVEL_COUNT 4
+
+struct timer_entry
+{
+	u64 Deadline;
+	void* Data;
+	bool IsScheduled;
+
+	timer_entry* Next;
+	timer_entry* Prev;
+};
+
+struct timer_wheel
+{
+	// NOTE(hugo) : The next tick to process. Everything whose deadline
+	// is before it already fired.
+	u64 CurrentTick;
+	u64 CascadedTick;
+	u32 ScheduledCount;
+
+	// NOTE(hugo) : Sentinels of circular doubly linked lists.
+	timer_entry Slots[TIMER_WHEEL_LEVEL_COUNT][TIMER_WHEEL_SLOT_COUNT];
+};
+
+internal u64
+GetTimerTick(u64 TimeMS)
+{
+	u64 Result = TimeMS / TIMER_WHEEL_TICK_MS;
+	return(Result);
+}
+
+// NOTE(hugo) : First tick at or after the given time.
+internal u64
+GetTimerDeadlineTick(u64 TimeMS)
+{
+	u64 Result = (TimeMS + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+	return(Result);
+}
+
+internal void
+InitialiseTimerWheel(timer_wheel* Wheel, u64 CurrentTick)
+{
+	Wheel->CurrentTick = CurrentTick;
+	Wheel->CascadedTick = (u64)-1;
+	Wheel->ScheduledCount = 0;
+	for(u32 LevelIndex = 0; LevelIndex < TIMER_WHEEL_LEVEL_COUNT; ++LevelIndex)
+	{
+		for(u32 SlotIndex = 0; SlotIndex < TIMER_WHEEL_SLOT_COUNT; ++SlotIndex)
+		{
+			timer_entry* Sentinel = &Wheel->Slots[LevelIndex][SlotIndex];
+			Sentinel->Next = Sentinel;
+			Sentinel->Prev = Sentinel;
+		}
+	}
+}
+
+internal void
+LinkTimer(timer_wheel* Wheel, timer_entry* Timer)
+{
+	timer_entry* Sentinel = 0;
+	if(Timer->Deadline <= Wheel->CurrentTick)
+	{
+		Sentinel = &Wheel->Slots[0][Wheel->CurrentTick & TIMER_WHEEL_MASK];
+	}
+	else
+	{
+		u64 Delta = Timer->Deadline - Wheel->CurrentTick;
+		u64 SlotTick = Timer->Deadline;
+		u32 LevelIndex = 0;
+		while((LevelIndex + 1 < TIMER_WHEEL_LEVEL_COUNT) &&
+				(Delta >= ((u64)1 << ((LevelIndex + 1) * TIMER_WHEEL_BITS))))
+		{
+			++LevelIndex;
+		}
+		u64 MaxDelta = ((u64)1 << (TIMER_WHEEL_LEVEL_COUNT * TIMER_WHEEL_BITS)) - 1;
+		if(Delta > MaxDelta)
+		{
+			SlotTick = Wheel->CurrentTick + MaxDelta;
+		}
+		u32 SlotIndex = (u32)(SlotTick >> (LevelIndex * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+		Sentinel = &Wheel->Slots[LevelIndex][SlotIndex];
+	}
+
+	Timer->Next = Sentinel->Next;
+	Timer->Prev = Sentinel;
+	Sentinel->Next->Prev = Timer;
+	Sentinel->Next = Timer;
+}
+
+internal void
+UnlinkTimer(timer_entry* Timer)
+{
+	Timer->Prev->Next = Timer->Next;
+	Timer->Next->Prev = Timer->Prev;
+	Timer->Next = Timer->Prev = 0;
+}
+
+internal void
+CancelTimer(timer_wheel* Wheel, timer_entry* Timer)
+{
+	if(Timer->IsScheduled)
+	{
+		UnlinkTimer(Timer);
+		Timer->IsScheduled = false;
+		Assert(Wheel->ScheduledCount > 0);
+		--Wheel->ScheduledCount;
+	}
+}
+
+// NOTE(hugo) : Rescheduling a timer that is already running is fine.
+internal void
+ScheduleTimer(timer_wheel* Wheel, timer_entry* Timer, u64 DeadlineTick, void* Data)
+{
+	CancelTimer(Wheel, Timer);
+	Timer->Deadline = DeadlineTick;
+	Timer->Data = Data;
+	Timer->IsScheduled = true;
+	LinkTimer(Wheel, Timer);
+	++Wheel->ScheduledCount;
+}
+
+// NOTE(hugo) : Spreads the slot of an upper level on the levels below.
+// Returns the index of the slot, 0 meaning the next level has to cascade too.
+internal u32
+CascadeTimers(timer_wheel* Wheel, u32 LevelIndex)
+{
+	u32 SlotIndex = (u32)(Wheel->CurrentTick >> (LevelIndex * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+	timer_entry* Sentinel = &Wheel->Slots[LevelIndex][SlotIndex];
+	timer_entry* Timer = Sentinel->Next;
+	Sentinel->Next = Sentinel->Prev = Sentinel;
+	while(Timer != Sentinel)
+	{
+		timer_entry* Next = Timer->Next;
+		LinkTimer(Wheel, Timer);
+		Timer = Next;
+	}
+
+	return(SlotIndex);
+}
+
+// NOTE(hugo) : Returns one expired timer at a time, 0 when there is
+// none left up to NowTick. Handing them one by one means the caller can
+// freely cancel or schedule other timers while handling one.
+internal timer_entry*
+PopExpiredTimer(timer_wheel* Wheel, u64 NowTick)
+{
+	timer_entry* Result = 0;
+	while(!Result && (Wheel->CurrentTick <= NowTick))
+	{
+		u32 SlotIndex = (u32)(Wheel->CurrentTick & TIMER_WHEEL_MASK);
+		if((SlotIndex == 0) && (Wheel->CascadedTick != Wheel->CurrentTick))
+		{
+			Wheel->CascadedTick = Wheel->CurrentTick;
+			u32 LevelIndex = 1;
+			while((LevelIndex < TIMER_WHEEL_LEVEL_COUNT) && (CascadeTimers(Wheel, LevelIndex) == 0))
+			{
+				++LevelIndex;
+			}
+		}
+
+		timer_entry* Sentinel = &Wheel->Slots[0][SlotIndex];
+		if(Sentinel->Next != Sentinel)
+		{
+			Result = Sentinel->Next;
+			UnlinkTimer(Result);
+			Result->IsScheduled = false;
+			--Wheel->ScheduledCount;
+		}
+		else
+		{
+			++Wheel->CurrentTick;
+		}
+	}
+
+	return(Result);
+}